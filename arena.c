@@ -0,0 +1,121 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ALIGN_UP(n) (((n) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+#define BLOCK_HEADER_SIZE ALIGN_UP(sizeof(arenablock))
+#define BLOCK_DATA(block) ((char*)(block) + BLOCK_HEADER_SIZE)
+
+
+void initialize_arena(arena* a, size_t blocksize)
+{
+    a->first = NULL;
+    a->current = NULL;
+    a->blocksize = blocksize;
+    a->allocations = 0;
+    a->blocks = 0;
+}
+
+
+/*
+* Returns size bytes from the current block, moving on to the next block (or
+* allocating a new one at the end of the chain) when it doesn't fit. Blocks
+* after the current one are only non-empty before a reset, so skipping ahead
+* never hands out memory that is still in use.
+*/
+void* arena_alloc(arena* a, size_t size)
+{
+    size = ALIGN_UP(size);
+    a->allocations++;
+
+    arenablock* last = NULL;
+    for (arenablock* block = a->current; block != NULL; block = block->next)
+    {
+        if (block->size - block->used >= size)
+        {
+            a->current = block;
+            void* p = BLOCK_DATA(block) + block->used;
+            block->used += size;
+            return p;
+        }
+        last = block;
+    }
+
+    size_t blocksize = (size > a->blocksize) ? size : a->blocksize;
+    arenablock* newblock = malloc(BLOCK_HEADER_SIZE + blocksize);
+    if (newblock == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for arena block\n");
+        exit(1);
+    }
+    newblock->next = NULL;
+    newblock->size = blocksize;
+    newblock->used = size;
+    a->blocks++;
+
+    if (last != NULL)
+    {
+        last->next = newblock;
+    }
+    else
+    {
+        a->first = newblock; // current is only NULL while the arena has no blocks at all
+    }
+    a->current = newblock;
+    return BLOCK_DATA(newblock);
+}
+
+
+/*
+* Resizes an allocation. If p is the most recent allocation in the current
+* block and there is room, it simply grows; otherwise the contents are copied
+* to a fresh allocation and the old space is abandoned until the next reset.
+*/
+void* arena_realloc(arena* a, void* p, size_t oldsize, size_t newsize)
+{
+    arenablock* block = a->current;
+    if (p != NULL && block != NULL && (char*)p + ALIGN_UP(oldsize) == BLOCK_DATA(block) + block->used)
+    {
+        size_t start = (size_t)((char*)p - BLOCK_DATA(block));
+        if (block->size - start >= ALIGN_UP(newsize))
+        {
+            block->used = start + ALIGN_UP(newsize);
+            return p;
+        }
+    }
+
+    void* newp = arena_alloc(a, newsize);
+    if (p != NULL)
+    {
+        memcpy(newp, p, (oldsize < newsize) ? oldsize : newsize);
+    }
+    return newp;
+}
+
+
+/*
+* Releases every allocation at once. The blocks stay chained so the next round
+* of allocations reuses them without calling malloc().
+*/
+void reset_arena(arena* a)
+{
+    for (arenablock* block = a->first; block != NULL; block = block->next)
+    {
+        block->used = 0;
+    }
+    a->current = a->first;
+}
+
+void free_arena(arena* a)
+{
+    arenablock* block = a->first;
+    while (block != NULL)
+    {
+        arenablock* next = block->next;
+        free(block);
+        block = next;
+    }
+    a->first = NULL;
+    a->current = NULL;
+}
@@ -0,0 +1,36 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 16 // every allocation starts on this boundary
+#define FILE_ARENA_BLOCK_SIZE 16384
+#define SCRATCH_ARENA_BLOCK_SIZE 4096
+
+// one chunk of arena memory; the usable bytes follow the header
+typedef struct arenablock
+{
+    struct arenablock* next;
+    size_t size; // usable bytes
+    size_t used;
+} arenablock;
+
+// A bump allocator. Allocations are carved out of large blocks and are never
+// freed individually; reset_arena() releases all of them at once but keeps the
+// blocks for reuse, free_arena() gives the blocks back to the system.
+typedef struct arena
+{
+    arenablock* first;
+    arenablock* current; // the block allocations are being carved from
+    size_t blocksize;
+    unsigned long allocations; // arena_alloc() calls, including those made by arena_realloc()
+    unsigned long blocks; // malloc() calls made for blocks
+} arena;
+
+void initialize_arena(arena* a, size_t blocksize); // no memory is taken until the first allocation
+void* arena_alloc(arena* a, size_t size); // never returns NULL, exits if memory runs out
+void* arena_realloc(arena* a, void* p, size_t oldsize, size_t newsize); // grows in place if p was the last allocation
+void reset_arena(arena* a);
+void free_arena(arena* a);
+
+#endif // ARENA_H
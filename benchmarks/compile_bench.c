@@ -0,0 +1,642 @@
+/*
+* Whole-compiler benchmark on generated programs.
+*
+* Generates valid Jack programs of growing size and compiles every file
+* in-process with compile_jack_file(), the way directory mode does. Each
+* size runs in its own child process, so the peak RSS reported is that
+* size's alone. Prints throughput in lines/s and tokens/s for each step of
+* the scaling curve.
+*
+* The generator's knobs set the shape of the program: classes, subroutines
+* per class, locals per subroutine, statements per subroutine body, how
+* deeply if/while statements nest, how many terms each expression has, and
+* the percentage of statements that use a string literal. --scale-param
+* picks the knob that --scale multiplies, so the curve can show how the
+* compiler copes with bigger classes, longer subroutines, more locals and
+* so on. A subroutine with more than 999 if or while statements
+* (--statements 2000 --depth 1) also covers label numbers past 3 digits.
+*
+* --save-baseline FILE records tokens/s for each step, and --baseline FILE
+* compares against such a file, flagging any step more than --tolerance
+* percent (default 10) slower. The exit status is 1 if anything regressed.
+* --generate DIR just writes a program to DIR and exits.
+*
+* Build from the repository root:
+*   gcc -O2 -D_DEFAULT_SOURCE -I. benchmarks/compile_bench.c $(ls *.c | grep -v '^main.c$') -o compile_bench -lpthread
+* Run:
+*   ./compile_bench [--classes N] [--subroutines N] [--locals N] [--statements N] [--depth N] [--width N]
+*                   [--strings PERCENT] [--seed N] [--scale 1,2,4,8] [--scale-param NAME] [--iterations N]
+*                   [--baseline FILE] [--save-baseline FILE] [--tolerance PERCENT] [--generate DIR]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "../filehandling.h"
+
+#define MAX_SCALES 16
+#define MAX_PATH_LENGTH 512
+#define DEFAULT_TOLERANCE 10.0
+
+// what the generated program looks like
+typedef struct programshape
+{
+    int classes;
+    int subroutines; // per class
+    int locals; // per subroutine
+    int statements; // per subroutine body, not counting nested ones
+    int depth; // how deeply if and while statements nest
+    int width; // terms per expression
+    int strings; // percentage of statements that use a string literal
+    unsigned int seed;
+} programshape;
+
+// the knobs, in the order --scale-param names them
+static const char* knobnames[] = { "classes", "subroutines", "locals", "statements", "depth", "width", "strings" };
+
+static int* knob(programshape* shape, int which)
+{
+    int* knobs[] = { &shape->classes, &shape->subroutines, &shape->locals, &shape->statements, &shape->depth,
+        &shape->width, &shape->strings };
+    return knobs[which];
+}
+
+// what one child process sends back for one size
+typedef struct scaleresult
+{
+    double seconds; // best of the iterations
+    unsigned long tokens;
+    bool succeeded;
+} scaleresult;
+
+
+/*
+* The generator. It keeps its own random state so every run with the same
+* seed writes the same program.
+*/
+typedef struct generator
+{
+    FILE* out;
+    const programshape* shape;
+    unsigned long long state;
+    unsigned long lines;
+    int numvars; // locals and arguments in scope, named l0, l1, ... and a0, a1, ...
+    int numargs;
+    bool inmethod; // fields f0 and f1 can be used
+} generator;
+
+static unsigned int next_random(generator* g, unsigned int range)
+{
+    g->state = g->state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(g->state >> 33) % range;
+}
+
+static void emit_line(generator* g, int indent, const char* text)
+{
+    fprintf(g->out, "%*s%s\n", indent * 4, "", text);
+    g->lines++;
+}
+
+static void emit_variable(generator* g)
+{
+    unsigned int pick = next_random(g, (unsigned int)(g->numvars + g->numargs + (g->inmethod ? 2 : 0)));
+    if (pick < (unsigned int)g->numvars)
+    {
+        fprintf(g->out, "l%u", pick);
+    }
+    else if (pick < (unsigned int)(g->numvars + g->numargs))
+    {
+        fprintf(g->out, "a%u", pick - (unsigned int)g->numvars);
+    }
+    else
+    {
+        fprintf(g->out, "f%u", pick - (unsigned int)(g->numvars + g->numargs));
+    }
+}
+
+static void emit_term(generator* g)
+{
+    switch (next_random(g, 6))
+    {
+    case 0:
+        fprintf(g->out, "%u", next_random(g, 1000));
+        break;
+    case 1:
+        fprintf(g->out, "(");
+        emit_variable(g);
+        fprintf(g->out, " + %u)", next_random(g, 100));
+        break;
+    case 2:
+        fprintf(g->out, "-");
+        emit_variable(g);
+        break;
+    case 3:
+        fprintf(g->out, "Math.abs(");
+        emit_variable(g);
+        fprintf(g->out, ")");
+        break;
+    default:
+        emit_variable(g);
+        break;
+    }
+}
+
+static void emit_expression(generator* g)
+{
+    static const char operators[] = { '+', '-', '*', '/', '&', '|' };
+    emit_term(g);
+    for (int i = 1; i < g->shape->width; i++)
+    {
+        fprintf(g->out, " %c ", operators[next_random(g, sizeof(operators))]);
+        emit_term(g);
+    }
+}
+
+static void emit_condition(generator* g)
+{
+    static const char comparisons[] = { '<', '>', '=' };
+    fprintf(g->out, "(");
+    emit_expression(g);
+    fprintf(g->out, ") %c ", comparisons[next_random(g, sizeof(comparisons))]);
+    emit_term(g);
+}
+
+static void emit_statement(generator* g, int indent, int depth)
+{
+    fprintf(g->out, "%*s", indent * 4, "");
+    if ((int)next_random(g, 100) < g->shape->strings)
+    {
+        if (next_random(g, 2) == 0)
+        {
+            fprintf(g->out, "do Output.printString(\"value %u of %u\");\n", next_random(g, 1000), next_random(g, 1000));
+        }
+        else
+        {
+            fprintf(g->out, "let s = \"generated text %u\";\n", next_random(g, 100000));
+        }
+        g->lines++;
+        return;
+    }
+
+    unsigned int kind = (depth > 0) ? next_random(g, 5) : 2 + next_random(g, 3);
+    if (kind <= 1)
+    {
+        fprintf(g->out, "%s (", (kind == 0) ? "if" : "while");
+        emit_condition(g);
+        fprintf(g->out, ") {\n");
+        g->lines++;
+        for (int i = 0; i < 2; i++)
+        {
+            emit_statement(g, indent + 1, depth - 1);
+        }
+        if (kind == 0 && next_random(g, 2) == 0)
+        {
+            emit_line(g, indent, "}");
+            emit_line(g, indent, "else {");
+            emit_statement(g, indent + 1, depth - 1);
+        }
+        emit_line(g, indent, "}");
+        return;
+    }
+    if (kind == 2 || g->numvars == 0)
+    {
+        fprintf(g->out, "do Output.printInt(");
+    }
+    else
+    {
+        fprintf(g->out, "let l%u = ", next_random(g, (unsigned int)g->numvars));
+    }
+    emit_expression(g);
+    fprintf(g->out, (kind == 2 || g->numvars == 0) ? ");\n" : ";\n");
+    g->lines++;
+}
+
+static void emit_subroutine(generator* g, int classindex, int index)
+{
+    g->inmethod = (index % 2 == 0);
+    g->numargs = 1 + (int)next_random(g, 3);
+    g->numvars = g->shape->locals;
+
+    fprintf(g->out, "    %s int r%d(", g->inmethod ? "method" : "function", index);
+    for (int i = 0; i < g->numargs; i++)
+    {
+        fprintf(g->out, "%sint a%d", (i == 0) ? "" : ", ", i);
+    }
+    fprintf(g->out, ") {\n");
+    g->lines++;
+    if (g->numvars > 0)
+    {
+        fprintf(g->out, "        var int l0");
+        for (int i = 1; i < g->numvars; i++)
+        {
+            fprintf(g->out, ", l%d", i);
+        }
+        fprintf(g->out, ";\n");
+        g->lines++;
+    }
+    emit_line(g, 2, "var String s;");
+    for (int i = 0; i < g->shape->statements; i++)
+    {
+        emit_statement(g, 2, g->shape->depth);
+    }
+    if (index > 0)
+    {
+        fprintf(g->out, "        do C%d.r%d(1, 2, 3);\n", classindex, index - 1); // arity isn't checked
+        g->lines++;
+    }
+    fprintf(g->out, "        return ");
+    emit_expression(g);
+    fprintf(g->out, ";\n");
+    g->lines++;
+    emit_line(g, 1, "}");
+}
+
+/*
+* Writes C0.jack ... Cn.jack and Main.jack into directoryname. Returns the
+* number of lines written, or 0 if a file couldn't be created.
+*/
+static unsigned long generate_program(const char* directoryname, const programshape* shape)
+{
+    generator g;
+    g.shape = shape;
+    g.state = shape->seed;
+    g.lines = 0;
+    char filename[MAX_PATH_LENGTH];
+
+    for (int c = 0; c < shape->classes; c++)
+    {
+        snprintf(filename, sizeof(filename), "%s/C%d.jack", directoryname, c);
+        if ((g.out = fopen(filename, "w")) == NULL)
+        {
+            fprintf(stderr, "Error: could not create %s\n", filename);
+            return 0;
+        }
+        fprintf(g.out, "class C%d {\n", c);
+        emit_line(&g, 1, "field int f0, f1;");
+        emit_line(&g, 1, "static int count;");
+        fprintf(g.out, "    constructor C%d new(int a0) {\n", c);
+        g.lines += 2;
+        emit_line(&g, 2, "let f0 = a0;");
+        emit_line(&g, 2, "let f1 = count;");
+        emit_line(&g, 2, "let count = count + 1;");
+        emit_line(&g, 2, "return this;");
+        emit_line(&g, 1, "}");
+        for (int i = 0; i < shape->subroutines; i++)
+        {
+            emit_subroutine(&g, c, i);
+        }
+        emit_line(&g, 0, "}");
+        fclose(g.out);
+    }
+
+    snprintf(filename, sizeof(filename), "%s/Main.jack", directoryname);
+    if ((g.out = fopen(filename, "w")) == NULL)
+    {
+        fprintf(stderr, "Error: could not create %s\n", filename);
+        return 0;
+    }
+    emit_line(&g, 0, "class Main {");
+    emit_line(&g, 1, "function void main() {");
+    emit_line(&g, 2, "var C0 object;");
+    for (int c = 0; c < shape->classes; c++)
+    {
+        fprintf(g.out, "        let object = C%d.new(%d);\n", c, c);
+        fprintf(g.out, "        do object.r0(%d);\n", c);
+        g.lines += 2;
+    }
+    emit_line(&g, 2, "return;");
+    emit_line(&g, 1, "}");
+    emit_line(&g, 0, "}");
+    fclose(g.out);
+    return g.lines;
+}
+
+static void remove_directory(const char* directoryname)
+{
+    DIR* directory = opendir(directoryname);
+    if (directory == NULL)
+    {
+        return;
+    }
+    struct dirent* entry;
+    char filename[MAX_PATH_LENGTH];
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+        {
+            snprintf(filename, sizeof(filename), "%s/%s", directoryname, entry->d_name);
+            remove(filename);
+        }
+    }
+    closedir(directory);
+    rmdir(directoryname);
+}
+
+
+/*
+* Runs in the child process: compiles every .jack file of directoryname
+* iterations times and keeps the fastest run.
+*/
+static scaleresult compile_program(const char* directoryname, int iterations)
+{
+    scaleresult result;
+    result.seconds = 0.0;
+    result.tokens = 0;
+    result.succeeded = true;
+
+    compileoptions options;
+    char* noargs[] = { "compile_bench", (char*)directoryname, NULL };
+    parse_command_line(2, noargs, &options);
+    FILE* devnull = fopen("/dev/null", "w");
+
+    for (int n = 0; n < iterations; n++)
+    {
+        DIR* directory = opendir(directoryname);
+        if (directory == NULL || devnull == NULL)
+        {
+            result.succeeded = false;
+            break;
+        }
+        unsigned long tokens = 0;
+        double start = stats_clock();
+        struct dirent* entry;
+        char filename[MAX_PATH_LENGTH];
+        while ((entry = readdir(directory)) != NULL)
+        {
+            if (is_jack_file(entry->d_name))
+            {
+                filestats stats;
+                initialize_file_stats(&stats);
+                stats.symbols.timed = false;
+                snprintf(filename, sizeof(filename), "%s/%s", directoryname, entry->d_name);
+                result.succeeded = compile_jack_file(filename, &options, devnull, stderr, &stats) && result.succeeded;
+                tokens += stats.tokens;
+            }
+        }
+        double elapsed = stats_clock() - start;
+        closedir(directory);
+        if (n == 0 || elapsed < result.seconds)
+        {
+            result.seconds = elapsed;
+        }
+        result.tokens = tokens;
+    }
+    if (devnull != NULL)
+    {
+        fclose(devnull);
+    }
+    return result;
+}
+
+/*
+* Compiles the program in a child process, so ru_maxrss covers this size
+* only. Returns false if the child failed.
+*/
+static bool measure_program(const char* directoryname, int iterations, scaleresult* result, long* peakrsskb)
+{
+    int channel[2];
+    if (pipe(channel) != 0)
+    {
+        return false;
+    }
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0)
+    {
+        return false;
+    }
+    if (child == 0)
+    {
+        close(channel[0]);
+        scaleresult measured = compile_program(directoryname, iterations);
+        ssize_t written = write(channel[1], &measured, sizeof(measured));
+        _exit(written == (ssize_t)sizeof(measured) ? 0 : 1);
+    }
+    close(channel[1]);
+    ssize_t received = read(channel[0], result, sizeof(*result));
+    close(channel[0]);
+    int status = 0;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0
+        || received != (ssize_t)sizeof(*result))
+    {
+        return false;
+    }
+    *peakrsskb = usage.ru_maxrss; // KiB on Linux
+    return true;
+}
+
+
+static bool parse_scales(const char* list, int* scales, int* numscales)
+{
+    *numscales = 0;
+    while (*list != '\0' && *numscales < MAX_SCALES)
+    {
+        char* end;
+        long scale = strtol(list, &end, 10);
+        if (end == list || scale < 1 || (*end != ',' && *end != '\0'))
+        {
+            return false;
+        }
+        scales[(*numscales)++] = (int)scale;
+        list = (*end == ',') ? end + 1 : end;
+    }
+    return *numscales > 0;
+}
+
+/*
+* Reads "tokens_per_second <scale> <value>" lines from a baseline file.
+* Returns the value for scale, or 0 if there is none.
+*/
+static double baseline_for(const char* filename, int scale)
+{
+    FILE* infile = fopen(filename, "r");
+    if (infile == NULL)
+    {
+        return 0.0;
+    }
+    double found = 0.0;
+    int filescale;
+    double value;
+    while (fscanf(infile, " tokens_per_second %d %lf", &filescale, &value) == 2)
+    {
+        if (filescale == scale)
+        {
+            found = value;
+        }
+    }
+    fclose(infile);
+    return found;
+}
+
+static void print_bench_usage(void)
+{
+    fprintf(stderr, "Usage: compile_bench [--classes N] [--subroutines N] [--locals N] [--statements N] [--depth N]\n");
+    fprintf(stderr, "                     [--width N] [--strings PERCENT] [--seed N] [--scale 1,2,4,8]\n");
+    fprintf(stderr, "                     [--scale-param classes|subroutines|locals|statements|depth|width|strings]\n");
+    fprintf(stderr, "                     [--iterations N] [--baseline FILE] [--save-baseline FILE]\n");
+    fprintf(stderr, "                     [--tolerance PERCENT] [--generate DIR]\n");
+}
+
+int main(int argc, char** argv)
+{
+    programshape shape = { 8, 16, 6, 12, 2, 4, 10, 1 };
+    int scales[MAX_SCALES] = { 1, 2, 4, 8 };
+    int numscales = 4;
+    int scaled = 1; // subroutines
+    int iterations = 5;
+    double tolerance = DEFAULT_TOLERANCE;
+    const char* baselinefile = NULL;
+    const char* savefile = NULL;
+    const char* generatedir = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        bool known = (value != NULL);
+        if (known && strcmp(arg, "--scale") == 0)
+        {
+            known = parse_scales(value, scales, &numscales);
+        }
+        else if (known && strcmp(arg, "--scale-param") == 0)
+        {
+            known = false;
+            for (int k = 0; k < (int)(sizeof(knobnames) / sizeof(knobnames[0])); k++)
+            {
+                if (strcmp(value, knobnames[k]) == 0)
+                {
+                    scaled = k;
+                    known = true;
+                }
+            }
+        }
+        else if (known && strcmp(arg, "--iterations") == 0)
+        {
+            iterations = atoi(value);
+        }
+        else if (known && strcmp(arg, "--seed") == 0)
+        {
+            shape.seed = (unsigned int)strtoul(value, NULL, 10);
+        }
+        else if (known && strcmp(arg, "--tolerance") == 0)
+        {
+            tolerance = atof(value);
+        }
+        else if (known && strcmp(arg, "--baseline") == 0)
+        {
+            baselinefile = value;
+        }
+        else if (known && strcmp(arg, "--save-baseline") == 0)
+        {
+            savefile = value;
+        }
+        else if (known && strcmp(arg, "--generate") == 0)
+        {
+            generatedir = value;
+        }
+        else if (known && strncmp(arg, "--", 2) == 0)
+        {
+            known = false;
+            for (int k = 0; k < (int)(sizeof(knobnames) / sizeof(knobnames[0])); k++)
+            {
+                if (strcmp(arg + 2, knobnames[k]) == 0)
+                {
+                    *knob(&shape, k) = atoi(value);
+                    known = true;
+                }
+            }
+        }
+        else
+        {
+            known = false;
+        }
+        if (!known)
+        {
+            print_bench_usage();
+            return 1;
+        }
+        i++;
+    }
+    if (iterations < 1 || shape.classes < 1 || shape.width < 1 || shape.depth < 0)
+    {
+        print_bench_usage();
+        return 1;
+    }
+
+    if (generatedir != NULL)
+    {
+        mkdir(generatedir, 0755);
+        unsigned long lines = generate_program(generatedir, &shape);
+        printf("wrote %d classes, %lu lines to %s\n", shape.classes + 1, lines, generatedir);
+        return (lines > 0) ? 0 : 1;
+    }
+
+    FILE* savebaseline = NULL;
+    if (savefile != NULL && (savebaseline = fopen(savefile, "w")) == NULL)
+    {
+        fprintf(stderr, "Error: could not create %s\n", savefile);
+        return 1;
+    }
+
+    printf("scaling %s, best of %d\n", knobnames[scaled], iterations);
+    printf("%6s %8s %10s %10s %10s %12s %12s %10s\n", "scale", knobnames[scaled], "lines", "tokens", "ms",
+        "lines/s", "tokens/s", "peak KiB");
+    int base = *knob(&shape, scaled);
+    bool regressed = false;
+    for (int s = 0; s < numscales; s++)
+    {
+        programshape scaledshape = shape;
+        *knob(&scaledshape, scaled) = base * scales[s];
+
+        char directoryname[] = "/tmp/jackbenchXXXXXX";
+        if (mkdtemp(directoryname) == NULL)
+        {
+            fprintf(stderr, "Error: could not create a temporary directory\n");
+            return 1;
+        }
+        unsigned long lines = generate_program(directoryname, &scaledshape);
+        scaleresult result;
+        long peakrsskb = 0;
+        bool measured = (lines > 0) && measure_program(directoryname, iterations, &result, &peakrsskb);
+        remove_directory(directoryname);
+        if (!measured || !result.succeeded)
+        {
+            fprintf(stderr, "Error: the generated program at scale %d did not compile\n", scales[s]);
+            return 1;
+        }
+
+        double tokenspersecond = (double)result.tokens / result.seconds;
+        printf("%6d %8d %10lu %10lu %10.2f %12.0f %12.0f %10ld", scales[s], *knob(&scaledshape, scaled), lines,
+            result.tokens, result.seconds * 1e3, (double)lines / result.seconds, tokenspersecond, peakrsskb);
+        if (baselinefile != NULL)
+        {
+            double expected = baseline_for(baselinefile, scales[s]);
+            if (expected > 0.0)
+            {
+                double change = (tokenspersecond - expected) * 100.0 / expected;
+                bool slower = change < -tolerance;
+                printf("  %+6.1f%% vs baseline%s", change, slower ? "  REGRESSION" : "");
+                regressed = regressed || slower;
+            }
+        }
+        printf("\n");
+        if (savebaseline != NULL)
+        {
+            fprintf(savebaseline, "tokens_per_second %d %.0f\n", scales[s], tokenspersecond);
+        }
+    }
+
+    if (savebaseline != NULL && fclose(savebaseline) != 0)
+    {
+        fprintf(stderr, "Error: could not write %s\n", savefile);
+        return 1;
+    }
+    return regressed ? 1 : 0;
+}
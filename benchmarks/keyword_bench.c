@@ -0,0 +1,171 @@
+/*
+* Keyword classification microbenchmark.
+*
+* Compares classify_word() against the strcmp() chain the tokenizer used to
+* run for every identifier and keyword, over the identifier-shaped tokens of
+* Output.jack and Screen.jack.
+*
+* Build from the repository root:
+*   gcc -O2 -I. benchmarks/keyword_bench.c jacktokenizer.c jacksource.c charscan.c interner.c
+*       symboltable.c tokenizerengine.c compilationengine.c syntaxtree.c codegenerator.c constantfolder.c vmwriter.c peephole.c arena.c
+*       xmlwriter.c compilestats.c -o keyword_bench
+* Run:
+*   ./keyword_bench [iterations] [file.jack ...]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../jacktokenizer.h"
+
+#define DEFAULT_ITERATIONS 2000
+
+static const char* defaultfiles[] = { "testdirectory/Output.jack", "testdirectory/Screen.jack" };
+
+/*
+* The classification the tokenizer did before classify_word(): one strcmp()
+* per keyword until something matches.
+*/
+static keyword strcmp_chain_key(const char* name)
+{
+    static const char* names[] = { "class", "constructor", "function", "method", "field", "static", "var", "int",
+        "char", "boolean", "void", "true", "false", "null", "this", "let", "do", "if", "else", "while", "return" };
+    static const keyword keys[] = { K_CLASS, K_CONSTRUCTOR, K_FUNCTION, K_METHOD, K_FIELD, K_STATIC, K_VAR, K_INT,
+        K_CHAR, K_BOOLEAN, K_VOID, K_TRUE, K_FALSE, K_NULL, K_THIS, K_LET, K_DO, K_IF, K_ELSE, K_WHILE, K_RETURN };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+    {
+        if (strcmp(name, names[i]) == 0)
+        {
+            return keys[i];
+        }
+    }
+    return K_NA;
+}
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    int numfiles = (argc > 2) ? argc - 2 : 2;
+    const char** files = (argc > 2) ? (const char**)(argv + 2) : defaultfiles;
+
+    // collect every keyword/identifier token as both a NUL-terminated copy (for
+    // the strcmp chain) and a view into the source (for classify_word)
+    size_t capacity = 1024;
+    size_t numwords = 0;
+    char** copies = malloc(capacity * sizeof(*copies));
+    const char** views = malloc(capacity * sizeof(*views));
+    size_t* lengths = malloc(capacity * sizeof(*lengths));
+    jacksource* sources = malloc(numfiles * sizeof(*sources));
+    if (copies == NULL || views == NULL || lengths == NULL || sources == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for benchmark\n");
+        return 1;
+    }
+
+    for (int f = 0; f < numfiles; f++)
+    {
+        FILE* infile = fopen(files[f], "r");
+        if (infile == NULL || !open_jack_source(&sources[f], infile))
+        {
+            fprintf(stderr, "Error: could not open %s\n", files[f]);
+            return 1;
+        }
+        fclose(infile);
+
+        tokenstream ts;
+        interner names;
+        initialize_interner(&names);
+        lex_token_stream(&ts, &sources[f], &names);
+        for (size_t i = 0; i < ts.count; i++)
+        {
+            if (ts.types[i] != T_KEYWORD && ts.types[i] != T_IDENTIFIER)
+            {
+                continue;
+            }
+            if (numwords == capacity)
+            {
+                capacity *= 2;
+                copies = realloc(copies, capacity * sizeof(*copies));
+                views = realloc(views, capacity * sizeof(*views));
+                lengths = realloc(lengths, capacity * sizeof(*lengths));
+                if (copies == NULL || views == NULL || lengths == NULL)
+                {
+                    fprintf(stderr, "Error: could not reallocate memory for benchmark\n");
+                    return 1;
+                }
+            }
+            views[numwords] = ts.text + ts.starts[i];
+            lengths[numwords] = ts.lengths[i];
+            copies[numwords] = malloc(ts.lengths[i] + 1);
+            memcpy(copies[numwords], views[numwords], ts.lengths[i]);
+            copies[numwords][ts.lengths[i]] = '\0';
+            numwords++;
+        }
+        free_token_stream(&ts);
+        free_interner(&names);
+    }
+
+    // both methods must agree before timing means anything
+    for (size_t i = 0; i < numwords; i++)
+    {
+        keyword key;
+        classify_word(views[i], lengths[i], &key);
+        if (key != strcmp_chain_key(copies[i]))
+        {
+            fprintf(stderr, "Mismatch on '%s'\n", copies[i]);
+            return 1;
+        }
+    }
+
+    unsigned long checksum = 0;
+    double start = seconds_now();
+    for (int n = 0; n < iterations; n++)
+    {
+        for (size_t i = 0; i < numwords; i++)
+        {
+            checksum += strcmp_chain_key(copies[i]);
+        }
+    }
+    double chaintime = seconds_now() - start;
+
+    start = seconds_now();
+    for (int n = 0; n < iterations; n++)
+    {
+        for (size_t i = 0; i < numwords; i++)
+        {
+            keyword key;
+            checksum += classify_word(views[i], lengths[i], &key) + key;
+        }
+    }
+    double switchtime = seconds_now() - start;
+
+    double total = (double)numwords * iterations;
+    printf("words per pass:     %zu (x%d passes)\n", numwords, iterations);
+    printf("strcmp chain:       %8.2f ns/word\n", chaintime * 1e9 / total);
+    printf("classify_word:      %8.2f ns/word\n", switchtime * 1e9 / total);
+    printf("speedup:            %8.2fx\n", chaintime / switchtime);
+    printf("(checksum %lu)\n", checksum);
+
+    for (size_t i = 0; i < numwords; i++)
+    {
+        free(copies[i]);
+    }
+    for (int f = 0; f < numfiles; f++)
+    {
+        close_jack_source(&sources[f]);
+    }
+    free(copies);
+    free(views);
+    free(lengths);
+    free(sources);
+    return 0;
+}
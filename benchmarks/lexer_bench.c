@@ -0,0 +1,93 @@
+/*
+* Lexer throughput benchmark.
+*
+* Lexes each file into a token stream repeatedly and reports throughput in
+* MB/s and tokens/s. The default inputs are the OS and Pong sources in
+* testdirectory, which are heavily commented.
+*
+* Build from the repository root (add -mavx2 for the AVX2 scanner, or
+* -DCHARSCAN_SCALAR for the plain loops):
+*   gcc -O2 -I. benchmarks/lexer_bench.c jacktokenizer.c jacksource.c charscan.c interner.c
+*       symboltable.c tokenizerengine.c compilationengine.c syntaxtree.c codegenerator.c constantfolder.c vmwriter.c peephole.c arena.c
+*       xmlwriter.c compilestats.c -o lexer_bench
+* Run:
+*   ./lexer_bench [iterations] [file.jack ...]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../jacktokenizer.h"
+#include "../charscan.h"
+
+#define DEFAULT_ITERATIONS 500
+
+static const char* defaultfiles[] = {
+    "testdirectory/Array.jack", "testdirectory/Ball.jack", "testdirectory/Bat.jack", "testdirectory/Keyboard.jack",
+    "testdirectory/Main.jack", "testdirectory/Math.jack", "testdirectory/Memory.jack", "testdirectory/Output.jack",
+    "testdirectory/PongGame.jack", "testdirectory/Screen.jack", "testdirectory/String.jack", "testdirectory/Sys.jack"
+};
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    int numfiles = (argc > 2) ? argc - 2 : (int)(sizeof(defaultfiles) / sizeof(defaultfiles[0]));
+    const char** files = (argc > 2) ? (const char**)(argv + 2) : defaultfiles;
+
+    jacksource* sources = malloc(numfiles * sizeof(*sources));
+    if (sources == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for benchmark\n");
+        return 1;
+    }
+
+    size_t totalbytes = 0;
+    for (int f = 0; f < numfiles; f++)
+    {
+        FILE* infile = fopen(files[f], "r");
+        if (infile == NULL || !open_jack_source(&sources[f], infile))
+        {
+            fprintf(stderr, "Error: could not open %s\n", files[f]);
+            return 1;
+        }
+        fclose(infile);
+        totalbytes += sources[f].length;
+    }
+
+    size_t totaltokens = 0;
+    double start = seconds_now();
+    for (int n = 0; n < iterations; n++)
+    {
+        for (int f = 0; f < numfiles; f++)
+        {
+            tokenstream ts;
+            interner names;
+            initialize_interner(&names);
+            sources[f].position = 0;
+            lex_token_stream(&ts, &sources[f], &names);
+            totaltokens += ts.count;
+            free_token_stream(&ts);
+            free_interner(&names);
+        }
+    }
+    double elapsed = seconds_now() - start;
+
+    printf("scanner:     %s\n", charscan_implementation());
+    printf("input:       %d files, %zu bytes (x%d passes)\n", numfiles, totalbytes, iterations);
+    printf("throughput:  %.1f MB/s\n", ((double)totalbytes * iterations) / elapsed / 1e6);
+    printf("tokens:      %.1f M tokens/s\n", (double)totaltokens / elapsed / 1e6);
+
+    for (int f = 0; f < numfiles; f++)
+    {
+        close_jack_source(&sources[f]);
+    }
+    free(sources);
+    return 0;
+}
@@ -0,0 +1,197 @@
+/*
+* Symbol table benchmark.
+*
+* Defines N symbols and then looks each one up, for N = 10, 1,000 and
+* 100,000, with the open-addressing symboltable and with a copy of the
+* fixed 31-bucket chained table it replaced (malloc per node, append at the
+* tail of the chain).
+*
+* Build from the repository root:
+*   gcc -O2 -I. benchmarks/symboltable_bench.c symboltable.c interner.c -o symboltable_bench
+* Run:
+*   ./symboltable_bench
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "../symboltable.h"
+
+#define CHAINED_TABLE_SIZE 31
+#define OPS_PER_SIZE 2000000 // each size repeats its work until it has done about this many inserts
+
+typedef struct chainednode
+{
+    atom name;
+    atom type;
+    symbolkind kind;
+    unsigned int index;
+    struct chainednode* next;
+} chainednode;
+
+static void chained_append(chainednode** headnodes, chainednode* newnode)
+{
+    unsigned int hashval = newnode->name % CHAINED_TABLE_SIZE;
+    if (headnodes[hashval] == NULL)
+    {
+        headnodes[hashval] = newnode;
+    }
+    else
+    {
+        chainednode* temp = headnodes[hashval];
+        while (temp->next != NULL)
+        {
+            temp = temp->next;
+        }
+        temp->next = newnode;
+    }
+}
+
+static chainednode* chained_search(chainednode** headnodes, atom name)
+{
+    chainednode* temp = headnodes[name % CHAINED_TABLE_SIZE];
+    while (temp != NULL && temp->name != name)
+    {
+        temp = temp->next;
+    }
+    return temp;
+}
+
+static void chained_free(chainednode** headnodes)
+{
+    for (size_t i = 0; i < CHAINED_TABLE_SIZE; i++)
+    {
+        chainednode* temp = headnodes[i];
+        while (temp != NULL)
+        {
+            chainednode* next = temp->next;
+            free(temp);
+            temp = next;
+        }
+        headnodes[i] = NULL;
+    }
+}
+
+static double seconds_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    static const size_t sizes[] = { 10, 1000, 100000 };
+
+    printf("%10s  %-16s %14s %14s\n", "symbols", "table", "ns/define", "ns/lookup");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        size_t n = sizes[s];
+        size_t rounds = (OPS_PER_SIZE / n > 0) ? OPS_PER_SIZE / n : 1;
+        if (n >= 100000)
+        {
+            rounds = 1; // the chained table is quadratic here, one round is plenty
+        }
+
+        interner names;
+        initialize_interner(&names);
+        atom* atoms = malloc(n * sizeof(*atoms));
+        atom* lookuporder = malloc(n * sizeof(*lookuporder));
+        if (atoms == NULL || lookuporder == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate memory for benchmark\n");
+            return 1;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            char name[32];
+            int length = snprintf(name, sizeof(name), "symbol%zu", i);
+            atoms[i] = intern_string(&names, name, (size_t)length);
+            lookuporder[i] = atoms[i];
+        }
+        srand(1);
+        for (size_t i = n - 1; i > 0; i--)
+        {
+            size_t j = (size_t)rand() % (i + 1);
+            atom temp = lookuporder[i];
+            lookuporder[i] = lookuporder[j];
+            lookuporder[j] = temp;
+        }
+        atom typeatom = intern_string(&names, "int", 3);
+
+        // open addressing
+        unsigned long checksum = 0;
+        double definetime = 0.0;
+        double lookuptime = 0.0;
+        for (size_t r = 0; r < rounds; r++)
+        {
+            symboltable st;
+            double start = seconds_now();
+            initialize_symbol_table(&st, &names);
+            for (size_t i = 0; i < n; i++)
+            {
+                tablenode node;
+                initialize_blank_node(&node);
+                define(&node, atoms[i], typeatom, SK_VAR);
+                node.index = st.varindex++;
+                append_node(&st, &node);
+            }
+            definetime += seconds_now() - start;
+
+            start = seconds_now();
+            for (size_t i = 0; i < n; i++)
+            {
+                checksum += (unsigned long)index_of(&st, lookuporder[i]);
+            }
+            lookuptime += seconds_now() - start;
+            free_symbol_table_nodes(&st);
+        }
+        printf("%10zu  %-16s %14.1f %14.1f\n", n, "open addressing", definetime * 1e9 / (double)(n * rounds),
+            lookuptime * 1e9 / (double)(n * rounds));
+
+        // the old chained table
+        definetime = 0.0;
+        lookuptime = 0.0;
+        for (size_t r = 0; r < rounds; r++)
+        {
+            chainednode* headnodes[CHAINED_TABLE_SIZE] = { NULL };
+            double start = seconds_now();
+            for (size_t i = 0; i < n; i++)
+            {
+                chainednode* node = malloc(sizeof(*node));
+                if (node == NULL)
+                {
+                    fprintf(stderr, "Error: could not allocate memory for node\n");
+                    return 1;
+                }
+                node->name = atoms[i];
+                node->type = typeatom;
+                node->kind = SK_VAR;
+                node->index = (unsigned int)i;
+                node->next = NULL;
+                chained_append(headnodes, node);
+            }
+            definetime += seconds_now() - start;
+
+            start = seconds_now();
+            for (size_t i = 0; i < n; i++)
+            {
+                checksum -= chained_search(headnodes, lookuporder[i])->index;
+            }
+            lookuptime += seconds_now() - start;
+            chained_free(headnodes);
+        }
+        printf("%10zu  %-16s %14.1f %14.1f\n", n, "chained (old)", definetime * 1e9 / (double)(n * rounds),
+            lookuptime * 1e9 / (double)(n * rounds));
+
+        if (checksum != 0)
+        {
+            fprintf(stderr, "Error: tables disagree on symbol indices\n");
+            return 1;
+        }
+        free(atoms);
+        free(lookuporder);
+        free_interner(&names);
+    }
+    return 0;
+}
@@ -0,0 +1,242 @@
+#include "buildcache.h"
+#include <stdlib.h>
+#include <string.h>
+#include "jacksource.h"
+#include "filehandling.h"
+
+#define FNV_PRIME 1099511628211ULL
+#define MAX_MANIFEST_LINE 4096
+
+
+/*
+* 64-bit FNV-1a. Pass FNV_OFFSET_BASIS (via hash_file_contents) or a previous
+* result as the seed to hash several pieces as one.
+*/
+unsigned long long hash_bytes(const char* data, size_t length, unsigned long long seed)
+{
+    unsigned long long hashval = seed;
+    for (size_t i = 0; i < length; i++)
+    {
+        hashval ^= (unsigned char)data[i];
+        hashval *= FNV_PRIME;
+    }
+    return hashval;
+}
+
+bool hash_file_contents(const char* filename, unsigned long long* hash)
+{
+    FILE* infile = fopen(filename, "r");
+    if (infile == NULL)
+    {
+        return false;
+    }
+    jacksource source;
+    bool success = open_jack_source(&source, infile);
+    if (success)
+    {
+        *hash = hash_bytes(source.data, source.length, FNV_OFFSET_BASIS);
+        close_jack_source(&source);
+    }
+    fclose(infile);
+    return success;
+}
+
+
+/*
+* Returns a malloc'd "directory/.jackcache".
+*/
+static char* make_manifest_filename(const char* directoryname)
+{
+    size_t length = strlen(directoryname) + strlen(PATH_SEPARATOR) + strlen(CACHE_MANIFEST_NAME) + 1; // +1 for NUL
+    char* filename = malloc(length * sizeof(*filename));
+    if (filename == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for manifest filename\n");
+        exit(1);
+    }
+    snprintf(filename, length, "%s%s%s", directoryname, PATH_SEPARATOR, CACHE_MANIFEST_NAME);
+    return filename;
+}
+
+void add_cache_entry(buildcache* cache, const char* name, unsigned long long hash)
+{
+    if (cache->count == cache->capacity)
+    {
+        size_t newcapacity = (cache->capacity == 0) ? 64 : cache->capacity * 2;
+        cacheentry* temp = realloc(cache->entries, newcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for build cache\n");
+            exit(1);
+        }
+        cache->entries = temp;
+        cache->capacity = newcapacity;
+    }
+    cacheentry* entry = &cache->entries[cache->count++];
+    entry->name = malloc((strlen(name) + 1) * sizeof(*(entry->name))); // +1 for NUL
+    if (entry->name == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for build cache\n");
+        exit(1);
+    }
+    strcpy(entry->name, name);
+    entry->hash = hash;
+}
+
+static int compare_entries(const void* a, const void* b)
+{
+    return strcmp(((const cacheentry*)a)->name, ((const cacheentry*)b)->name);
+}
+
+
+/*
+* Reads the manifest left by the previous build. If it is missing, can't be
+* parsed, or was written with different options, the cache is left empty so
+* every file counts as changed.
+*/
+void load_build_cache(buildcache* cache, const char* directoryname, unsigned long long optionskey)
+{
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+    cache->optionskey = optionskey;
+
+    char* filename = make_manifest_filename(directoryname);
+    FILE* manifest = fopen(filename, "r");
+    free(filename);
+    if (manifest == NULL)
+    {
+        return;
+    }
+
+    char line[MAX_MANIFEST_LINE];
+    unsigned long long key = 0;
+    if (fgets(line, sizeof(line), manifest) == NULL
+        || strncmp(line, CACHE_MANIFEST_HEADER " ", strlen(CACHE_MANIFEST_HEADER) + 1) != 0
+        || sscanf(line + strlen(CACHE_MANIFEST_HEADER) + 1, "%16llx", &key) != 1 || key != optionskey)
+    {
+        fclose(manifest);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), manifest) != NULL)
+    {
+        unsigned long long hash = 0;
+        int nameoffset = 0;
+        line[strcspn(line, "\r\n")] = '\0';
+        if (sscanf(line, "%16llx %n", &hash, &nameoffset) != 1 || nameoffset == 0 || line[nameoffset] == '\0')
+        {
+            // a damaged manifest just means a full rebuild
+            free_build_cache(cache);
+            break;
+        }
+        add_cache_entry(cache, line + nameoffset, hash);
+    }
+    fclose(manifest);
+
+    if (cache->count > 1)
+    {
+        qsort(cache->entries, cache->count, sizeof(*(cache->entries)), compare_entries);
+    }
+}
+
+bool find_cached_hash(const buildcache* cache, const char* name, unsigned long long* hash)
+{
+    cacheentry key;
+    key.name = (char*)name;
+    const cacheentry* entry = (cache->count == 0) ? NULL
+        : bsearch(&key, cache->entries, cache->count, sizeof(*(cache->entries)), compare_entries);
+    if (entry == NULL)
+    {
+        return false;
+    }
+    *hash = entry->hash;
+    return true;
+}
+
+
+/*
+* Records hash for name, replacing any earlier entry and keeping the entries
+* sorted. Used when single files are rebuilt in watch mode.
+*/
+void set_cache_entry(buildcache* cache, const char* name, unsigned long long hash)
+{
+    size_t position = 0;
+    while (position < cache->count && strcmp(cache->entries[position].name, name) < 0)
+    {
+        position++;
+    }
+    if (position < cache->count && strcmp(cache->entries[position].name, name) == 0)
+    {
+        cache->entries[position].hash = hash;
+        return;
+    }
+
+    add_cache_entry(cache, name, hash);
+    cacheentry added = cache->entries[cache->count - 1];
+    memmove(&cache->entries[position + 1], &cache->entries[position], (cache->count - 1 - position) * sizeof(added));
+    cache->entries[position] = added;
+}
+
+void remove_cache_entry(buildcache* cache, const char* name)
+{
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        if (strcmp(cache->entries[i].name, name) == 0)
+        {
+            free(cache->entries[i].name);
+            memmove(&cache->entries[i], &cache->entries[i + 1], (cache->count - 1 - i) * sizeof(cache->entries[i]));
+            cache->count--;
+            return;
+        }
+    }
+}
+
+/*
+* Writes the manifest to a temporary file and renames it into place, so an
+* interrupted build never leaves a half-written manifest behind.
+*/
+bool save_build_cache(const buildcache* cache, const char* directoryname)
+{
+    char* filename = make_manifest_filename(directoryname);
+    char* tempname = malloc((strlen(filename) + 5) * sizeof(*tempname)); // +4 for ".tmp", +1 for NUL
+    if (tempname == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for manifest filename\n");
+        exit(1);
+    }
+    strcpy(tempname, filename);
+    strcat(tempname, ".tmp");
+
+    bool success = false;
+    FILE* manifest = fopen(tempname, "w");
+    if (manifest != NULL)
+    {
+        fprintf(manifest, "%s %016llx\n", CACHE_MANIFEST_HEADER, cache->optionskey);
+        for (size_t i = 0; i < cache->count; i++)
+        {
+            fprintf(manifest, "%016llx %s\n", cache->entries[i].hash, cache->entries[i].name);
+        }
+        success = (fclose(manifest) == 0) && (rename(tempname, filename) == 0);
+    }
+    if (!success)
+    {
+        fprintf(stderr, "Error: could not write build cache %s\n", filename);
+        remove(tempname);
+    }
+    free(tempname);
+    free(filename);
+    return success;
+}
+
+void free_build_cache(buildcache* cache)
+{
+    for (size_t i = 0; i < cache->count; i++)
+    {
+        free(cache->entries[i].name);
+    }
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->count = 0;
+    cache->capacity = 0;
+}
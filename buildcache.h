@@ -0,0 +1,44 @@
+#ifndef BUILDCACHE_H
+#define BUILDCACHE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CACHE_MANIFEST_NAME ".jackcache" // kept in the directory being compiled
+#define CACHE_MANIFEST_HEADER "jackcache 1" // bump when the manifest format changes
+#define FNV_OFFSET_BASIS 14695981039346656037ULL // seed for hash_bytes()
+
+// Manifest format, one text line each:
+//   jackcache 1 <options key, 16 hex digits>
+//   <content hash, 16 hex digits> <file name>
+// A file is up to date when its name is listed with the hash of its current
+// contents, the options key matches and its outputs still exist.
+
+// the hash recorded for one .jack file
+typedef struct cacheentry
+{
+    char* name; // as found in the directory, without the path
+    unsigned long long hash;
+} cacheentry;
+
+// the manifest from the previous build, sorted by name
+typedef struct buildcache
+{
+    cacheentry* entries;
+    size_t count;
+    size_t capacity;
+    unsigned long long optionskey;
+} buildcache;
+
+void load_build_cache(buildcache* cache, const char* directoryname, unsigned long long optionskey); // empty if missing, stale or unreadable
+bool find_cached_hash(const buildcache* cache, const char* name, unsigned long long* hash);
+bool save_build_cache(const buildcache* cache, const char* directoryname);
+void add_cache_entry(buildcache* cache, const char* name, unsigned long long hash); // names must be added in sorted order
+void set_cache_entry(buildcache* cache, const char* name, unsigned long long hash); // adds or updates, any order
+void remove_cache_entry(buildcache* cache, const char* name);
+void free_build_cache(buildcache* cache);
+unsigned long long hash_bytes(const char* data, size_t length, unsigned long long seed); // 64-bit FNV-1a
+bool hash_file_contents(const char* filename, unsigned long long* hash);
+
+#endif // BUILDCACHE_H
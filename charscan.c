@@ -0,0 +1,171 @@
+#include "charscan.h"
+#include <stdint.h>
+
+#if !defined(CHARSCAN_SCALAR) && defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define CHARSCAN_VECTOR_WIDTH 32
+#define CHARSCAN_FULL_MASK 0xFFFFFFFFu
+typedef __m256i scanvector;
+
+static inline scanvector load_chunk(const char* p)
+{
+    return _mm256_loadu_si256((const __m256i*)p);
+}
+
+static inline uint32_t match_mask(scanvector chunk, char c)
+{
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c)));
+}
+
+#elif !defined(CHARSCAN_SCALAR) && defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define CHARSCAN_VECTOR_WIDTH 16
+#define CHARSCAN_FULL_MASK 0xFFFFu
+typedef __m128i scanvector;
+
+static inline scanvector load_chunk(const char* p)
+{
+    return _mm_loadu_si128((const __m128i*)p);
+}
+
+static inline uint32_t match_mask(scanvector chunk, char c)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+}
+#endif
+
+#ifdef CHARSCAN_VECTOR_WIDTH
+// mask of the bits below bit, i.e. the bytes of a chunk before index bit
+#define BITS_BELOW(bit) ((1u << (bit)) - 1u)
+#endif
+
+
+/*
+* Skips spaces, tabs, carriage returns and newlines starting at position.
+* Most runs between tokens are a single space, so one scalar check runs first;
+* indentation and blank lines get the vector loop.
+*/
+size_t skip_whitespace_run(const char* data, size_t position, size_t length, int* newlines)
+{
+#ifdef CHARSCAN_VECTOR_WIDTH
+    while (position + CHARSCAN_VECTOR_WIDTH <= length)
+    {
+        char c = data[position];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            return position;
+        }
+
+        scanvector chunk = load_chunk(data + position);
+        uint32_t newlinemask = match_mask(chunk, '\n');
+        uint32_t spacemask = match_mask(chunk, ' ') | match_mask(chunk, '\t') | match_mask(chunk, '\r') | newlinemask;
+        if (spacemask != CHARSCAN_FULL_MASK)
+        {
+            int stop = __builtin_ctz(~spacemask);
+            *newlines += __builtin_popcount(newlinemask & BITS_BELOW(stop));
+            return position + stop;
+        }
+        *newlines += __builtin_popcount(newlinemask);
+        position += CHARSCAN_VECTOR_WIDTH;
+    }
+#endif
+    while (position < length)
+    {
+        char c = data[position];
+        if (c == '\n')
+        {
+            (*newlines)++;
+        }
+        else if (c != ' ' && c != '\t' && c != '\r')
+        {
+            break;
+        }
+        position++;
+    }
+    return position;
+}
+
+
+/*
+* Returns the index just past the next newline at or after position, or
+* length if there isn't one.
+*/
+size_t find_line_end(const char* data, size_t position, size_t length)
+{
+#ifdef CHARSCAN_VECTOR_WIDTH
+    while (position + CHARSCAN_VECTOR_WIDTH <= length)
+    {
+        uint32_t newlinemask = match_mask(load_chunk(data + position), '\n');
+        if (newlinemask != 0)
+        {
+            return position + __builtin_ctz(newlinemask) + 1;
+        }
+        position += CHARSCAN_VECTOR_WIDTH;
+    }
+#endif
+    while (position < length)
+    {
+        if (data[position] == '\n')
+        {
+            return position + 1;
+        }
+        position++;
+    }
+    return length;
+}
+
+
+/*
+* Returns the index just past the next star-slash at or after position, or
+* length if the comment is never closed. Newlines inside the comment are
+* added to *newlines.
+*/
+size_t find_block_comment_end(const char* data, size_t position, size_t length, int* newlines)
+{
+#ifdef CHARSCAN_VECTOR_WIDTH
+    while (position + CHARSCAN_VECTOR_WIDTH <= length)
+    {
+        scanvector chunk = load_chunk(data + position);
+        uint32_t starmask = match_mask(chunk, '*');
+        uint32_t newlinemask = match_mask(chunk, '\n');
+        while (starmask != 0)
+        {
+            int bit = __builtin_ctz(starmask);
+            if (position + bit + 1 < length && data[position + bit + 1] == '/')
+            {
+                *newlines += __builtin_popcount(newlinemask & BITS_BELOW(bit));
+                return position + bit + 2;
+            }
+            starmask &= starmask - 1; // clear the lowest set bit
+        }
+        *newlines += __builtin_popcount(newlinemask);
+        position += CHARSCAN_VECTOR_WIDTH;
+    }
+#endif
+    while (position < length)
+    {
+        char c = data[position];
+        position++;
+        if (c == '\n')
+        {
+            (*newlines)++;
+        }
+        else if (c == '*' && position < length && data[position] == '/')
+        {
+            return position + 1;
+        }
+    }
+    return length;
+}
+
+
+const char* charscan_implementation(void)
+{
+#if defined(CHARSCAN_VECTOR_WIDTH) && CHARSCAN_VECTOR_WIDTH == 32
+    return "avx2";
+#elif defined(CHARSCAN_VECTOR_WIDTH)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
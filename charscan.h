@@ -0,0 +1,18 @@
+#ifndef CHARSCAN_H
+#define CHARSCAN_H
+
+#include <stddef.h>
+
+// Bulk scanning over the source buffer for the parts of a .jack file that
+// are not tokens: whitespace runs, // comment lines and /* */ comment bodies.
+// Uses AVX2 or SSE2 when the compiler targets them, otherwise plain loops.
+// Define CHARSCAN_SCALAR to force the plain loops.
+// Each function takes the index to start at and returns the index to continue
+// lexing from; newlines crossed are added to *newlines where applicable.
+
+size_t skip_whitespace_run(const char* data, size_t position, size_t length, int* newlines);
+size_t find_line_end(const char* data, size_t position, size_t length); // returns index just past the '\n'
+size_t find_block_comment_end(const char* data, size_t position, size_t length, int* newlines); // returns index just past the "*/"
+const char* charscan_implementation(void); // "avx2", "sse2" or "scalar"
+
+#endif // CHARSCAN_H
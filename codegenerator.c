@@ -0,0 +1,855 @@
+#include "codegenerator.h"
+#include <stdlib.h>
+#include <string.h>
+#include "constantfolder.h"
+#include "options.h"
+
+/*
+* Walks the syntax tree built by compilationengine.c and writes the VM code
+* for it. Everything is visited in source order and labels are numbered as
+* they're reached, so the output is the same as emitting code while
+* parsing would give.
+*/
+
+static void generate_statements(codegenerator* gen, const statement* s);
+static void generate_expression(codegenerator* gen, const expression* e);
+
+
+/*
+* Returns "classname.subroutinename" in the scratch arena.
+*/
+static const char* make_vm_name(codegenerator* gen, atom classname, atom subroutinename)
+{
+    size_t classlength = atom_length(gen->names, classname);
+    size_t namelength = atom_length(gen->names, subroutinename);
+    char* name = arena_alloc(gen->scratch, (classlength + namelength + 2) * sizeof(*name)); // +1 for '.' and +1 for NUL
+    memcpy(name, atom_text(gen->names, classname), classlength);
+    name[classlength] = '.';
+    memcpy(name + classlength + 1, atom_text(gen->names, subroutinename), namelength);
+    name[classlength + 1 + namelength] = '\0';
+    return name;
+}
+
+/*
+* Pushes a word. Only constant folding produces negative ones.
+*/
+static void push_constant(codegenerator* gen, int value)
+{
+    if (value >= 0)
+    {
+        write_push(gen->vm, VMS_CONST, value);
+    }
+    else if (value == WORD_MIN)
+    {
+        write_push(gen->vm, VMS_CONST, WORD_MAX); // its complement, as WORD_MIN has no positive counterpart to negate
+        write_arithmetic(gen->vm, VMC_NOT);
+    }
+    else
+    {
+        write_push(gen->vm, VMS_CONST, -value);
+        write_arithmetic(gen->vm, VMC_NEG);
+    }
+}
+
+static void push_variable(codegenerator* gen, const variableref* variable)
+{
+    write_push(gen->vm, convert_symbolkind_to_vmsegment(variable->kind), variable->index);
+}
+
+
+/*
+* Strength reduction. Math.multiply and Math.divide each run a Jack loop of
+* up to 16 iterations, so multiplying or dividing by a constant is compiled
+* into VM arithmetic instead. Results are exactly the 16-bit ones the calls
+* would give: the low 16 bits of the product, and quotients that round
+* toward zero.
+*/
+
+/*
+* Like constant_value, but also takes a negated literal such as -50, which
+* is only a single literal once constants have been folded.
+*/
+static bool constant_operand(const expression* e, int* value)
+{
+    int x;
+    if (e != NULL && e->kind == EX_UNARY && e->as.unary.op == '-' && e->as.unary.operand != NULL
+        && e->as.unary.operand->kind == EX_INT && constant_value(e->as.unary.operand, &x))
+    {
+        *value = to_word(-(long)x);
+        return true;
+    }
+    return constant_value(e, value);
+}
+
+static unsigned int count_bits(unsigned int x)
+{
+    unsigned int count = 0;
+    for (; x != 0; x &= x - 1)
+    {
+        count++;
+    }
+    return count;
+}
+
+static int highest_bit(unsigned int x)
+{
+    int bit = -1;
+    for (; x != 0; x >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+}
+
+static bool can_reduce_multiply(int c)
+{
+    return c != WORD_MIN && count_bits((unsigned int)abs(c)) <= MAX_REDUCED_ADDITIONS + 1;
+}
+
+static bool can_reduce_divide(int c)
+{
+    return c != 0 && c != WORD_MIN && count_bits((unsigned int)abs(c)) == 1;
+}
+
+/*
+* operand * c by doubling and adding, from the highest bit of c down. The
+* VM has no dup, so the product is doubled through a temp. A plain variable
+* is pushed again where it's added; anything else is computed once and kept
+* in a temp. No calls happen between storing a temp and reading it back.
+*/
+static void generate_multiply_by_constant(codegenerator* gen, const expression* operand, int c)
+{
+    generate_expression(gen, operand);
+    if (c == 0)
+    {
+        write_pop(gen->vm, VMS_TEMP, 0); // the operand may have side effects, so it is still computed
+        write_push(gen->vm, VMS_CONST, 0);
+        return;
+    }
+
+    unsigned int multiplier = (unsigned int)abs(c);
+    bool repush = operand != NULL && operand->kind == EX_VARIABLE && operand->as.variable.index == NULL;
+    if (!repush && count_bits(multiplier) > 1)
+    {
+        write_pop(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+        write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+    }
+
+    bool productisoperand = true; // while it is, doubling can add the operand instead of going through a temp
+    for (int bit = highest_bit(multiplier) - 1; bit >= 0; bit--)
+    {
+        if (productisoperand && repush)
+        {
+            push_variable(gen, &operand->as.variable.variable);
+        }
+        else if (productisoperand && count_bits(multiplier) > 1)
+        {
+            write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+        }
+        else
+        {
+            write_pop(gen->vm, VMS_TEMP, REDUCED_PRODUCT_TEMP);
+            write_push(gen->vm, VMS_TEMP, REDUCED_PRODUCT_TEMP);
+            write_push(gen->vm, VMS_TEMP, REDUCED_PRODUCT_TEMP);
+        }
+        write_arithmetic(gen->vm, VMC_ADD);
+        productisoperand = false;
+
+        if (multiplier & (1u << bit))
+        {
+            if (repush)
+            {
+                push_variable(gen, &operand->as.variable.variable);
+            }
+            else
+            {
+                write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+            }
+            write_arithmetic(gen->vm, VMC_ADD);
+        }
+    }
+
+    if (c < 0)
+    {
+        write_arithmetic(gen->vm, VMC_NEG);
+    }
+}
+
+/*
+* operand / c, for c a power of 2 (or its negation). The VM can't shift, so
+* each bit of the quotient is tested on its own: a negative operand is first
+* biased by |c| - 1 so that the result rounds toward zero, then bits k to 14
+* of it become bits 0 to 14 - k of the quotient and its sign fills the rest.
+*/
+static void generate_divide_by_constant(codegenerator* gen, const expression* operand, int c)
+{
+    int divisor = abs(c);
+    int shift = highest_bit((unsigned int)divisor);
+
+    generate_expression(gen, operand);
+    if (shift > 0)
+    {
+        write_pop(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+        write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+        write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+        write_push(gen->vm, VMS_CONST, 0);
+        write_arithmetic(gen->vm, VMC_LT);
+        write_push(gen->vm, VMS_CONST, divisor - 1);
+        write_arithmetic(gen->vm, VMC_AND);
+        write_arithmetic(gen->vm, VMC_ADD);
+        write_pop(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+
+        for (int bit = shift; bit < 15; bit++)
+        {
+            write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+            write_push(gen->vm, VMS_CONST, 1 << bit);
+            write_arithmetic(gen->vm, VMC_AND);
+            write_push(gen->vm, VMS_CONST, 0);
+            write_arithmetic(gen->vm, VMC_GT); // true (all ones) if the bit is set
+            write_push(gen->vm, VMS_CONST, 1 << (bit - shift));
+            write_arithmetic(gen->vm, VMC_AND);
+            if (bit > shift)
+            {
+                write_arithmetic(gen->vm, VMC_ADD);
+            }
+        }
+
+        write_push(gen->vm, VMS_TEMP, REDUCED_OPERAND_TEMP);
+        write_push(gen->vm, VMS_CONST, 0);
+        write_arithmetic(gen->vm, VMC_LT);
+        push_constant(gen, -(1 << (15 - shift))); // the sign, copied into every bit from 15 - k up
+        write_arithmetic(gen->vm, VMC_AND);
+        write_arithmetic(gen->vm, VMC_ADD);
+    }
+
+    if (c < 0)
+    {
+        write_arithmetic(gen->vm, VMC_NEG);
+    }
+}
+
+/*
+* Generates left op right if it can be done without calling Math, for op
+* '*' or '/'. Returns false, having written nothing, if it can't.
+*/
+static bool generate_reduced_operator(codegenerator* gen, char op, const expression* left, const expression* right)
+{
+    if (!(gen->optimizations & OPT_STRENGTH))
+    {
+        return false;
+    }
+
+    int c;
+    if (op == '*' && constant_operand(right, &c) && can_reduce_multiply(c))
+    {
+        generate_multiply_by_constant(gen, left, c);
+    }
+    else if (op == '*' && constant_operand(left, &c) && can_reduce_multiply(c))
+    {
+        generate_multiply_by_constant(gen, right, c); // the constant has no side effects, so the order doesn't matter
+    }
+    else if (op == '/' && constant_operand(right, &c) && can_reduce_divide(c))
+    {
+        generate_divide_by_constant(gen, left, c);
+    }
+    else
+    {
+        return false;
+    }
+
+    if (gen->stats != NULL)
+    {
+        gen->stats->reduced++;
+    }
+    return true;
+}
+
+/*
+* Math.multiply(x, y) and Math.divide(x, y) written out as calls are reduced
+* the same way as x * y and x / y.
+*/
+static bool generate_reduced_call(codegenerator* gen, const callnode* call)
+{
+    // numargs also counts arguments that failed to parse, which aren't in the list
+    if (!(gen->optimizations & OPT_STRENGTH) || call->kind != CALL_FUNCTION || call->numargs != 2
+        || call->arguments == NULL || call->arguments->next == NULL
+        || strcmp(atom_text(gen->names, call->classname), "Math") != 0)
+    {
+        return false;
+    }
+
+    const char* name = atom_text(gen->names, call->subroutinename);
+    char op;
+    if (strcmp(name, "multiply") == 0)
+    {
+        op = '*';
+    }
+    else if (strcmp(name, "divide") == 0)
+    {
+        op = '/';
+    }
+    else
+    {
+        return false;
+    }
+    return generate_reduced_operator(gen, op, call->arguments, call->arguments->next);
+}
+
+
+/*
+* Method calls must first push a reference to the object being operated on.
+*/
+static void generate_call(codegenerator* gen, const callnode* call)
+{
+    if (generate_reduced_call(gen, call))
+    {
+        return;
+    }
+
+    unsigned int numargs = call->numargs;
+    if (call->kind == CALL_SELF)
+    {
+        // push pointer 0, which points to the "this" object (i.e. the "this" memory segment)
+        // the current method is already operating on "this," but pushing the pointer
+        // makes sure any called methods receive a reference to the same (current) object
+        write_push(gen->vm, VMS_POINTER, 0);
+        numargs++;
+    }
+    else if (call->kind == CALL_METHOD)
+    {
+        push_variable(gen, &call->object);
+        numargs++;
+    }
+
+    for (const expression* argument = call->arguments; argument != NULL; argument = argument->next)
+    {
+        generate_expression(gen, argument);
+    }
+    write_call(gen->vm, make_vm_name(gen, call->classname, call->subroutinename), numargs);
+}
+
+/*
+* Builds a new String holding the literal e, one call per char.
+*/
+static void generate_new_string(codegenerator* gen, const expression* e)
+{
+    write_push(gen->vm, VMS_CONST, (int)e->as.string.length);
+    write_call(gen->vm, "String.new", 1);
+    for (size_t i = 0; i < e->as.string.length; i++)
+    {
+        write_push(gen->vm, VMS_CONST, e->as.string.text[i]); // implicitly casting to int when passing
+        write_call(gen->vm, "String.appendChar", 2);
+    }
+}
+
+
+/*
+* The string literal pool. Normally every evaluation of a literal builds a
+* new String, which is never freed. With OPT_STRINGS each distinct literal
+* of a class is built the first time it's evaluated and kept in a static
+* numbered after the class's own, so later evaluations are a push and a
+* branch. Statics start out as 0 (null), which marks a literal not yet
+* built. Every use of a literal then shares one String, so code that
+* changes or disposes of a literal it was given would see that change the
+* next time round; that's why the pool isn't part of "all".
+*/
+
+/*
+* Returns the pool index of the literal e, adding it if it's new. Classes
+* have few literals, so a linear search is plenty.
+*/
+static unsigned int find_pooled_string(codegenerator* gen, const expression* e)
+{
+    stringpool* pool = &gen->strings;
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        const expression* literal = pool->literals[i];
+        if (literal->as.string.length == e->as.string.length
+            && memcmp(literal->as.string.text, e->as.string.text, e->as.string.length) == 0)
+        {
+            return (unsigned int)i;
+        }
+    }
+
+    if (pool->count == pool->capacity)
+    {
+        size_t newcapacity = (pool->capacity == 0) ? INITIAL_STRING_POOL_SIZE : pool->capacity * 2;
+        const expression** temp = realloc(pool->literals, newcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for string pool\n");
+            exit(1);
+        }
+        pool->literals = temp;
+        pool->capacity = newcapacity;
+    }
+    pool->literals[pool->count] = e;
+    if (gen->stats != NULL)
+    {
+        gen->stats->pooledstrings++;
+    }
+    return (unsigned int)pool->count++;
+}
+
+static void generate_pooled_string(codegenerator* gen, const expression* e)
+{
+    int slot = (int)(gen->strings.firststatic + find_pooled_string(gen, e));
+    char readylabel[MAX_LABEL_LENGTH];
+    snprintf(readylabel, sizeof(readylabel), "STRING_READY%u", gen->labelcounts.stringcount);
+    gen->labelcounts.stringcount++;
+
+    write_push(gen->vm, VMS_STATIC, slot);
+    write_if(gen->vm, readylabel);
+    generate_new_string(gen, e);
+    write_pop(gen->vm, VMS_STATIC, slot);
+    write_label(gen->vm, readylabel);
+    write_push(gen->vm, VMS_STATIC, slot);
+}
+
+
+static void generate_expression(codegenerator* gen, const expression* e)
+{
+    if (e == NULL)
+    {
+        return; // a term the parser couldn't make sense of
+    }
+
+    switch (e->kind)
+    {
+        case EX_INT:
+            push_constant(gen, e->as.intval);
+            break;
+        case EX_STRING:
+            if (gen->optimizations & OPT_STRINGS)
+            {
+                generate_pooled_string(gen, e);
+            }
+            else
+            {
+                generate_new_string(gen, e);
+            }
+            break;
+        case EX_TRUE:
+            write_push(gen->vm, VMS_CONST, 1);
+            write_arithmetic(gen->vm, VMC_NEG);
+            break;
+        case EX_FALSE:
+        case EX_NULL:
+            write_push(gen->vm, VMS_CONST, 0);
+            break;
+        case EX_THIS:
+            write_push(gen->vm, VMS_POINTER, 0);
+            break;
+        case EX_VARIABLE:
+            push_variable(gen, &e->as.variable.variable);
+            if (e->as.variable.index != NULL)
+            {
+                // This is an array entry, so push the variable (which points to the base
+                // of the array), then calculate the index and add. Next, we set the "that"
+                // segment to point to this memory location, then push "that 0", which puts
+                // the value found at that memory location on the stack.
+                generate_expression(gen, e->as.variable.index);
+                write_arithmetic(gen->vm, VMC_ADD);
+                write_pop(gen->vm, VMS_POINTER, 1);
+                write_push(gen->vm, VMS_THAT, 0);
+            }
+            break;
+        case EX_CALL:
+            generate_call(gen, &e->as.call);
+            break;
+        case EX_UNARY:
+            generate_expression(gen, e->as.unary.operand);
+            write_arithmetic(gen->vm, convert_unary_operator_to_vmcommand(e->as.unary.op));
+            break;
+        case EX_BINARY:
+            if (generate_reduced_operator(gen, e->as.binary.op, e->as.binary.left, e->as.binary.right))
+            {
+                break;
+            }
+            generate_expression(gen, e->as.binary.left);
+            generate_expression(gen, e->as.binary.right);
+            write_arithmetic(gen->vm, convert_binary_operator_to_vmcommand(e->as.binary.op));
+            break;
+    }
+}
+
+
+static void generate_let(codegenerator* gen, const statement* s)
+{
+    const variableref* target = &s->as.let.target;
+    if (s->as.let.index == NULL)
+    {
+        generate_expression(gen, s->as.let.value);
+        write_pop(gen->vm, convert_symbolkind_to_vmsegment(target->kind), target->index);
+        return;
+    }
+
+    // This is an array entry, so push the variable (which points to the base of the
+    // array), then calculate the index and add it to the base. Next, we set the "that"
+    // segment to point to this memory location (via pointer 1). After calculating the
+    // value we want to store, we can pop it to "that 0".
+
+    // BUT, because the "that" segment can change when calculating the upcoming expression,
+    // the location is stored in a temp variable until we're ready to pop the value we want to assign.
+    push_variable(gen, target);
+    generate_expression(gen, s->as.let.index);
+    write_arithmetic(gen->vm, VMC_ADD);
+    write_pop(gen->vm, VMS_TEMP, 1);
+
+    generate_expression(gen, s->as.let.value); // the value we want to store
+
+    write_push(gen->vm, VMS_TEMP, 1); // put the pointer value for the array element back on the stack
+    write_pop(gen->vm, VMS_POINTER, 1);
+    write_pop(gen->vm, VMS_THAT, 0);
+}
+
+/*
+* Branch layout. The book's code for while and if has an extra not or goto
+* on every pass; with OPT_BRANCHES each statement gets the layout that runs
+* the fewest branches for its condition instead. The book's code decides
+* differently for the two statements: if takes its then arm when the
+* condition is nonzero, but while only goes round again when it is -1
+* (all ones). Each layout below keeps that, so conditions are only
+* inverted where they are known to be 0 or -1.
+*/
+
+/*
+* True if e is always 0 or -1, so that it is nonzero exactly when it is -1,
+* and ~e is zero exactly when e isn't.
+*/
+static bool is_boolean(const expression* e)
+{
+    if (e == NULL)
+    {
+        return false;
+    }
+    switch (e->kind)
+    {
+        case EX_TRUE:
+        case EX_FALSE:
+            return true;
+        case EX_UNARY:
+            return e->as.unary.op == '~' && is_boolean(e->as.unary.operand);
+        case EX_BINARY:
+            switch (e->as.binary.op)
+            {
+                case '<':
+                case '>':
+                case '=':
+                    return true;
+                case '&':
+                case '|':
+                    return is_boolean(e->as.binary.left) && is_boolean(e->as.binary.right);
+                default:
+                    return false;
+            }
+        default:
+            return false;
+    }
+}
+
+/*
+* Returns x if e is ~x, otherwise NULL.
+*/
+static const expression* complemented_operand(const expression* e)
+{
+    return (e != NULL && e->kind == EX_UNARY && e->as.unary.op == '~') ? e->as.unary.operand : NULL;
+}
+
+/*
+* Loops whose condition is 0 or -1 are rotated, so that each pass runs the
+* test and one if-goto at the bottom:
+*     goto WHILE_EXP; label WHILE_BODY; body; label WHILE_EXP; cond; if-goto WHILE_BODY
+* The loop ends when not cond is nonzero, so for while (~x) the book's
+* not, not cancels out whatever x is, and the test stays at the top.
+*/
+static void generate_while_with_layout(codegenerator* gen, const statement* s)
+{
+    const expression* condition = s->as.loop.condition;
+    const expression* complemented = complemented_operand(condition);
+    char startlabel[MAX_LABEL_LENGTH];
+    char bodylabel[MAX_LABEL_LENGTH];
+    char endlabel[MAX_LABEL_LENGTH];
+    snprintf(startlabel, sizeof(startlabel), "WHILE_EXP%u", gen->labelcounts.whilecount);
+    snprintf(bodylabel, sizeof(bodylabel), "WHILE_BODY%u", gen->labelcounts.whilecount);
+    snprintf(endlabel, sizeof(endlabel), "WHILE_END%u", gen->labelcounts.whilecount);
+    gen->labelcounts.whilecount++;
+
+    int value;
+    if (constant_value(condition, &value))
+    {
+        if (value == -1) // while (true), left by a return or not at all
+        {
+            write_label(gen->vm, startlabel);
+            generate_statements(gen, s->as.loop.body);
+            write_goto(gen->vm, startlabel);
+        }
+        return; // any other constant ends the loop before it starts
+    }
+
+    if (is_boolean(condition))
+    {
+        write_goto(gen->vm, startlabel);
+        write_label(gen->vm, bodylabel);
+        generate_statements(gen, s->as.loop.body);
+        write_label(gen->vm, startlabel);
+        generate_expression(gen, condition);
+        write_if(gen->vm, bodylabel);
+    }
+    else
+    {
+        write_label(gen->vm, startlabel);
+        if (complemented != NULL)
+        {
+            generate_expression(gen, complemented);
+        }
+        else
+        {
+            generate_expression(gen, condition);
+            write_arithmetic(gen->vm, VMC_NOT);
+        }
+        write_if(gen->vm, endlabel);
+        generate_statements(gen, s->as.loop.body);
+        write_goto(gen->vm, startlabel);
+        write_label(gen->vm, endlabel);
+    }
+}
+
+/*
+* An if jumps straight to the arm that doesn't follow the test: to the else
+* arm for if (~x) with x 0 or -1, to the then arm otherwise. Without an
+* else arm (an empty one counts as none) a condition that is 0 or -1 jumps
+* over the then arm on its complement. Any other condition has no
+* complement a single if-goto can test, so it keeps the book's layout.
+*/
+static void generate_if_with_layout(codegenerator* gen, const statement* s)
+{
+    const expression* condition = s->as.ifelse.condition;
+    const expression* complemented = complemented_operand(condition);
+    const statement* thenbranch = s->as.ifelse.thenbranch;
+    const statement* elsebranch = s->as.ifelse.elsebranch;
+    char iftruelabel[MAX_LABEL_LENGTH];
+    char iffalselabel[MAX_LABEL_LENGTH];
+    char ifendlabel[MAX_LABEL_LENGTH];
+    snprintf(iftruelabel, sizeof(iftruelabel), "IF_TRUE%u", gen->labelcounts.ifcount);
+    snprintf(iffalselabel, sizeof(iffalselabel), "IF_FALSE%u", gen->labelcounts.ifcount);
+    snprintf(ifendlabel, sizeof(ifendlabel), "IF_END%u", gen->labelcounts.ifcount);
+    gen->labelcounts.ifcount++;
+
+    int value;
+    if (constant_value(condition, &value))
+    {
+        generate_statements(gen, (value != 0) ? thenbranch : elsebranch);
+        return;
+    }
+    if (thenbranch == NULL && elsebranch == NULL)
+    {
+        generate_expression(gen, condition); // only for what it calls
+        write_pop(gen->vm, VMS_TEMP, 0);
+        return;
+    }
+
+    if (thenbranch == NULL)
+    {
+        generate_expression(gen, condition);
+        write_if(gen->vm, ifendlabel);
+        generate_statements(gen, elsebranch);
+        write_label(gen->vm, ifendlabel);
+    }
+    else if (elsebranch == NULL && complemented != NULL && is_boolean(complemented))
+    {
+        generate_expression(gen, complemented);
+        write_if(gen->vm, ifendlabel);
+        generate_statements(gen, thenbranch);
+        write_label(gen->vm, ifendlabel);
+    }
+    else if (elsebranch == NULL && is_boolean(condition))
+    {
+        generate_expression(gen, condition);
+        write_arithmetic(gen->vm, VMC_NOT);
+        write_if(gen->vm, ifendlabel);
+        generate_statements(gen, thenbranch);
+        write_label(gen->vm, ifendlabel);
+    }
+    else if (elsebranch == NULL)
+    {
+        generate_expression(gen, condition);
+        write_if(gen->vm, iftruelabel);
+        write_goto(gen->vm, ifendlabel);
+        write_label(gen->vm, iftruelabel);
+        generate_statements(gen, thenbranch);
+        write_label(gen->vm, ifendlabel);
+    }
+    else if (complemented != NULL && is_boolean(complemented))
+    {
+        generate_expression(gen, complemented);
+        write_if(gen->vm, iffalselabel);
+        generate_statements(gen, thenbranch);
+        write_goto(gen->vm, ifendlabel);
+        write_label(gen->vm, iffalselabel);
+        generate_statements(gen, elsebranch);
+        write_label(gen->vm, ifendlabel);
+    }
+    else
+    {
+        generate_expression(gen, condition);
+        write_if(gen->vm, iftruelabel);
+        generate_statements(gen, elsebranch);
+        write_goto(gen->vm, ifendlabel);
+        write_label(gen->vm, iftruelabel);
+        generate_statements(gen, thenbranch);
+        write_label(gen->vm, ifendlabel);
+    }
+}
+
+
+static void generate_while(codegenerator* gen, const statement* s)
+{
+    if (gen->optimizations & OPT_BRANCHES)
+    {
+        generate_while_with_layout(gen, s);
+        return;
+    }
+
+    char startlabel[MAX_LABEL_LENGTH];
+    char endlabel[MAX_LABEL_LENGTH];
+    snprintf(startlabel, sizeof(startlabel), "WHILE_EXP%u", gen->labelcounts.whilecount);
+    snprintf(endlabel, sizeof(endlabel), "WHILE_END%u", gen->labelcounts.whilecount);
+    gen->labelcounts.whilecount++;
+
+    write_label(gen->vm, startlabel);
+    generate_expression(gen, s->as.loop.condition);
+
+    // negate before comparison
+    // we only want to jump to the end of the loop if the condition is false
+    write_arithmetic(gen->vm, VMC_NOT);
+    write_if(gen->vm, endlabel);
+
+    generate_statements(gen, s->as.loop.body);
+    write_goto(gen->vm, startlabel);
+    write_label(gen->vm, endlabel);
+}
+
+static void generate_if(codegenerator* gen, const statement* s)
+{
+    if (gen->optimizations & OPT_BRANCHES)
+    {
+        generate_if_with_layout(gen, s);
+        return;
+    }
+
+    char iftruelabel[MAX_LABEL_LENGTH];
+    char iffalselabel[MAX_LABEL_LENGTH];
+    char ifendlabel[MAX_LABEL_LENGTH];
+    snprintf(iftruelabel, sizeof(iftruelabel), "IF_TRUE%u", gen->labelcounts.ifcount);
+    snprintf(iffalselabel, sizeof(iffalselabel), "IF_FALSE%u", gen->labelcounts.ifcount);
+    snprintf(ifendlabel, sizeof(ifendlabel), "IF_END%u", gen->labelcounts.ifcount);
+    gen->labelcounts.ifcount++;
+
+    generate_expression(gen, s->as.ifelse.condition);
+    write_if(gen->vm, iftruelabel);
+    write_goto(gen->vm, iffalselabel);
+    write_label(gen->vm, iftruelabel);
+
+    generate_statements(gen, s->as.ifelse.thenbranch);
+
+    if (s->as.ifelse.haselse)
+    {
+        write_goto(gen->vm, ifendlabel);
+        write_label(gen->vm, iffalselabel);
+        generate_statements(gen, s->as.ifelse.elsebranch);
+        write_label(gen->vm, ifendlabel);
+    }
+    else
+    {
+        write_label(gen->vm, iffalselabel);
+    }
+}
+
+static void generate_statements(codegenerator* gen, const statement* s)
+{
+    for (; s != NULL; s = s->next)
+    {
+        switch (s->kind)
+        {
+            case ST_LET:
+                generate_let(gen, s);
+                break;
+            case ST_IF:
+                generate_if(gen, s);
+                break;
+            case ST_WHILE:
+                generate_while(gen, s);
+                break;
+            case ST_DO:
+                generate_expression(gen, s->as.call);
+                // do statements call subroutines, but do not assign the return value to any variable, so the
+                // return value is popped to a temp variable to effectively "discard" it
+                write_pop(gen->vm, VMS_TEMP, 0);
+                break;
+            case ST_RETURN:
+                if (s->as.value == NULL)
+                {
+                    // nothing specific is being returned, so push 0 first
+                    write_push(gen->vm, VMS_CONST, 0);
+                }
+                else
+                {
+                    generate_expression(gen, s->as.value);
+                }
+                write_return(gen->vm);
+                break;
+        }
+    }
+}
+
+
+static void generate_subroutine(codegenerator* gen, const subroutinenode* node, const classnode* classnode)
+{
+    reset_arena(gen->scratch); // everything the last subroutine allocated
+    gen->labelcounts.whilecount = 0;
+    gen->labelcounts.ifcount = 0;
+    gen->labelcounts.stringcount = 0;
+
+    write_function(gen->vm, make_vm_name(gen, classnode->name, node->name), node->numlocals);
+
+    if (node->kind == SUB_CONSTRUCTOR)
+    {
+        write_push(gen->vm, VMS_CONST, classnode->numfields);
+        write_call(gen->vm, "Memory.alloc", 1);
+        write_pop(gen->vm, VMS_POINTER, 0);
+    }
+    else if (node->kind == SUB_METHOD)
+    {
+        write_push(gen->vm, VMS_ARG, 0);
+        write_pop(gen->vm, VMS_POINTER, 0);
+    }
+
+    generate_statements(gen, node->body);
+}
+
+
+void generate_class(vmbuffer* vm, const classnode* node, const interner* names, arena* scratch, unsigned int optimizations,
+    filestats* stats)
+{
+    codegenerator gen;
+    gen.vm = vm;
+    gen.names = names;
+    gen.scratch = scratch;
+    gen.optimizations = optimizations;
+    gen.stats = stats;
+    gen.labelcounts.whilecount = 0;
+    gen.labelcounts.ifcount = 0;
+    gen.labelcounts.stringcount = 0;
+    gen.strings.literals = NULL;
+    gen.strings.count = 0;
+    gen.strings.capacity = 0;
+    gen.strings.firststatic = node->numstatics;
+
+    for (const subroutinenode* subroutine = node->subroutines; subroutine != NULL; subroutine = subroutine->next)
+    {
+        generate_subroutine(&gen, subroutine, node);
+    }
+
+    free(gen.strings.literals);
+}
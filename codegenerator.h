@@ -0,0 +1,52 @@
+#ifndef CODEGENERATOR_H
+#define CODEGENERATOR_H
+
+#include "syntaxtree.h"
+#include "vmwriter.h"
+#include "compilestats.h"
+
+#define MAX_LABEL_LENGTH 24 // "STRING_READY" plus all 10 digits of an unsigned int, and NUL
+#define INITIAL_STRING_POOL_SIZE 16
+
+// temp 0 takes the results do statements discard and temp 1 holds array
+// targets while the value is computed, so strength reduction uses 2 and 3
+#define REDUCED_OPERAND_TEMP 2
+#define REDUCED_PRODUCT_TEMP 3
+#define MAX_REDUCED_ADDITIONS 3 // products needing more adds than this still call Math.multiply
+
+// these counts are incremented when while and if statements are generated, and are
+// used to make labels unique within subroutines
+typedef struct vmlabelcounts
+{
+    unsigned int whilecount;
+    unsigned int ifcount;
+    unsigned int stringcount; // pooled string literals used
+} vmlabelcounts;
+
+// the distinct string literals of a class, for OPT_STRINGS; literal i is
+// kept in static firststatic + i
+typedef struct stringpool
+{
+    const expression** literals; // the first EX_STRING seen with each text
+    size_t count;
+    size_t capacity;
+    unsigned int firststatic; // the first static after the class's own
+} stringpool;
+
+// what every step of the walk needs
+typedef struct codegenerator
+{
+    vmbuffer* vm;
+    const interner* names;
+    arena* scratch; // call names and the like, reset for each subroutine
+    vmlabelcounts labelcounts;
+    stringpool strings;
+    unsigned int optimizations; // the OPT_* code generation passes to apply
+    filestats* stats; // may be NULL
+} codegenerator;
+
+// appends the VM code for the whole class
+void generate_class(vmbuffer* vm, const classnode* node, const interner* names, arena* scratch, unsigned int optimizations,
+    filestats* stats);
+
+#endif // CODEGENERATOR_H
@@ -2,14 +2,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
-#include "vmwriter.h"
+#include "compilestats.h"
 
 
 /*
 * This file, compilationengine.c, was originally written to parse, tokenize, and
-* print Jack code as XML output. This is a modified version that translates the
-* code into VM commands. The original version has been preserved as
-* tokenizerengine.c.
+* print Jack code as XML output. This is a modified version that builds a
+* syntax tree for the code, which codegenerator.c then translates into VM
+* commands. The original version has been preserved as tokenizerengine.c.
 *
 * Currently, this program assumes the input is valid and does not check for or
 * report unexpected tokens other than in assert() statements at the beginning of
@@ -17,60 +17,101 @@
 *
 * TODO: Break up functions. compile_term() and the subroutine functions are particularly messy.
 */
-void compile_class(token* t, FILE* infile, FILE* outfile, int* linenum, symboltable* classtable, symboltable* subtable)
+
+
+/*
+* resolve_symbol(), timed when --stats asked for it.
+*/
+static resolvedsymbol lookup_symbol(const symboltable* subtable, atom name)
+{
+    if (subtable->stats == NULL || !subtable->stats->timed)
+    {
+        return resolve_symbol(subtable, name);
+    }
+    double start = stats_clock();
+    resolvedsymbol result = resolve_symbol(subtable, name);
+    subtable->stats->resolveseconds += stats_clock() - start;
+    return result;
+}
+
+/*
+* Resolves a variable for the tree, reporting it if it isn't declared in
+* any enclosing scope.
+*/
+static variableref resolve_variable(tokenstream* ts, const symboltable* subtable, atom name)
+{
+    resolvedsymbol symbol = lookup_symbol(subtable, name); // falls back to class scope
+    if (symbol.kind == SK_NONE)
+    {
+        report_error(ts, "Error: could not find %s in symbol table", atom_text(ts->names, name));
+    }
+    variableref variable;
+    variable.name = name;
+    variable.kind = symbol.kind;
+    variable.index = symbol.index;
+    return variable;
+}
+
+/*
+* Returns NULL if the file doesn't start with a class.
+*/
+classnode* compile_class(token* t, tokenstream* ts, symboltable* classtable, symboltable* subtable, arena* filearena)
 {
     assert (t->key == K_CLASS); // DEBUG
 
     if (t->key != K_CLASS)
     {
-        fprintf(stderr, "line %d: Unexpected token '%s', expected 'class'\n", *linenum, t->name); // TODO: add filename to this message
+        report_error(ts, "line %u: Unexpected token '%.*s', expected 'class'", t->linenum, (int)t->length, t->start);
+        return NULL;
     }
-    else
-    {
-        int indentstart = 0;
-        int* indent = &indentstart;
-        // fprintf(outfile, "%*s<class>\n", *indent, "");
-        (*indent) += INDENT_WIDTH;
 
-        get_next_token(t, infile, linenum); // class name
+    classnode* node = arena_alloc(filearena, sizeof(*node));
+    begin_span(&node->span, t, ts);
+    node->subroutines = NULL;
 
-        char* classname = malloc((strlen(t->name) + 1 ) * sizeof(*classname)); // +1 for NUL
-        if (classname == NULL)
-        {
-            fprintf(stderr, "Error: could not allocate memory for classname\n");
-            exit(1);
-        }
-        strcpy(classname, t->name);
+    int indentstart = 0;
+    int* indent = &indentstart;
+    // fprintf(outfile, "%*s<class>\n", *indent, "");
+    (*indent) += INDENT_WIDTH;
 
-        get_next_token(t, infile, linenum); // '{'
-        get_next_token(t, infile, linenum);
+    get_next_token(t, ts); // class name
+    node->name = t->nameatom;
 
-        while(t->key == K_STATIC || t->key == K_FIELD)
-        {
-            compile_class_var_dec(t, infile, linenum, indent, classtable);
-        }
-        while(t->key == K_CONSTRUCTOR || t->key == K_FUNCTION || t->key == K_METHOD || t->key == K_VOID)
-        {
-            compile_subroutine(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-        }
+    get_next_token(t, ts); // '{'
+    get_next_token(t, ts);
 
-        (*indent) -= INDENT_WIDTH;
-        // fprintf(outfile, "%*s</class>\n", *indent, "");
+    while(t->key == K_STATIC || t->key == K_FIELD)
+    {
+        compile_class_var_dec(t, ts, indent, classtable);
+    }
+    node->numfields = var_count(classtable, SK_FIELD);
+    node->numstatics = var_count(classtable, SK_STATIC);
 
-        printf("\nClasstable:\n"); // DEBUG
-        print_symbol_table(classtable); // DEBUG
+    subroutinenode** last = &node->subroutines;
+    while(t->key == K_CONSTRUCTOR || t->key == K_FUNCTION || t->key == K_METHOD || t->key == K_VOID)
+    {
+        *last = compile_subroutine(t, ts, indent, subtable, node->name, filearena);
+        last = &(*last)->next;
+    }
+    reached_end_of_file(t, ts); // wherever a truncated class ends, the parser runs out here
+    end_span(&node->span, t, ts); // '}'
 
-        // cleanup
-        free(classname);
-        classname = NULL;
+    (*indent) -= INDENT_WIDTH;
+    // fprintf(outfile, "%*s</class>\n", *indent, "");
+
+    if (ts->messages != NULL)
+    {
+        fprintf(ts->messages, "\nClasstable:\n"); // DEBUG
+        print_symbol_table(classtable, ts->messages); // DEBUG
     }
+    return node;
 }
 
 
 /*
 *
 */
-void compile_class_var_dec(token* t, FILE* infile, int* linenum, int* indent, symboltable* classtable)
+void compile_class_var_dec(token* t, tokenstream* ts, int* indent, symboltable* classtable)
 {
     // fprintf(outfile, "%*s<classVarDec>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
@@ -84,17 +125,17 @@ void compile_class_var_dec(token* t, FILE* infile, int* linenum, int* indent, sy
     }
     t->symboldata->is_being_defined = true;
 
-    get_next_token(t, infile, linenum); // type
-    strcpy(t->symboldata->type, t->name);
-    get_next_token(t, infile, linenum);
+    get_next_token(t, ts); // type
+    t->symboldata->type = t->nameatom;
+    get_next_token(t, ts);
 
-    while( !(t->type == T_SYMBOL && get_symbol(t) == ';') )
+    while( !(t->type == T_SYMBOL && get_symbol(t) == ';') && !reached_end_of_file(t, ts) )
     {
         copy_symboldata_into_symbol_table(t, classtable);
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
 
-    get_next_token(t, infile, linenum);
+    get_next_token(t, ts);
 
     t->symboldata->is_being_defined = false;
     t->symboldata->kind = SK_NONE;
@@ -104,115 +145,93 @@ void compile_class_var_dec(token* t, FILE* infile, int* linenum, int* indent, sy
 
 
 /*
-*
+* The subroutine's parameters and locals only live in subtable until the
+* next subroutine starts, so everything the code generator needs from them
+* is copied into the tree here.
 */
-void compile_subroutine(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                        symboltable* classtable, symboltable* subtable, const char* classname)
+subroutinenode* compile_subroutine(token* t, tokenstream* ts, int* indent,
+                                   symboltable* subtable, atom classname, arena* filearena)
 {
-    char* functionname = NULL;
-    vmlabelcounts labelcounts;
-    labelcounts.whilecount = 0;
-    labelcounts.ifcount = 0;
-    vmlabelcounts* labelcountspointer = &labelcounts;
+    subroutinenode* node = arena_alloc(filearena, sizeof(*node));
+    begin_span(&node->span, t, ts);
+    node->next = NULL;
 
     // fprintf(outfile, "%*s<subroutineDec>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
     start_subroutine(subtable); // clear symboltable for each subroutine
 
-    // current symbol is either "constructor," "function," or "method" ... use this later to determine whether to push "this" argument?
-    bool is_constructor = false;
-    bool is_method = false;
+    node->kind = SUB_FUNCTION;
     if (t->key == K_CONSTRUCTOR)
     {
-        is_constructor = true;
+        node->kind = SUB_CONSTRUCTOR;
     }
     else if (t->key == K_METHOD)
     {
-        is_method = true;
+        node->kind = SUB_METHOD;
         subtable->argindex = 1; // methods have "this" pushed as first argument, so index starts at 1
     }
 
-    get_next_token(t, infile, linenum); // return type
-    get_next_token(t, infile, linenum); // function name
+    get_next_token(t, ts); // return type
+    get_next_token(t, ts); // function name
+    node->name = t->nameatom;
 
-    functionname = malloc((strlen(classname) + strlen(t->name) + 2) * sizeof(*functionname)); // +1 for '.' and +1 for NUL
-    if (functionname == NULL)
-    {
-        fprintf(stderr, "Error: could not allocate memory for functionname\n");
-        exit(1);
-    }
-    strcpy(functionname, classname);
-    strcat(functionname, ".");
-    strcat(functionname, t->name);
+    get_next_token(t, ts); // '('
+    get_next_token(t, ts);
+    compile_parameter_list(t, ts, indent, subtable);
 
-    get_next_token(t, infile, linenum); // '('
-    get_next_token(t, infile, linenum);
-    compile_parameter_list(t, infile, linenum, indent, subtable);
-
-    get_next_token(t, infile, linenum); // '{'
+    get_next_token(t, ts); // '{'
 
     // fprintf(outfile, "%*s<subroutineBody>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    get_next_token(t, infile, linenum);
+    get_next_token(t, ts);
     while (t->key == K_VAR)
     {
-        compile_var_dec(t, infile, linenum, indent, subtable);
+        compile_var_dec(t, ts, indent, subtable);
     }
+    node->numlocals = var_count(subtable, SK_VAR);
 
-    write_function(outfile, functionname, var_count(subtable, SK_VAR));
+    node->body = compile_statements(t, ts, indent, subtable, classname, filearena);
 
-    if (is_constructor)
-    {
-        write_push(outfile, VMS_CONST, var_count(classtable, SK_FIELD));
-        write_call(outfile, "Memory.alloc", 1);
-        write_pop(outfile, VMS_POINTER, 0);
-    }
-    else if (is_method)
-    {
-        write_push(outfile, VMS_ARG, 0);
-        write_pop(outfile, VMS_POINTER, 0);
-    }
-
-    compile_statements(t, infile, outfile, linenum, indent, classtable, subtable, labelcountspointer, classname);
-
-    get_next_token(t, infile, linenum);
+    end_span(&node->span, t, ts); // '}'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</subroutineBody>\n", *indent, "");
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</subroutineDec>\n", *indent, "");
 
-    printf("\nSubtable:\n"); // DEBUG
-    print_symbol_table(subtable); // DEBUG
-
-    // cleanup
-    free(functionname);
+    if (ts->messages != NULL)
+    {
+        fprintf(ts->messages, "\nSubtable:\n"); // DEBUG
+        print_symbol_table(subtable, ts->messages); // DEBUG
+    }
+    return node;
 }
 
 
 /*
 *
 */
-void compile_parameter_list(token* t, FILE* infile, int* linenum, int* indent, symboltable* subtable)
+void compile_parameter_list(token* t, tokenstream* ts, int* indent, symboltable* subtable)
 {
     // fprintf(outfile, "%*s<parameterList>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
     t->symboldata->kind = SK_ARG;
 
-    while ( !(t->type == T_SYMBOL && get_symbol(t) == ')'))
+    while ( !(t->type == T_SYMBOL && get_symbol(t) == ')') && !reached_end_of_file(t, ts) )
     {
-        strcpy(t->symboldata->type, t->name);
+        t->symboldata->type = t->nameatom;
 
-        get_next_token(t, infile, linenum); // name
+        get_next_token(t, ts); // name
         copy_symboldata_into_symbol_table(t, subtable);
 
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
 
         if (t->type == T_SYMBOL && get_symbol(t) == ',')
         {
-            get_next_token(t, infile, linenum);
+            get_next_token(t, ts);
         }
     }
 
@@ -225,7 +244,7 @@ void compile_parameter_list(token* t, FILE* infile, int* linenum, int* indent, s
 /*
 *
 */
-void compile_var_dec(token* t, FILE* infile, int* linenum, int* indent, symboltable* subtable)
+void compile_var_dec(token* t, tokenstream* ts, int* indent, symboltable* subtable)
 {
     assert(t->key == K_VAR); // DEBUG
 
@@ -234,16 +253,16 @@ void compile_var_dec(token* t, FILE* infile, int* linenum, int* indent, symbolta
     t->symboldata->kind = SK_VAR;
     t->symboldata->is_being_defined = true;
 
-    get_next_token(t, infile, linenum); // type
-    strcpy(t->symboldata->type, t->name);
-    get_next_token(t, infile, linenum);
+    get_next_token(t, ts); // type
+    t->symboldata->type = t->nameatom;
+    get_next_token(t, ts);
 
-    while ( !(t->type == T_SYMBOL && get_symbol(t) == ';') )
+    while ( !(t->type == T_SYMBOL && get_symbol(t) == ';') && !reached_end_of_file(t, ts) )
     {
         copy_symboldata_into_symbol_table(t, subtable);
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
-    get_next_token(t, infile, linenum);
+    get_next_token(t, ts);
 
     t->symboldata->is_being_defined = false;
     t->symboldata->kind = SK_NONE;
@@ -255,457 +274,387 @@ void compile_var_dec(token* t, FILE* infile, int* linenum, int* indent, symbolta
 /*
 *
 */
-void compile_statements(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                        symboltable* classtable, symboltable* subtable, vmlabelcounts* labelcounts, const char* classname)
+statement* compile_statements(token* t, tokenstream* ts, int* indent,
+                              symboltable* subtable, atom classname, arena* filearena)
 {
     //assert(is_statement(t)); // DEBUG, currently this will cause an abort for empty while blocks
 
     // fprintf(outfile, "%*s<statements>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
+    statement* first = NULL;
+    statement** last = &first;
     while (is_statement(t))
     {
+        statement* s = NULL;
         // K_ELSE is handled in compile_if() and not included here
         if (t->key == K_LET)
         {
-            compile_let(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+            s = compile_let(t, ts, indent, subtable, classname, filearena);
         }
         else if (t->key == K_IF)
         {
-            compile_if(t, infile, outfile, linenum, indent, classtable, subtable, labelcounts, classname);
+            s = compile_if(t, ts, indent, subtable, classname, filearena);
         }
         else if (t->key == K_WHILE)
         {
-            compile_while(t, infile, outfile, linenum, indent, classtable, subtable, labelcounts, classname);
+            s = compile_while(t, ts, indent, subtable, classname, filearena);
         }
         else if (t->key == K_DO)
         {
-            compile_do(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+            s = compile_do(t, ts, indent, subtable, classname, filearena);
         }
         else if (t->key == K_RETURN)
         {
-            compile_return(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+            s = compile_return(t, ts, indent, subtable, classname, filearena);
         }
+        *last = s;
+        last = &s->next;
     }
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</statements>\n", *indent, "");
+    return first;
 }
 
 
 /*
 *
 */
-void compile_do(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                symboltable* classtable, symboltable* subtable, const char* classname)
+statement* compile_do(token* t, tokenstream* ts, int* indent,
+                      symboltable* subtable, atom classname, arena* filearena)
 {
     assert(t->key == K_DO); // DEBUG
 
+    statement* s = new_statement(filearena, ST_DO, t, ts);
+
     // fprintf(outfile, "%*s<doStatement>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    get_next_token(t, infile, linenum);
-    compile_subroutine_call(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+    get_next_token(t, ts);
+    s->as.call = compile_subroutine_call(t, ts, indent, subtable, classname, filearena);
 
-    // do statements call subroutines, but do not assign the return value to any variable, so the
-    // return value is popped to a temp variable to effectively "discard" it
-    write_pop(outfile, VMS_TEMP, 0);
-
-    get_next_token(t, infile, linenum);
+    end_span(&s->span, t, ts); // ';'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</doStatement>\n", *indent, "");
+    return s;
 }
 
 
 /*
 *
 */
-void compile_let(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                 symboltable* classtable, symboltable* subtable, const char* classname)
+statement* compile_let(token* t, tokenstream* ts, int* indent,
+                       symboltable* subtable, atom classname, arena* filearena)
 {
     assert(t->key == K_LET); // DEBUG
 
+    statement* s = new_statement(filearena, ST_LET, t, ts);
+
     //fprintf(outfile, "%*s<letStatement>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    get_next_token(t, infile, linenum); // variable name
-    symbolkind tempkind = kind_of(subtable, t->name);
-    unsigned int tempindex = index_of(subtable, t->name);
-    if (tempkind == SK_NONE)
-    {
-        // if symbol isn't found in subroutine scope, look it up in the class symboltable
-        tempkind = kind_of(classtable, t->name);
-        tempindex = index_of(classtable, t->name);
-    }
-    if (tempkind == SK_NONE)
-    {
-        fprintf(stderr, "Error: could not find %s in symbol table\n", t->name);
-    }
+    get_next_token(t, ts); // variable name
+    s->as.let.target = resolve_variable(ts, subtable, t->nameatom);
 
-    get_next_token(t, infile, linenum);
+    get_next_token(t, ts);
     if (t->type == T_SYMBOL && get_symbol(t) == '[')
     {
-        // This is an array entry, so push the variable (which points to the base
-        // of the array), then calculate the index and add. Next, we set the "that"
-        // segment to point to this memory location, then push "that 0", which puts
-        // the value found at that memory location on the stack.
-
-        // This is an array entry, so push the variable (which points to the base of the
-        // array), then calculate the index and add it to the base. Next, we set the "that"
-        // segment to point to this memory location (via pointer 1). After calculating the
-        // value we want to store, we can pop it to "that 0".
-
-        // BUT, because the "that" segment can change when calculating the upcoming expression,
-        // the location is stored in a temp variable until we're ready to pop the value we want to assign.
-
-        write_push(outfile, convert_symbolkind_to_vmsegment(tempkind), tempindex);
-        get_next_token(t, infile, linenum);
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname); // the index
-        write_arithmetic(outfile, VMC_ADD);
-        write_pop(outfile, VMS_TEMP, 1);
-
-        get_next_token(t, infile, linenum); // ']'
-        get_next_token(t, infile, linenum);
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname); // the value we want to store
-
-        write_push(outfile, VMS_TEMP, 1); // put the pointer value for the array element back on the stack
-        write_pop(outfile, VMS_POINTER, 1);
-        write_pop(outfile, VMS_THAT, 0);
+        get_next_token(t, ts);
+        s->as.let.index = compile_expression(t, ts, indent, subtable, classname, filearena);
+
+        get_next_token(t, ts); // ']'
+        get_next_token(t, ts);
+        s->as.let.value = compile_expression(t, ts, indent, subtable, classname, filearena);
     }
     else
     {
-        get_next_token(t, infile, linenum);
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-
-        write_pop(outfile, convert_symbolkind_to_vmsegment(tempkind), tempindex);
+        get_next_token(t, ts);
+        s->as.let.value = compile_expression(t, ts, indent, subtable, classname, filearena);
     }
 
-    get_next_token(t, infile, linenum);
+    end_span(&s->span, t, ts); // ';'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
     //fprintf(outfile, "%*s</letStatement>\n", *indent, "");
+    return s;
 }
 
 
 /*
 *
 */
-void compile_while(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                   symboltable* classtable, symboltable* subtable, vmlabelcounts* labelcounts, const char* classname)
+statement* compile_while(token* t, tokenstream* ts, int* indent,
+                         symboltable* subtable, atom classname, arena* filearena)
 {
     assert(t->key == K_WHILE); // DEBUG
 
-    char startlabel[16];
-    char endlabel[16];
-    strcpy(startlabel, "WHILE_EXP");
-    strcpy(endlabel, "WHILE_END");
-    char whilenumber[4]; // room for 3 digits + NUL
-    sprintf(whilenumber, "%u", labelcounts->whilecount);
-    strcat(startlabel, whilenumber);
-    strcat(endlabel, whilenumber);
-    labelcounts->whilecount++;
-
-    write_label(outfile, startlabel);
+    statement* s = new_statement(filearena, ST_WHILE, t, ts);
 
     // fprintf(outfile, "%*s<whileStatement>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    get_next_token(t, infile, linenum); // '('
-    get_next_token(t, infile, linenum);
-    compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-    get_next_token(t, infile, linenum); // ')'
-
-    // negate before comparison
-    // we only want to jump to the end of the loop if the condition is false
-    write_arithmetic(outfile, VMC_NOT);
-    write_if(outfile, endlabel);
+    get_next_token(t, ts); // '('
+    get_next_token(t, ts);
+    s->as.loop.condition = compile_expression(t, ts, indent, subtable, classname, filearena);
+    get_next_token(t, ts); // ')'
 
-    get_next_token(t, infile, linenum); // '{'
-    compile_statements(t, infile, outfile, linenum, indent, classtable, subtable, labelcounts, classname);
-    write_goto(outfile, startlabel);
+    get_next_token(t, ts); // '{'
+    s->as.loop.body = compile_statements(t, ts, indent, subtable, classname, filearena);
 
-    get_next_token(t, infile, linenum);
-
-    write_label(outfile, endlabel);
+    end_span(&s->span, t, ts); // '}'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</whileStatement>\n", *indent, "");
+    return s;
 }
 
 
 /*
 *
 */
-void compile_return(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                    symboltable* classtable, symboltable* subtable, const char* classname)
+statement* compile_return(token* t, tokenstream* ts, int* indent,
+                          symboltable* subtable, atom classname, arena* filearena)
 {
     assert(t->key == K_RETURN); // DEBUG
 
+    statement* s = new_statement(filearena, ST_RETURN, t, ts);
+
     // fprintf(outfile, "%*s<returnStatement>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    get_next_token(t, infile, linenum);
-    if (t->type == T_SYMBOL && get_symbol(t) == ';')
-    {
-        // nothing specific is being returned, so push 0 first
-        write_push(outfile, VMS_CONST, 0);
-        write_return(outfile);
-    }
-    else
+    get_next_token(t, ts);
+    if (!(t->type == T_SYMBOL && get_symbol(t) == ';'))
     {
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-        write_return(outfile);
+        s->as.value = compile_expression(t, ts, indent, subtable, classname, filearena);
     }
-    get_next_token(t, infile, linenum);
+    end_span(&s->span, t, ts); // ';'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</returnStatement>\n", *indent, "");
+    return s;
 }
 
 
 /*
 *
 */
-void compile_if(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                symboltable* classtable, symboltable* subtable, vmlabelcounts* labelcounts, const char* classname)
+statement* compile_if(token* t, tokenstream* ts, int* indent,
+                      symboltable* subtable, atom classname, arena* filearena)
 {
     assert(t->key == K_IF); // DEBUG
 
-    char iftruelabel[16];
-    char iffalselabel[16];
-    char ifendlabel[16];
-    strcpy(iftruelabel, "IF_TRUE");
-    strcpy(iffalselabel, "IF_FALSE");
-    strcpy(ifendlabel, "IF_END");
-    char ifnumber[4]; // room for 3 digits + NUL
-    sprintf(ifnumber, "%u", labelcounts->ifcount);
-    strcat(iftruelabel, ifnumber);
-    strcat(iffalselabel, ifnumber);
-    strcat(ifendlabel, ifnumber);
-    labelcounts->ifcount++;
+    statement* s = new_statement(filearena, ST_IF, t, ts);
 
     // fprintf(outfile, "%*s<ifStatement>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    get_next_token(t, infile, linenum); // '('
-    get_next_token(t, infile, linenum);
-    compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+    get_next_token(t, ts); // '('
+    get_next_token(t, ts);
+    s->as.ifelse.condition = compile_expression(t, ts, indent, subtable, classname, filearena);
 
-    write_if(outfile, iftruelabel);
-    write_goto(outfile, iffalselabel);
-    write_label(outfile, iftruelabel);
+    get_next_token(t, ts); // '{'
+    get_next_token(t, ts);
+    s->as.ifelse.thenbranch = compile_statements(t, ts, indent, subtable, classname, filearena);
 
-    get_next_token(t, infile, linenum); // '{'
-    get_next_token(t, infile, linenum);
-    compile_statements(t, infile, outfile, linenum, indent, classtable, subtable, labelcounts, classname);
-
-    get_next_token(t, infile, linenum);
+    end_span(&s->span, t, ts); // '}'
+    get_next_token(t, ts);
 
     if (t->key == K_ELSE)
     {
-        write_goto(outfile, ifendlabel);
-        write_label(outfile, iffalselabel);
-
-        get_next_token(t, infile, linenum); // '{'
-        get_next_token(t, infile, linenum);
-        compile_statements(t, infile, outfile, linenum, indent, classtable, subtable, labelcounts, classname);
+        s->as.ifelse.haselse = true;
 
-        write_label(outfile, ifendlabel);
+        get_next_token(t, ts); // '{'
+        get_next_token(t, ts);
+        s->as.ifelse.elsebranch = compile_statements(t, ts, indent, subtable, classname, filearena);
 
-        get_next_token(t, infile, linenum);
-    }
-    else
-    {
-        write_label(outfile, iffalselabel);
+        end_span(&s->span, t, ts); // '}'
+        get_next_token(t, ts);
     }
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</ifStatement>\n", *indent, "");
+    return s;
 }
 
 /*
-*
+* Operators are applied left to right as they appear, so each one becomes
+* the root of the tree built so far.
 */
-void compile_expression(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                        symboltable* classtable, symboltable* subtable, const char* classname)
+expression* compile_expression(token* t, tokenstream* ts, int* indent,
+                               symboltable* subtable, atom classname, arena* filearena)
 {
     // fprintf(outfile, "%*s<expression>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    compile_term(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+    expression* e = compile_term(t, ts, indent, subtable, classname, filearena);
 
     while (is_binary_operator(t))
     {
-        char temp = get_symbol(t);
-
-        get_next_token(t, infile, linenum);
-        compile_term(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+        expression* binary = new_expression(filearena, EX_BINARY, t, ts);
+        if (e != NULL)
+        {
+            binary->span = e->span;
+        }
+        binary->as.binary.op = get_symbol(t);
+        binary->as.binary.left = e;
 
-        write_arithmetic(outfile, convert_binary_operator_to_vmcommand(temp));
+        get_next_token(t, ts);
+        binary->as.binary.right = compile_term(t, ts, indent, subtable, classname, filearena);
+        if (binary->as.binary.right != NULL)
+        {
+            extend_span(&binary->span, &binary->as.binary.right->span);
+        }
+        e = binary;
     }
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</expression>\n", *indent, "");
+    return e;
 }
 
 
 /*
 *
 */
-void compile_term(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                  symboltable* classtable, symboltable* subtable, const char* classname)
+expression* compile_term(token* t, tokenstream* ts, int* indent,
+                         symboltable* subtable, atom classname, arena* filearena)
 {
     // fprintf(outfile, "%*s<term>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    char nextchar = peek_at_next_token_start(infile, linenum);
+    expression* e = NULL;
+    char nextchar = peek_at_next_token_start(ts);
 
     if (nextchar == '[')
     {
-        // This is an array entry, so push the variable (which points to the base
-        // of the array), then calculate the index and add. Next, we set the "that"
-        // segment to point to this memory location, then push "that 0", which puts
-        // the value found at that memory location on the stack.
-        symbolkind tempkind = kind_of(subtable, t->name);
-        unsigned int index = index_of(subtable, t->name);
-        if (tempkind == SK_NONE)
-        {
-            // not found in subroutine symbol table, try looking in class symbol table
-            tempkind = kind_of(classtable, t->name);
-            index = index_of(classtable, t->name);
-        }
-        if (tempkind == SK_NONE)
-        {
-            fprintf(stderr, "Error: could not find %s in symbol table\n", t->name);
-        }
-        write_push(outfile, convert_symbolkind_to_vmsegment(tempkind), index);
+        // an array entry, the variable holds the base address of the array
+        e = new_expression(filearena, EX_VARIABLE, t, ts);
+        e->as.variable.variable = resolve_variable(ts, subtable, t->nameatom);
 
-        get_next_token(t, infile, linenum); // '['
-        get_next_token(t, infile, linenum);
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname); // array index
-        write_arithmetic(outfile, VMC_ADD);
-        write_pop(outfile, VMS_POINTER, 1);
-        write_push(outfile, VMS_THAT, 0);
+        get_next_token(t, ts); // '['
+        get_next_token(t, ts);
+        e->as.variable.index = compile_expression(t, ts, indent, subtable, classname, filearena); // array index
 
-        get_next_token(t, infile, linenum);
+        end_span(&e->span, t, ts); // ']'
+        get_next_token(t, ts);
     }
     else if (t->type == T_SYMBOL && get_symbol(t) == '(')
     {
-        get_next_token(t, infile, linenum);
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+        get_next_token(t, ts);
+        e = compile_expression(t, ts, indent, subtable, classname, filearena);
 
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
     else if (is_unary_operator(t))
     {
-        char tempsymbol = get_symbol(t);
-        get_next_token(t, infile, linenum);
-        compile_term(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-
-        write_arithmetic(outfile, convert_unary_operator_to_vmcommand(tempsymbol));
+        e = new_expression(filearena, EX_UNARY, t, ts);
+        e->as.unary.op = get_symbol(t);
+        get_next_token(t, ts);
+        e->as.unary.operand = compile_term(t, ts, indent, subtable, classname, filearena);
+        if (e->as.unary.operand != NULL)
+        {
+            extend_span(&e->span, &e->as.unary.operand->span);
+        }
     }
     else if (nextchar == '.' || nextchar == '(')
     {
         // beware of catching nested expressions, e.g. ((a+2)-1), with this condition
         // also, unary operators with parentheses, e.g. -(a+3)
         // shouldn't happen due to order of ifs, but maybe put in an explicit check
-        compile_subroutine_call(t, infile, outfile, linenum, indent, classtable, subtable, classname);
+        e = compile_subroutine_call(t, ts, indent, subtable, classname, filearena);
     }
     else if (t->key == K_THIS)
     {
-        write_push(outfile, VMS_POINTER, 0);
-        get_next_token(t, infile, linenum);
+        e = new_expression(filearena, EX_THIS, t, ts);
+        get_next_token(t, ts);
     }
     else if (t->type == T_STRING_CONST)
     {
-        char* stringcopy = malloc((strlen(t->name) + 1) * sizeof(*stringcopy)); // + 1 for NUL
-        if (stringcopy == NULL)
-        {
-            fprintf(stderr, "Error: could not allocate memory for stringcopy\n");
-            exit(1);
-        }
+        e = new_expression(filearena, EX_STRING, t, ts);
+        char* stringcopy = arena_alloc(filearena, (t->length + 1) * sizeof(*stringcopy)); // + 1 for NUL
         get_stringval(stringcopy, t);
-        write_push(outfile, VMS_CONST, strlen(stringcopy));
-        write_call(outfile, "String.new", 1);
-        for (size_t i = 0; i < strlen(stringcopy); i++)
-        {
-            write_push(outfile, VMS_CONST, stringcopy[i]); // implicitly casting to int when passing
-            write_call(outfile, "String.appendChar", 2);
-        }
-        free(stringcopy);
-        stringcopy = NULL;
+        e->as.string.text = stringcopy;
+        e->as.string.length = strlen(stringcopy);
 
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
     else
     {
-        // integer constants and true/false/null keywords get simple pushes
         if (t->type == T_INT_CONST)
         {
-            write_push(outfile, VMS_CONST, get_intval(t));
+            e = new_expression(filearena, EX_INT, t, ts);
+            e->as.intval = get_intval(t);
         }
         else if (t->key == K_TRUE)
         {
-            write_push(outfile, VMS_CONST, 1);
-            write_arithmetic(outfile, VMC_NEG);
+            e = new_expression(filearena, EX_TRUE, t, ts);
         }
-        else if (t->key == K_FALSE || t->key == K_NULL)
+        else if (t->key == K_FALSE)
         {
-            write_push(outfile, VMS_CONST, 0);
+            e = new_expression(filearena, EX_FALSE, t, ts);
         }
-        // variables get looked up in the symbol table and then pushed
+        else if (t->key == K_NULL)
+        {
+            e = new_expression(filearena, EX_NULL, t, ts);
+        }
+        // variables get looked up in the symbol table now, so the code generator doesn't have to
         else if(t->type == T_IDENTIFIER)
         {
-            symbolkind tempkind = kind_of(subtable, t->name);
-            unsigned int index = index_of(subtable, t->name);
-            if (tempkind == SK_NONE)
-            {
-                // not found in subroutine symbol table, try looking in class symbol table
-                tempkind = kind_of(classtable, t->name);
-                index = index_of(classtable, t->name);
-            }
-            if (tempkind == SK_NONE)
-            {
-                fprintf(stderr, "Error: could not find %s in symbol table\n", t->name);
-            }
-            write_push(outfile, convert_symbolkind_to_vmsegment(tempkind), index);
+            e = new_expression(filearena, EX_VARIABLE, t, ts);
+            e->as.variable.variable = resolve_variable(ts, subtable, t->nameatom);
         }
 
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</term>\n", *indent, "");
+    return e;
 }
 
 /*
-* Returns number of expressions found in the list.
+* Returns the first expression in the list, NULL if it's empty, and the
+* number found in *numexpressions.
 */
-unsigned int compile_expression_list(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                                     symboltable* classtable, symboltable* subtable, const char* classname)
+expression* compile_expression_list(token* t, tokenstream* ts, int* indent,
+                                    symboltable* subtable, atom classname, arena* filearena, unsigned int* numexpressions)
 {
     // fprintf(outfile, "%*s<expressionList>\n", *indent, "");
     (*indent) += INDENT_WIDTH;
 
-    unsigned int numexpressions = 0;
+    expression* first = NULL;
+    expression** last = &first;
+    *numexpressions = 0;
 
     if ( !(t->type == T_SYMBOL && get_symbol(t) == ')')) // make sure it's not an empty expressionList, e.g. ()
     {
-        compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-        numexpressions++;
-
-        while (t->type == T_SYMBOL && get_symbol(t) == ',')
+        while (true)
         {
-            get_next_token(t, infile, linenum);
-            compile_expression(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-            numexpressions++;
+            expression* e = compile_expression(t, ts, indent, subtable, classname, filearena);
+            if (e != NULL)
+            {
+                *last = e;
+                last = &e->next;
+            }
+            (*numexpressions)++;
+
+            if (!(t->type == T_SYMBOL && get_symbol(t) == ',') || reached_end_of_file(t, ts))
+            {
+                break;
+            }
+            get_next_token(t, ts);
         }
     }
 
     (*indent) -= INDENT_WIDTH;
     // fprintf(outfile, "%*s</expressionList>\n", *indent, "");
 
-    return numexpressions;
+    return first;
 }
 
 
@@ -713,104 +662,48 @@ unsigned int compile_expression_list(token* t, FILE* infile, FILE* outfile, int*
 * If the subroutine call does not include a period, it's a method. If the call does include a
 * period, check the current token to see if it's a variable that's been added to the symbol
 * table. If found, it's a method call.
-* Method calls must first push a reference to the object being operated on.
 */
-void compile_subroutine_call(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-                             symboltable* classtable, symboltable* subtable, const char* classname)
+expression* compile_subroutine_call(token* t, tokenstream* ts, int* indent,
+                                    symboltable* subtable, atom classname, arena* filearena)
 {
-    unsigned int numargs = 0;
-    bool is_method = false;
-    bool is_method_calling_method = false;
-    char* type = NULL;
+    expression* e = new_expression(filearena, EX_CALL, t, ts);
+    callnode* call = &e->as.call;
 
-    char nextchar = peek_at_next_token_start(infile, linenum);
+    char nextchar = peek_at_next_token_start(ts);
     if (nextchar != '.')
     {
         // if there is no period, this is a case of a method calling another method
-        // push pointer 0, which points to the "this" object (i.e. the "this" memory segment)
-        // the current method is already operating on "this," but pushing the pointer
-        // makes sure any called methods receive a reference to the same (current) object
-        is_method = true;
-        is_method_calling_method = true;
-        write_push(outfile, VMS_POINTER, 0);
-    }
-    else if (kind_of(subtable, t->name) != SK_NONE || kind_of(classtable, t->name) != SK_NONE)
-    {
-        is_method = true;
-        symbolkind symbolkind = kind_of(subtable, t->name);
-        unsigned int index = index_of(subtable, t->name);
-        type = type_of(subtable, t->name);
-
-        if (symbolkind == SK_NONE)
-        {
-            // not found in subroutine symbol table, try looking in class symbol table
-            symbolkind = kind_of(classtable, t->name);
-            index = index_of(classtable, t->name);
-            type = type_of(classtable, t->name);
-        }
-        write_push(outfile, convert_symbolkind_to_vmsegment(symbolkind), index);
-    }
-
-    char* subroutinename = malloc(1 * sizeof(*subroutinename));
-    if (subroutinename == NULL)
-    {
-        fprintf(stderr, "Error: could not allocate memory for subroutinename\n");
-        exit(1);
-    }
-    strcpy(subroutinename, "");
-
-    if (is_method_calling_method)
-    {
-        // need to manually prefix the method call with the class name to make a valid VM command
-        subroutinename = realloc(subroutinename, (strlen(classname) + strlen(t->name) + 2)); // +1 for NUL, +1 for '.'
-        if (subroutinename == NULL)
-        {
-            fprintf(stderr, "Error: could not reallocate memory for subroutinename\n");
-            exit(1);
-        }
-        strcat(subroutinename, classname);
-        strcat(subroutinename, ".");
-        strcat(subroutinename, t->name);
-
-        get_next_token(t, infile, linenum);
+        // on the same object, in the current class
+        call->kind = CALL_SELF;
+        call->classname = classname;
     }
-    else if (is_method)
+    else
     {
-        subroutinename = realloc(subroutinename, (strlen(type) + 1));
-        if (subroutinename == NULL)
+        // a variable before the period means obj.method(), otherwise it's Class.function()
+        resolvedsymbol object = lookup_symbol(subtable, t->nameatom);
+        if (object.kind != SK_NONE)
         {
-            fprintf(stderr, "Error: could not reallocate memory for subroutinename\n");
-            exit(1);
+            call->kind = CALL_METHOD;
+            call->classname = object.type;
+            call->object.name = t->nameatom;
+            call->object.kind = object.kind;
+            call->object.index = object.index;
         }
-        strcat(subroutinename, type);
-        get_next_token(t, infile, linenum);
-    }
-
-    while ( !(t->type == T_SYMBOL && get_symbol(t) == '(') )
-    {
-        subroutinename = realloc(subroutinename, (strlen(subroutinename) + strlen(t->name) + 1) * sizeof(*subroutinename)); // +1 for NUL
-        if (subroutinename == NULL)
+        else
         {
-            fprintf(stderr, "Error: could not reallocate memory for subroutinename\n");
-            exit(1);
+            call->kind = CALL_FUNCTION;
+            call->classname = t->nameatom;
         }
-        strcat(subroutinename, t->name);
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts); // '.'
+        get_next_token(t, ts);
     }
+    call->subroutinename = t->nameatom;
 
-    get_next_token(t, infile, linenum);
-    numargs = compile_expression_list(t, infile, outfile, linenum, indent, classtable, subtable, classname);
-
-    get_next_token(t, infile, linenum);
-
-    if (is_method)
-    {
-        write_call(outfile, subroutinename, numargs + 1); // +1 because a reference to the object was pushed first
-    }
-    else
-    {
-        write_call(outfile, subroutinename, numargs);
-    }
+    get_next_token(t, ts); // '('
+    get_next_token(t, ts);
+    call->arguments = compile_expression_list(t, ts, indent, subtable, classname, filearena, &call->numargs);
 
-    free(subroutinename);
+    end_span(&e->span, t, ts); // ')'
+    get_next_token(t, ts);
+    return e;
 }
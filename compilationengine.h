@@ -3,51 +3,46 @@
 
 #include <stdio.h>
 #include "jacktokenizer.h"
-#include "vmwriter.h"
+#include "syntaxtree.h"
 
 //enum {INDENT_WIDTH = 2};
 #define INDENT_WIDTH 2
 
-// these counts are incremented when while and if statements are called, and are
-// used to make labels unique within subroutines
-typedef struct vmlabelcounts
-{
-    unsigned int whilecount;
-    unsigned int ifcount;
-} vmlabelcounts;
+// These parse the class into a syntax tree (see syntaxtree.h) allocated in
+// filearena, resolving names as they go; codegenerator.c turns the tree
+// into VM code.
 
 // book API functions
-void compile_class(token* t, FILE* infile, FILE* outfile, int* linenum,
-    symboltable* classtable, symboltable* subtable);
-void compile_class_var_dec(token* t, FILE* infile, int* linenum, int* indent,
+classnode* compile_class(token* t, tokenstream* ts, symboltable* classtable, symboltable* subtable, arena* filearena);
+void compile_class_var_dec(token* t, tokenstream* ts, int* indent,
     symboltable* classtable);
-void compile_subroutine(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
-void compile_parameter_list(token* t, FILE* infile, int* linenum, int* indent,
+subroutinenode* compile_subroutine(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+void compile_parameter_list(token* t, tokenstream* ts, int* indent,
     symboltable* subtable);
-void compile_var_dec(token* t, FILE* infile, int* linenum, int* indent,
+void compile_var_dec(token* t, tokenstream* ts, int* indent,
     symboltable* subtable);
-void compile_statements(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, vmlabelcounts* labelcounts, const char* classname);
-void compile_do(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
-void compile_let(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
-void compile_while(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, vmlabelcounts* labelcounts, const char* classname);
-void compile_return(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
-void compile_if(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, vmlabelcounts* labelcounts, const char* classname);
-void compile_expression(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
-void compile_term(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
-unsigned int compile_expression_list(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname); // returns number of expressions found in list
+statement* compile_statements(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena); // returns the first statement of the block, NULL if empty
+statement* compile_do(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+statement* compile_let(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+statement* compile_while(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+statement* compile_return(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+statement* compile_if(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+expression* compile_expression(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
+expression* compile_term(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena); // NULL for a token that can't start a term
+expression* compile_expression_list(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena, unsigned int* numexpressions); // returns the first, linked through next
 
 // my functions
-void compile_subroutine_call(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent,
-    symboltable* classtable, symboltable* subtable, const char* classname);
+expression* compile_subroutine_call(token* t, tokenstream* ts, int* indent,
+    symboltable* subtable, atom classname, arena* filearena);
 
 #endif // COMPILATIONENGINE_H
@@ -0,0 +1,189 @@
+#include "compilestats.h"
+#include <string.h>
+#include <time.h>
+
+static const char* phasenames[NUM_PHASES] = { "read", "lex", "parse_tree", "parse", "resolve", "optimize", "codegen", "write" };
+
+
+double stats_clock(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+/*
+* Adds the time since start to phase and returns the current time, to start
+* the next phase from. Does nothing without stats.
+*/
+double end_stats_phase(filestats* stats, compilephase phase, double start)
+{
+    if (stats == NULL)
+    {
+        return 0.0;
+    }
+    double now = stats_clock();
+    stats->seconds[phase] += now - start;
+    return now;
+}
+
+void initialize_file_stats(filestats* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->files = 1;
+    stats->symbols.timed = true;
+}
+
+void add_file_stats(filestats* total, const filestats* stats)
+{
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        total->seconds[i] += stats->seconds[i];
+    }
+    total->files += stats->files;
+    total->sourcebytes += stats->sourcebytes;
+    total->tokens += stats->tokens;
+    total->symbols.lookups += stats->symbols.lookups;
+    total->symbols.probes += stats->symbols.probes;
+    total->symbols.defined += stats->symbols.defined;
+    if (stats->symbols.longestprobe > total->symbols.longestprobe)
+    {
+        total->symbols.longestprobe = stats->symbols.longestprobe;
+    }
+    total->vminstructions += stats->vminstructions;
+    total->folded += stats->folded;
+    total->reduced += stats->reduced;
+    total->pooledstrings += stats->pooledstrings;
+    for (int i = 0; i < NUM_PEEPHOLE_RULES; i++)
+    {
+        total->peephole.hits[i] += stats->peephole.hits[i];
+    }
+    total->peephole.removed += stats->peephole.removed;
+    total->peephole.cycles += stats->peephole.cycles;
+    total->byteswritten += stats->byteswritten;
+}
+
+
+/*
+* Writes text as a JSON string, quotes included.
+*/
+void write_json_string(FILE* outfile, const char* text)
+{
+    fputc('"', outfile);
+    for (; *text != '\0'; text++)
+    {
+        if (*text == '"' || *text == '\\')
+        {
+            fputc('\\', outfile);
+        }
+        fputc(*text, outfile);
+    }
+    fputc('"', outfile);
+}
+
+static double total_seconds(const filestats* stats)
+{
+    double total = 0.0;
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        total += stats->seconds[i];
+    }
+    return total;
+}
+
+static void print_stats_text(FILE* outfile, const filestats* stats)
+{
+    double total = total_seconds(stats);
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        fprintf(outfile, "  %-12s %9.3f ms  %5.1f%%\n", phasenames[i], stats->seconds[i] * 1e3,
+            (total > 0.0) ? stats->seconds[i] * 100.0 / total : 0.0);
+    }
+    fprintf(outfile, "  %-12s %9.3f ms\n", "total", total * 1e3);
+    fprintf(outfile, "  source bytes %lu, tokens %lu, VM instructions %lu, bytes written %lu\n", stats->sourcebytes,
+        stats->tokens, stats->vminstructions, stats->byteswritten);
+    fprintf(outfile, "  operators folded %lu, multiplies and divides reduced %lu, string literals pooled %lu\n",
+        stats->folded, stats->reduced, stats->pooledstrings);
+    fprintf(outfile, "  peephole removed %lu VM instructions, saving about %ld Hack cycles per pass\n",
+        stats->peephole.removed, stats->peephole.cycles);
+    for (int i = 0; i < NUM_PEEPHOLE_RULES; i++)
+    {
+        if (stats->peephole.hits[i] > 0)
+        {
+            fprintf(outfile, "    %-18s %lu\n", peephole_rule_name((peepholerule)i), stats->peephole.hits[i]);
+        }
+    }
+    fprintf(outfile, "  symbols defined %lu, lookups %lu, slots probed %lu (%.2f per lookup, longest %lu)\n",
+        stats->symbols.defined, stats->symbols.lookups, stats->symbols.probes,
+        (stats->symbols.lookups > 0) ? (double)stats->symbols.probes / (double)stats->symbols.lookups : 0.0,
+        stats->symbols.longestprobe);
+}
+
+static void print_stats_json(FILE* outfile, const filestats* stats)
+{
+    fprintf(outfile, "\"ms\": {");
+    for (int i = 0; i < NUM_PHASES; i++)
+    {
+        fprintf(outfile, "\"%s\": %.3f, ", phasenames[i], stats->seconds[i] * 1e3);
+    }
+    fprintf(outfile, "\"total\": %.3f}, ", total_seconds(stats) * 1e3);
+    fprintf(outfile, "\"source_bytes\": %lu, \"tokens\": %lu, \"vm_instructions\": %lu, \"bytes_written\": %lu, ",
+        stats->sourcebytes, stats->tokens, stats->vminstructions, stats->byteswritten);
+    fprintf(outfile, "\"symbols_defined\": %lu, \"lookups\": %lu, \"probes\": %lu, \"longest_probe\": %lu, ",
+        stats->symbols.defined, stats->symbols.lookups, stats->symbols.probes, stats->symbols.longestprobe);
+    fprintf(outfile, "\"operators_folded\": %lu, \"strength_reduced\": %lu, \"strings_pooled\": %lu, ", stats->folded,
+        stats->reduced, stats->pooledstrings);
+    fprintf(outfile, "\"peephole_removed\": %lu, \"peephole_cycles\": %ld, \"peephole_hits\": {",
+        stats->peephole.removed, stats->peephole.cycles);
+    for (int i = 0; i < NUM_PEEPHOLE_RULES; i++)
+    {
+        fprintf(outfile, "%s\"%s\": %lu", (i > 0) ? ", " : "", peephole_rule_name((peepholerule)i), stats->peephole.hits[i]);
+    }
+    fprintf(outfile, "}");
+}
+
+
+void begin_stats_report(statsreport* report, FILE* outfile, statsformat format)
+{
+    report->outfile = outfile;
+    report->format = format;
+    memset(&report->total, 0, sizeof(report->total));
+    if (format == SF_JSON)
+    {
+        fprintf(outfile, "{\n  \"files\": [");
+    }
+}
+
+void report_file_stats(statsreport* report, const char* filename, const filestats* stats)
+{
+    if (report->format == SF_JSON)
+    {
+        fprintf(report->outfile, "%s\n    {\"file\": ", (report->total.files == 0) ? "" : ",");
+        write_json_string(report->outfile, filename);
+        fprintf(report->outfile, ", ");
+        print_stats_json(report->outfile, stats);
+        fprintf(report->outfile, "}");
+    }
+    else if (report->format == SF_TEXT)
+    {
+        fprintf(report->outfile, "Stats for %s:\n", filename);
+        print_stats_text(report->outfile, stats);
+    }
+    add_file_stats(&report->total, stats);
+}
+
+void end_stats_report(statsreport* report)
+{
+    if (report->format == SF_JSON)
+    {
+        fprintf(report->outfile, "%s],\n  \"total\": {\"files\": %lu, ", (report->total.files == 0) ? "" : "\n  ",
+            report->total.files);
+        print_stats_json(report->outfile, &report->total);
+        fprintf(report->outfile, "}\n}\n");
+    }
+    else if (report->format == SF_TEXT)
+    {
+        fprintf(report->outfile, "Stats for all %lu file%s:\n", report->total.files, (report->total.files == 1) ? "" : "s");
+        print_stats_text(report->outfile, &report->total);
+    }
+}
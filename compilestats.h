@@ -0,0 +1,64 @@
+#ifndef COMPILESTATS_H
+#define COMPILESTATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "symboltable.h"
+#include "peephole.h"
+
+// where the time for one file goes; the phases don't overlap, so they add up
+// to the time spent compiling the file
+typedef enum compilephase
+{
+    PH_READ, // opening and loading the source
+    PH_LEX, // building the token stream
+    PH_PARSE_TREE, // the .xml and .tree passes, parsing and formatting the tree
+    PH_PARSE, // the .vm pass building its syntax tree, apart from PH_RESOLVE
+    PH_RESOLVE, // symbol lookups made while building it
+    PH_OPTIMIZE, // the --optimize passes over the tree
+    PH_CODEGEN, // the .vm pass walking the tree to generate code
+    PH_WRITE, // creating, writing and closing output files
+    NUM_PHASES
+} compilephase;
+
+typedef enum statsformat
+{
+    SF_NONE, // no --stats
+    SF_TEXT,
+    SF_JSON
+} statsformat;
+
+// what --stats reports for one file, or for several added together
+typedef struct filestats
+{
+    double seconds[NUM_PHASES];
+    unsigned long files;
+    unsigned long sourcebytes;
+    unsigned long tokens;
+    symbolstats symbols; // from the .vm pass
+    unsigned long vminstructions;
+    unsigned long folded; // operators removed by constant folding
+    unsigned long reduced; // multiplies and divides compiled without a call to Math
+    unsigned long pooledstrings; // distinct string literals kept in statics
+    peepholestats peephole;
+    unsigned long byteswritten; // to every output file
+} filestats;
+
+// collects per-file stats as they are printed, for the total at the end
+typedef struct statsreport
+{
+    FILE* outfile;
+    statsformat format;
+    filestats total;
+} statsreport;
+
+double stats_clock(void); // seconds on a monotonic clock
+double end_stats_phase(filestats* stats, compilephase phase, double start); // charges the time since start, returns now
+void initialize_file_stats(filestats* stats); // all zero, symbol lookups timed
+void add_file_stats(filestats* total, const filestats* stats);
+void begin_stats_report(statsreport* report, FILE* outfile, statsformat format);
+void report_file_stats(statsreport* report, const char* filename, const filestats* stats); // prints it, adds it to the total
+void end_stats_report(statsreport* report); // prints the total
+void write_json_string(FILE* outfile, const char* text); // quoted and escaped
+
+#endif // COMPILESTATS_H
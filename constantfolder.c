@@ -0,0 +1,277 @@
+#include "constantfolder.h"
+
+/*
+* Evaluates constant expressions in the syntax tree, so that
+* "let x = 3 * 4 + 1;" compiles to a single push instead of two pushes and a
+* call to Math.multiply. Nodes are rewritten in place: a folded operator
+* becomes an EX_INT holding the result, which may be negative.
+*
+* Only operators are removed, never operands that have side effects, so a
+* call or array access is always evaluated exactly as often as before.
+*/
+
+
+int to_word(long value)
+{
+    value &= 0xFFFF;
+    return (int)((value > WORD_MAX) ? value - 0x10000 : value);
+}
+
+/*
+* Integer constants above WORD_MAX aren't valid Jack, so they're left for
+* the VM to reject rather than silently wrapped.
+*/
+bool constant_value(const expression* e, int* value)
+{
+    if (e == NULL)
+    {
+        return false;
+    }
+    switch (e->kind)
+    {
+        case EX_INT:
+            *value = e->as.intval;
+            return e->as.intval >= WORD_MIN && e->as.intval <= WORD_MAX;
+        case EX_TRUE:
+            *value = -1;
+            return true;
+        case EX_FALSE:
+        case EX_NULL:
+            *value = 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+
+/*
+* Computes x op y as the VM and the OS would. Returns false for a division
+* the OS would reject or that overflows; those are left to run.
+*/
+static bool apply_binary_operator(char op, int x, int y, int* result)
+{
+    switch (op)
+    {
+        case '+':
+            *result = to_word((long)x + y);
+            return true;
+        case '-':
+            *result = to_word((long)x - y);
+            return true;
+        case '*':
+            *result = to_word((long)x * y); // Math.multiply keeps the low 16 bits
+            return true;
+        case '/':
+            if (y == 0 || x == WORD_MIN || y == WORD_MIN)
+            {
+                return false;
+            }
+            *result = x / y; // truncates toward zero, like Math.divide
+            return true;
+        case '&':
+            *result = to_word((long)x & (long)y);
+            return true;
+        case '|':
+            *result = to_word((long)x | (long)y);
+            return true;
+        case '<':
+            *result = (x < y) ? -1 : 0;
+            return true;
+        case '>':
+            *result = (x > y) ? -1 : 0;
+            return true;
+        case '=':
+            *result = (x == y) ? -1 : 0;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static void make_constant(expression* e, int value)
+{
+    e->kind = EX_INT;
+    e->as.intval = value;
+}
+
+/*
+* Puts operand in the place of e, keeping e's position in any argument list.
+*/
+static void replace_with_operand(expression* e, const expression* operand)
+{
+    expression* next = e->next;
+    sourcespan span = e->span;
+    *e = *operand;
+    e->next = next;
+    e->span = span;
+}
+
+
+/*
+* (a + c1) + c2 and the like become a + c, since addition and subtraction
+* wrap the same way however they're grouped. Returns true if e was changed.
+*/
+static bool regroup_additions(expression* e, int y)
+{
+    char op = e->as.binary.op;
+    expression* inner = e->as.binary.left;
+    int c;
+    if ((op != '+' && op != '-') || inner == NULL || inner->kind != EX_BINARY
+        || (inner->as.binary.op != '+' && inner->as.binary.op != '-')
+        || !constant_value(inner->as.binary.right, &c))
+    {
+        return false;
+    }
+
+    long sum = (long)((inner->as.binary.op == '+') ? c : -c) + ((op == '+') ? y : -y);
+    int word = to_word(sum);
+    e->as.binary.left = inner->as.binary.left;
+    if (word < 0 && word != WORD_MIN)
+    {
+        e->as.binary.op = '-';
+        make_constant(e->as.binary.right, -word);
+    }
+    else
+    {
+        e->as.binary.op = '+';
+        make_constant(e->as.binary.right, word);
+    }
+    return true;
+}
+
+/*
+* Folds e, whose operands are already folded. Returns the number of
+* operators removed.
+*/
+static unsigned long fold_binary(expression* e)
+{
+    char op = e->as.binary.op;
+    expression* left = e->as.binary.left;
+    expression* right = e->as.binary.right;
+    int x = 0;
+    int y = 0;
+    bool leftconstant = constant_value(left, &x);
+    bool rightconstant = constant_value(right, &y);
+
+    if (leftconstant && rightconstant)
+    {
+        int result;
+        if (!apply_binary_operator(op, x, y, &result))
+        {
+            return 0;
+        }
+        make_constant(e, result);
+        return 1;
+    }
+
+    unsigned long folded = 0;
+    if (rightconstant && regroup_additions(e, y))
+    {
+        folded++;
+        op = e->as.binary.op;
+        left = e->as.binary.left;
+        constant_value(right, &y);
+    }
+
+    // operations that leave the other operand as it is
+    if (rightconstant && left != NULL
+        && ((y == 0 && (op == '+' || op == '-' || op == '|')) || (y == 1 && (op == '*' || op == '/')) || (y == -1 && op == '&')))
+    {
+        replace_with_operand(e, left);
+        folded++;
+    }
+    else if (leftconstant && right != NULL
+        && ((x == 0 && (op == '+' || op == '|')) || (x == 1 && op == '*') || (x == -1 && op == '&')))
+    {
+        replace_with_operand(e, right);
+        folded++;
+    }
+    return folded;
+}
+
+static unsigned long fold_expression(expression* e)
+{
+    if (e == NULL)
+    {
+        return 0;
+    }
+
+    unsigned long folded = 0;
+    int x;
+    switch (e->kind)
+    {
+        case EX_VARIABLE:
+            folded += fold_expression(e->as.variable.index);
+            break;
+        case EX_CALL:
+            for (expression* argument = e->as.call.arguments; argument != NULL; argument = argument->next)
+            {
+                folded += fold_expression(argument);
+            }
+            break;
+        case EX_UNARY:
+            folded += fold_expression(e->as.unary.operand);
+            if (constant_value(e->as.unary.operand, &x))
+            {
+                // a negative literal such as -1 is folded for the sake of the operators around
+                // it, but compiles to the same push and neg either way, so it isn't counted
+                if (!(e->as.unary.op == '-' && e->as.unary.operand->kind == EX_INT && x > 0))
+                {
+                    folded++;
+                }
+                make_constant(e, (e->as.unary.op == '-') ? to_word(-(long)x) : to_word(~(long)x));
+            }
+            break;
+        case EX_BINARY:
+            folded += fold_expression(e->as.binary.left);
+            folded += fold_expression(e->as.binary.right);
+            folded += fold_binary(e);
+            break;
+        default:
+            break;
+    }
+    return folded;
+}
+
+static unsigned long fold_statements(statement* s)
+{
+    unsigned long folded = 0;
+    for (; s != NULL; s = s->next)
+    {
+        switch (s->kind)
+        {
+            case ST_LET:
+                folded += fold_expression(s->as.let.index);
+                folded += fold_expression(s->as.let.value);
+                break;
+            case ST_IF:
+                folded += fold_expression(s->as.ifelse.condition);
+                folded += fold_statements(s->as.ifelse.thenbranch);
+                folded += fold_statements(s->as.ifelse.elsebranch);
+                break;
+            case ST_WHILE:
+                folded += fold_expression(s->as.loop.condition);
+                folded += fold_statements(s->as.loop.body);
+                break;
+            case ST_DO:
+                folded += fold_expression(s->as.call);
+                break;
+            case ST_RETURN:
+                folded += fold_expression(s->as.value);
+                break;
+        }
+    }
+    return folded;
+}
+
+
+unsigned long fold_constants(classnode* node)
+{
+    unsigned long folded = 0;
+    for (subroutinenode* subroutine = node->subroutines; subroutine != NULL; subroutine = subroutine->next)
+    {
+        folded += fold_statements(subroutine->body);
+    }
+    return folded;
+}
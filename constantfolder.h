@@ -0,0 +1,17 @@
+#ifndef CONSTANTFOLDER_H
+#define CONSTANTFOLDER_H
+
+#include <stdbool.h>
+#include "syntaxtree.h"
+
+// Jack integers are 16-bit two's complement, with true as -1 and false and
+// null as 0. Folding works on the same words the VM does, so a folded
+// expression always has the value the VM would have computed.
+#define WORD_MIN (-32768)
+#define WORD_MAX 32767
+
+int to_word(long value); // wraps value to 16 bits, as the VM's arithmetic does
+bool constant_value(const expression* e, int* value); // true if e is a literal, with its word value
+unsigned long fold_constants(classnode* node); // folds every subroutine, returns operators evaluated or dropped
+
+#endif // CONSTANTFOLDER_H
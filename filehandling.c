@@ -1,9 +1,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <sys/stat.h>
 #include <assert.h>
 #include "filehandling.h"
-#include "jacktokenizer.h"
+#include "jackcompiler.h"
+#include "jacksource.h"
+#include "workpool.h"
+#include "buildcache.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define FILEHANDLING_HAS_WRITE
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 /*
 * helper function that checks filename for .jack extension
@@ -28,80 +38,281 @@ bool is_jack_file(const char* const filename)
     }
 }
 
+// a .jack file found in directory mode, and what compiling it printed
+typedef struct jackfile
+{
+    char* filename;
+    const char* name; // filename without the directory
+    long size;
+    unsigned long long hash; // of the contents, for the build cache
+    bool hashed;
+    bool uptodate; // outputs from an earlier build can be kept
+    bool succeeded; // compiled without errors
+    filestats stats; // filled in with --stats
+    char* messages; // captured stdout output when compiled on the work pool
+    size_t messageslength;
+    char* errors; // captured stderr output
+    size_t errorslength;
+} jackfile;
+
+// what the work pool threads need to compile an item
+typedef struct directoryjob
+{
+    jackfile* files;
+    const compileoptions* options;
+} directoryjob;
+
+// for sorting the files largest first
+typedef struct sizeorder
+{
+    long size;
+    size_t index;
+} sizeorder;
+
+static int compare_filenames(const void* a, const void* b)
+{
+    return strcmp(((const jackfile*)a)->filename, ((const jackfile*)b)->filename);
+}
+
+static int compare_sizes(const void* a, const void* b)
+{
+    const sizeorder* x = a;
+    const sizeorder* y = b;
+    if (x->size != y->size)
+    {
+        return (x->size > y->size) ? -1 : 1;
+    }
+    return (x->index < y->index) ? -1 : (x->index > y->index);
+}
+
+
 /*
-* Opens directory and tokenizes all .jack files inside, creating a
-* separate .xml output file for each one. Returns false if unable to
-* open the provided name as a directory.
+* Collects the path and size of every .jack file in directory, sorted by
+* path so that files are always reported in the same order. Returns NULL
+* (with *count 0) if there are none.
 */
-bool tokenize_directory(const char* const directoryname)
+static jackfile* list_jack_files(DIR* directory, const char* const directoryname, size_t* count)
 {
-    fprintf(stdout, "Attempting to open %s as a directory...\n", directoryname);
+    jackfile* files = NULL;
+    size_t capacity = 0;
+    *count = 0;
 
-    DIR* directory = opendir(directoryname);
-    if (directory == NULL)
+    struct dirent* currententry;
+    while ((currententry = readdir(directory)) != NULL)
     {
-        fprintf(stdout, "Could not open %s as a directory.\n", directoryname);
-        return false;
+        if (!is_jack_file(currententry->d_name)) // only attempt to parse .jack files
+        {
+            continue;
+        }
+        if (*count == capacity)
+        {
+            capacity = (capacity == 0) ? 64 : capacity * 2;
+            jackfile* temp = realloc(files, capacity * sizeof(*temp));
+            if (temp == NULL)
+            {
+                fprintf(stderr, "Error: could not reallocate memory for file list\n");
+                exit(1);
+            }
+            files = temp;
+        }
+
+        char* currentfilename = malloc((strlen(directoryname) + strlen(currententry->d_name) + 2) * sizeof(char)); // +1 for NUL, +1 for separator
+        if (currentfilename == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate memory for currentfilename\n");
+            exit(1);
+        }
+        // build an (abbreviated) filepath for the files in the directory
+        strcpy(currentfilename, directoryname);
+        strcat(currentfilename, PATH_SEPARATOR);
+        strcat(currentfilename, currententry->d_name);
+
+        jackfile* file = &files[(*count)++];
+        struct stat info;
+        file->filename = currentfilename;
+        file->name = currentfilename + strlen(directoryname) + strlen(PATH_SEPARATOR);
+        file->size = (stat(currentfilename, &info) == 0) ? (long)info.st_size : 0;
+        file->hash = 0;
+        file->hashed = false;
+        file->uptodate = false;
+        file->succeeded = false;
+        initialize_file_stats(&file->stats);
+        file->messages = NULL;
+        file->messageslength = 0;
+        file->errors = NULL;
+        file->errorslength = 0;
+    }
+
+    if (*count > 1)
+    {
+        qsort(files, *count, sizeof(*files), compare_filenames);
+    }
+    return files;
+}
+
+
+/*
+* Work pool job: compiles one file with its output captured in memory, so
+* it can be printed later without interleaving with other files.
+*/
+static void compile_listed_file(size_t item, void* context)
+{
+    directoryjob* job = context;
+    jackfile* file = &job->files[item];
+    FILE* messages = NULL;
+    FILE* errors = NULL;
+#ifdef WORKPOOL_HAS_THREADS
+    messages = open_memstream(&file->messages, &file->messageslength);
+    errors = open_memstream(&file->errors, &file->errorslength);
+#endif
+    file->succeeded = compile_jack_file(file->filename, job->options, (messages != NULL) ? messages : stdout, (errors != NULL) ? errors : stderr,
+        (job->options->stats != SF_NONE) ? &file->stats : NULL);
+    if (messages != NULL)
+    {
+        fclose(messages);
+    }
+    if (errors != NULL)
+    {
+        fclose(errors);
+    }
+}
+
+
+/*
+* Returns a malloc'd copy of infilename with its extension replaced by
+* extension, or NULL if there is no memory for it.
+*/
+static char* make_output_filename(const char* const infilename, const char* const extension)
+{
+    assert(is_jack_file(infilename)); // DEBUG
+
+    char* outfilename = malloc((strlen(infilename) + strlen(extension) + 1) * sizeof(*outfilename)); // +1 for NUL
+    if (outfilename == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for outfilename\n");
     }
     else
     {
-        fprintf(stdout, "...success!\n", directoryname);
+        outfilename = strcpy(outfilename, infilename);
+        char* period = strchr(outfilename, '.');
+        period[1] = '\0'; // period is a pointer within outfilename, so this should affect outfilename as well
+        strcat(period, extension);
+    }
+    return outfilename;
+}
 
-        FILE* infile = NULL;
-        FILE* outfile = NULL;
-        struct dirent* currententry;
 
-        while ((currententry = readdir(directory)) != NULL)
+/*
+* Returns true if every output file options asks for already exists for infilename.
+*/
+bool outputs_exist(const char* const infilename, unsigned int outputs)
+{
+    static const struct
+    {
+        outputkind kind;
+        const char* extension;
+    } outputfiles[] = { { OUT_VM, "vm" }, { OUT_XML, "xml" }, { OUT_TREE, "tree" } };
+
+    bool exist = true;
+    for (size_t i = 0; exist && i < sizeof(outputfiles) / sizeof(outputfiles[0]); i++)
+    {
+        if (outputs & outputfiles[i].kind)
         {
-            if (is_jack_file(currententry->d_name)) // only attempt to parse .jack files
-            {
-                char* currentfilename = malloc((strlen(directoryname) + strlen(currententry->d_name) + 2) * sizeof(char)); // +1 for NUL, +1 for '\\'
-                if (currentfilename == NULL)
-                {
-                    fprintf(stderr, "Error: could not allocate memory for currentfilename\n");
-                }
-                else
-                {
-                    // build an (abbreviated) filepath for the files in the directory
-                    strcpy(currentfilename, directoryname);
-                    strcat(currentfilename, "\\");
-                    strcat(currentfilename, currententry->d_name);
-                    if ((infile = fopen(currentfilename, "r")) == NULL)
-                    {
-                        fprintf(stderr, "Error: could not open file %s\n", currentfilename);
-                    }
-                    else
-                    {
-                        outfile = create_output_xml_file(currentfilename);
-                        if (outfile == NULL)
-                        {
-                            fprintf(stderr, "Error: could not open outfile\n");
-                        }
-                        else
-                        {
-                            fprintf(stdout, "Tokenizing %s...\n", currentfilename);
-                            tokenize(infile, outfile);
-                        }
-                    }
-                    fclose(infile);
-                    fclose(outfile);
-                }
-                free(currentfilename);
-                currentfilename = NULL;
-            }
+            struct stat info;
+            char* outfilename = make_output_filename(infilename, outputfiles[i].extension);
+            exist = (outfilename != NULL && stat(outfilename, &info) == 0);
+            free(outfilename);
+        }
+    }
+    return exist;
+}
+
+
+/*
+* Hashes each file and compares it with the manifest from the last build,
+* marking the files whose outputs can be kept. Returns how many there are.
+*/
+static size_t check_build_cache(jackfile* files, size_t count, const buildcache* cache, unsigned int outputs)
+{
+    size_t uptodate = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned long long cachedhash;
+        files[i].hashed = hash_file_contents(files[i].filename, &files[i].hash);
+        files[i].uptodate = files[i].hashed
+            && find_cached_hash(cache, files[i].name, &cachedhash) && cachedhash == files[i].hash
+            && outputs_exist(files[i].filename, outputs);
+        if (files[i].uptodate)
+        {
+            uptodate++;
+        }
+    }
+    return uptodate;
+}
+
+
+/*
+* Records every file whose outputs are now current, dropping files that
+* failed to compile or no longer exist, and saves the manifest.
+*/
+static void update_build_cache(const jackfile* files, size_t count, const char* const directoryname, unsigned long long optionskey)
+{
+    buildcache cache;
+    cache.entries = NULL;
+    cache.count = 0;
+    cache.capacity = 0;
+    cache.optionskey = optionskey;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (files[i].hashed && (files[i].uptodate || files[i].succeeded))
+        {
+            add_cache_entry(&cache, files[i].name, files[i].hash);
         }
-        closedir(directory);
-        return true;
+    }
+    save_build_cache(&cache, directoryname);
+    free_build_cache(&cache);
+}
+
+
+/*
+* Starts the --stats report in options->statsfile, or on stdout. Returns
+* false if the file can't be created.
+*/
+static bool begin_stats_output(statsreport* report, const compileoptions* options)
+{
+    FILE* outfile = stdout;
+    if (options->statsfile != NULL && (outfile = fopen(options->statsfile, "w")) == NULL)
+    {
+        fprintf(stderr, "Error: could not open %s\n", options->statsfile);
+        return false;
+    }
+    begin_stats_report(report, outfile, options->stats);
+    return true;
+}
+
+static void end_stats_output(statsreport* report)
+{
+    end_stats_report(report);
+    if (report->outfile != stdout && fclose(report->outfile) != 0)
+    {
+        fprintf(stderr, "Error: could not write stats\n");
     }
 }
 
 
 /*
 * Opens directory and compiles all .jack files inside, creating a
-* separate .vm output file for each one. Returns false if unable to
-* open the provided name as a directory.
+* separate set of output files for each one. Returns false if unable
+* to open the provided name as a directory.
+*
+* Unless options->usecache is off, files whose contents and options match
+* the manifest from the last build (see buildcache.h) are skipped.
+*
+* With options->jobs above 1 the files are compiled on a work pool, largest
+* first. Each file's messages are held back and printed in filename order
+* once everything is done, so the output is the same as a serial run.
 */
-bool compile_directory(const char* const directoryname)
+bool compile_directory(const char* const directoryname, const compileoptions* options)
 {
     fprintf(stdout, "Attempting to open %s as a directory...\n", directoryname);
 
@@ -111,189 +322,319 @@ bool compile_directory(const char* const directoryname)
         fprintf(stdout, "Could not open %s as a directory.\n", directoryname);
         return false;
     }
+
+    fprintf(stdout, "...success!\n");
+
+    size_t count = 0;
+    jackfile* files = list_jack_files(directory, directoryname, &count);
+    closedir(directory);
+
+    unsigned long long optionskey = options_key(options);
+    size_t uptodate = 0;
+    if (options->usecache)
+    {
+        buildcache cache;
+        load_build_cache(&cache, directoryname, optionskey);
+        uptodate = check_build_cache(files, count, &cache, options->outputs);
+        free_build_cache(&cache);
+        fprintf(stdout, "%zu of %zu files up to date\n", uptodate, count);
+    }
+
+    if (options->jobs <= 1 || count - uptodate <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!files[i].uptodate)
+            {
+                files[i].succeeded = compile_jack_file(files[i].filename, options, stdout, stderr,
+                    (options->stats != SF_NONE) ? &files[i].stats : NULL);
+            }
+        }
+    }
     else
     {
-        fprintf(stdout, "...success!\n", directoryname);
+        size_t numstale = 0;
+        size_t* order = malloc(count * sizeof(*order));
+        sizeorder* sizes = malloc(count * sizeof(*sizes));
+        if (order == NULL || sizes == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate memory for file order\n");
+            exit(1);
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!files[i].uptodate)
+            {
+                sizes[numstale].size = files[i].size;
+                sizes[numstale].index = i;
+                numstale++;
+            }
+        }
+        qsort(sizes, numstale, sizeof(*sizes), compare_sizes);
+        for (size_t i = 0; i < numstale; i++)
+        {
+            order[i] = sizes[i].index;
+        }
 
-        FILE* infile = NULL;
-        FILE* outfile = NULL;
-        struct dirent* currententry;
+        directoryjob job;
+        job.files = files;
+        job.options = options;
+        run_work_pool(order, numstale, options->jobs, compile_listed_file, &job);
 
-        while ((currententry = readdir(directory)) != NULL)
+        for (size_t i = 0; i < count; i++)
         {
-            if (is_jack_file(currententry->d_name)) // only attempt to parse .jack files
+            if (files[i].messageslength > 0) // nothing was captured for cached files
             {
-                char* currentfilename = malloc((strlen(directoryname) + strlen(currententry->d_name) + 2) * sizeof(char)); // +1 for NUL, +1 for '\\'
-                if (currentfilename == NULL)
-                {
-                    fprintf(stderr, "Error: could not allocate memory for currentfilename\n");
-                }
-                else
+                fwrite(files[i].messages, 1, files[i].messageslength, stdout);
+                fflush(stdout);
+            }
+            if (files[i].errorslength > 0)
+            {
+                fwrite(files[i].errors, 1, files[i].errorslength, stderr);
+            }
+            free(files[i].messages);
+            free(files[i].errors);
+        }
+        free(order);
+        free(sizes);
+    }
+
+    if (options->usecache && (uptodate < count || count == 0))
+    {
+        update_build_cache(files, count, directoryname, optionskey);
+    }
+
+    if (options->stats != SF_NONE)
+    {
+        statsreport report;
+        if (begin_stats_output(&report, options))
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!files[i].uptodate)
                 {
-                    // build an (abbreviated) filepath for the files in the directory
-                    strcpy(currentfilename, directoryname);
-                    strcat(currentfilename, "\\");
-                    strcat(currentfilename, currententry->d_name);
-                    if ((infile = fopen(currentfilename, "r")) == NULL)
-                    {
-                        fprintf(stderr, "Error: could not open file %s\n", currentfilename);
-                    }
-                    else
-                    {
-                        outfile = create_output_vm_file(currentfilename);
-                        if (outfile == NULL)
-                        {
-                            fprintf(stderr, "Error: could not open outfile\n");
-                        }
-                        else
-                        {
-                            fprintf(stdout, "Compiling %s...\n", currentfilename);
-                            compile(infile, outfile);
-                        }
-                    }
-                    fclose(infile);
-                    fclose(outfile);
+                    report_file_stats(&report, files[i].filename, &files[i].stats);
                 }
-                free(currentfilename);
-                currentfilename = NULL;
             }
+            end_stats_output(&report);
         }
-        closedir(directory);
-        return true;
     }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        free(files[i].filename);
+    }
+    free(files);
+    return true;
 }
 
 
 /*
-/ Tokenizes a single .jack file, creating a single .xml file as output.
+* Writes the whole of data to outfile with as few system calls as possible
+* (normally one).
 */
-void tokenize_single_file(const char* const infilename)
+static bool write_output(FILE* outfile, const char* data, size_t length)
 {
-    fprintf(stdout, "Attempting to open %s as a single file...\n", infilename);
+#ifdef FILEHANDLING_HAS_WRITE
+    fflush(outfile); // in case anything went through stdio first
+    int fd = fileno(outfile);
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t result = write(fd, data + written, length - written);
+        if (result < 0 && errno != EINTR)
+        {
+            return false;
+        }
+        if (result > 0)
+        {
+            written += (size_t)result;
+        }
+    }
+    return true;
+#else
+    return fwrite(data, 1, length, outfile) == length;
+#endif
+}
+
+// the output files compile_jack_file() opened, one per requested output
+typedef struct outputfiles
+{
+    FILE* vm;
+    FILE* xml;
+    FILE* tree;
+} outputfiles;
+
+static bool write_to_output_file(outputkind kind, const char* data, size_t length, void* context)
+{
+    const outputfiles* files = context;
+    FILE* outfile = (kind == OUT_XML) ? files->xml : (kind == OUT_TREE) ? files->tree : files->vm;
+    return write_output(outfile, data, length);
+}
+
+/*
+* Closes an output file if it was opened, returning false if anything
+* written to it was lost.
+*/
+static bool close_output_file(FILE* outfile, const char* const infilename, FILE* errors)
+{
+    if (outfile == NULL || fclose(outfile) == 0)
+    {
+        return true;
+    }
+    fprintf(errors, "Error: could not write output for %s\n", infilename);
+    return false;
+}
+
 
+/*
+* Loads a .jack file and compiles it with compile_jack_buffer() (see
+* jackcompiler.h): the parse tree goes to a matching .xml and/or .tree file
+* and the VM code to a matching .vm file. Passes that weren't requested do
+* no work. With stats, each phase is timed and counted (see compilestats.h).
+*/
+bool compile_jack_file(const char* const infilename, const compileoptions* options, FILE* messages, FILE* errors, filestats* stats)
+{
+    double start = (stats != NULL) ? stats_clock() : 0.0;
     FILE* infile = NULL;
-    FILE* outfile = NULL;
+    if ((infile = fopen(infilename, "r")) == NULL)
+    {
+        fprintf(errors, "Error: could not open file %s\n", infilename);
+        return false;
+    }
+    jacksource source;
+    if (!open_jack_source(&source, infile))
+    {
+        fprintf(errors, "Error: could not read file %s\n", infilename);
+        fclose(infile);
+        return false;
+    }
+    start = end_stats_phase(stats, PH_READ, start);
 
-    if (!is_jack_file(infilename))
+    bool succeeded = true;
+    unsigned int outputs = options->outputs;
+    outputfiles files;
+    files.xml = (outputs & OUT_XML) ? create_output_xml_file(infilename) : NULL;
+    files.tree = (outputs & OUT_TREE) ? create_output_tree_file(infilename) : NULL;
+    files.vm = (outputs & OUT_VM) ? create_output_vm_file(infilename) : NULL;
+    if (((outputs & OUT_XML) && files.xml == NULL) || ((outputs & OUT_TREE) && files.tree == NULL)
+        || ((outputs & OUT_VM) && files.vm == NULL))
     {
-        fprintf(stderr, "Error: %s is not a .jack file\n", infilename);
+        fprintf(errors, "Error: could not open outfile\n");
+        outputs &= (files.xml != NULL ? OUT_XML : 0) | (files.tree != NULL ? OUT_TREE : 0) | (files.vm != NULL ? OUT_VM : 0);
+        succeeded = false;
     }
-    else
+    end_stats_phase(stats, PH_WRITE, start);
+
+    if (outputs & OUT_XML)
     {
-        if ((infile = fopen(infilename, "r")) == NULL)
-        {
-            fprintf(stderr, "Error: could not open file %s\n", infilename);
-        }
-        else
-        {
-            fprintf(stdout, "...success!\n");
+        fprintf(messages, "Tokenizing %s...\n", infilename);
+    }
+    if (outputs & OUT_TREE)
+    {
+        fprintf(messages, "Writing parse tree for %s...\n", infilename);
+    }
+    if (outputs & OUT_VM)
+    {
+        fprintf(messages, "Compiling %s...\n", infilename);
+    }
 
-            outfile = create_output_xml_file(infilename);
-            if (outfile == NULL)
-            {
-                fprintf(stderr, "Error: could not open outfile\n");
-            }
-            else
-            {
-                fprintf(stdout, "Tokenizing %s...\n", infilename);
-                tokenize(infile, outfile);
-            }
-        }
+    jackrequest request;
+    jackresult result;
+    initialize_jack_request(&request, infilename, source.data, source.length);
+    request.outputs = outputs;
+    request.optimizations = options->optimizations;
+    request.sink = write_to_output_file;
+    request.sinkcontext = &files;
+    request.trace = messages;
+    request.stats = stats;
+    succeeded = compile_jack_buffer(&request, &result) && succeeded;
+    if (result.diagnostics.length > 0)
+    {
+        fwrite(result.diagnostics.data, 1, result.diagnostics.length, errors);
     }
+    free_jack_result(&result);
+
+    start = (stats != NULL) ? stats_clock() : 0.0;
+    succeeded = close_output_file(files.xml, infilename, errors) && succeeded;
+    succeeded = close_output_file(files.tree, infilename, errors) && succeeded;
+    succeeded = close_output_file(files.vm, infilename, errors) && succeeded;
+    end_stats_phase(stats, PH_WRITE, start);
+
+    close_jack_source(&source);
+    fclose(infile);
+    return succeeded;
 }
 
 
 /*
-/ Compiles a single .jack file, creating a single .vm file as output.
+/ Compiles a single .jack file, creating one of each requested output file.
 */
-void compile_single_file(const char* const infilename)
+void compile_single_file(const char* const infilename, const compileoptions* options)
 {
     fprintf(stdout, "Attempting to open %s as a single file...\n", infilename);
 
-    FILE* infile = NULL;
-    FILE* outfile = NULL;
-
     if (!is_jack_file(infilename))
     {
         fprintf(stderr, "Error: %s is not a .jack file\n", infilename);
     }
     else
     {
-        if ((infile = fopen(infilename, "r")) == NULL)
-        {
-            fprintf(stderr, "Error: could not open file %s\n", infilename);
-        }
-        else
-        {
-            fprintf(stdout, "...success!\n");
+        filestats stats;
+        initialize_file_stats(&stats);
+        compile_jack_file(infilename, options, stdout, stderr, (options->stats != SF_NONE) ? &stats : NULL);
 
-            outfile = create_output_vm_file(infilename);
-            if (outfile == NULL)
-            {
-                fprintf(stderr, "Error: could not open outfile\n");
-            }
-            else
-            {
-                fprintf(stdout, "Compiling %s...\n", infilename);
-                compile(infile, outfile);
-            }
+        statsreport report;
+        if (options->stats != SF_NONE && begin_stats_output(&report, options))
+        {
+            report_file_stats(&report, infilename, &stats);
+            end_stats_output(&report);
         }
     }
 }
 
 
 /*
-* Creates an .xml filename to match the .jack input filename and opens
-* the file for writing.
+* Opens the output file with the given extension for infilename, using the
+* given fopen() mode.
 */
-FILE* create_output_xml_file(const char* const infilename)
+static FILE* create_output_file(const char* const infilename, const char* const extension, const char* const mode)
 {
-    assert(is_jack_file(infilename)); // DEBUG
-
     FILE* outfile = NULL;
-    char* outfilename = malloc((strlen(infilename) + 1) * sizeof(*outfilename)); // +1 for NUL
-    if (outfilename == NULL)
+    char* outfilename = make_output_filename(infilename, extension);
+    if (outfilename != NULL)
     {
-        fprintf(stderr, "Error: could not allocate memory for outfilename\n");
-    }
-    else
-    {
-        outfilename = strcpy(outfilename, infilename);
-        char* period = strchr(outfilename, '.');
-        period[1] = '\0'; // period is a pointer within outfilename, so this should affect outfilename as well
-        strcat(period, "xml");
-        outfile = fopen(outfilename, "w");
+        outfile = fopen(outfilename, mode);
     }
     free(outfilename);
 
     return outfile;
 }
 
+/*
+* Creates an .xml filename to match the .jack input filename and opens
+* the file for writing.
+*/
+FILE* create_output_xml_file(const char* const infilename)
+{
+    return create_output_file(infilename, "xml", "w");
+}
+
 /*
 * Creates a .vm filename to match the .jack input filename and opens
 * the file for writing.
 */
 FILE* create_output_vm_file(const char* const infilename)
 {
-    assert(is_jack_file(infilename)); // DEBUG
-
-    FILE* outfile = NULL;
-    char* outfilename = malloc((strlen(infilename) + 1) * sizeof(*outfilename)); // +1 for NUL
-    if (outfilename == NULL)
-    {
-        fprintf(stderr, "Error: could not allocate memory for outfilename\n");
-    }
-    else
-    {
-        outfilename = strcpy(outfilename, infilename);
-        char* period = strchr(outfilename, '.');
-        period[1] = '\0'; // period is a pointer within outfilename, so this should affect outfilename as well
-        strcat(period, "vm");
-        outfile = fopen(outfilename, "w");
-    }
-    free(outfilename);
-
-    return outfile;
+    return create_output_file(infilename, "vm", "w");
 }
 
-
+/*
+* Creates a .tree filename to match the .jack input filename and opens
+* the file for writing. It gets the binary parse tree, so it is opened in
+* binary mode.
+*/
+FILE* create_output_tree_file(const char* const infilename)
+{
+    return create_output_file(infilename, "tree", "wb");
+}
@@ -3,13 +3,21 @@
 
 #include <stdio.h>
 #include <stdbool.h>
+#include "options.h"
+
+#ifdef _WIN32
+#define PATH_SEPARATOR "\\"
+#else
+#define PATH_SEPARATOR "/"
+#endif
 
 bool is_jack_file(const char* const filename);
-bool tokenize_directory(const char* const directoryname);
-bool compile_directory(const char* const directoryname);
-void tokenize_single_file(const char* const infilename);
-void compile_single_file(const char* const infilename);
+bool compile_directory(const char* const directoryname, const compileoptions* options);
+void compile_single_file(const char* const infilename, const compileoptions* options);
+bool compile_jack_file(const char* const infilename, const compileoptions* options, FILE* messages, FILE* errors, filestats* stats); // lexes once, writes each requested output, false on any error
+bool outputs_exist(const char* const infilename, unsigned int outputs); // every file asked for in outputs is already there
 FILE* create_output_xml_file(const char* const infilename); // creates an .xml filename to match .jack input filename, opens file for writing
 FILE* create_output_vm_file(const char* const infilename); // creates a .vm filename to match .jack input filename, opens file for writing
+FILE* create_output_tree_file(const char* const infilename); // same for the binary .tree parse tree
 
 #endif // FILEHANDLING_H
@@ -0,0 +1,190 @@
+#include "interner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_ATOMS 256
+#define INITIAL_TEXT 4096
+
+
+/*
+* Returns a hash value for the first length chars of s.
+*/
+unsigned int hash_text(const char* s, size_t length)
+{
+    unsigned int hashval = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        hashval = (unsigned char)s[i] + ((hashval << 5) - hashval);
+    }
+    return hashval;
+}
+
+
+/*
+* Rebuilds the slot index at twice its size, reusing each atom's stored hash.
+*/
+static bool grow_slots(interner* in)
+{
+    size_t newnumslots = in->numslots * 2;
+    atom* newslots = calloc(newnumslots, sizeof(*newslots));
+    if (newslots == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for interner slots\n");
+        return false;
+    }
+    for (size_t a = 0; a < in->count; a++)
+    {
+        size_t slot = in->hashes[a] & (newnumslots - 1);
+        while (newslots[slot] != 0)
+        {
+            slot = (slot + 1) & (newnumslots - 1);
+        }
+        newslots[slot] = (atom)a + 1;
+    }
+    free(in->slots);
+    in->slots = newslots;
+    in->numslots = newnumslots;
+    return true;
+}
+
+static bool grow_atoms(interner* in)
+{
+    size_t newcapacity = in->capacity * 2;
+    unsigned int* offsets = realloc(in->offsets, newcapacity * sizeof(*offsets));
+    if (offsets != NULL)
+    {
+        in->offsets = offsets;
+    }
+    unsigned int* lengths = realloc(in->lengths, newcapacity * sizeof(*lengths));
+    if (lengths != NULL)
+    {
+        in->lengths = lengths;
+    }
+    unsigned int* hashes = realloc(in->hashes, newcapacity * sizeof(*hashes));
+    if (hashes != NULL)
+    {
+        in->hashes = hashes;
+    }
+    if (offsets == NULL || lengths == NULL || hashes == NULL)
+    {
+        fprintf(stderr, "Error: could not reallocate memory for interner\n");
+        return false;
+    }
+    in->capacity = newcapacity;
+    return true;
+}
+
+
+/*
+* Sets up an empty interner and interns "none" so it is always ATOM_NONE.
+*/
+bool initialize_interner(interner* in)
+{
+    in->textlength = 0;
+    in->textcapacity = INITIAL_TEXT;
+    in->count = 0;
+    in->capacity = INITIAL_ATOMS;
+    in->numslots = INITIAL_ATOMS * 2;
+    in->text = malloc(in->textcapacity * sizeof(*(in->text)));
+    in->offsets = malloc(in->capacity * sizeof(*(in->offsets)));
+    in->lengths = malloc(in->capacity * sizeof(*(in->lengths)));
+    in->hashes = malloc(in->capacity * sizeof(*(in->hashes)));
+    in->slots = calloc(in->numslots, sizeof(*(in->slots)));
+    if (in->text == NULL || in->offsets == NULL || in->lengths == NULL || in->hashes == NULL || in->slots == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for interner\n");
+        free_interner(in);
+        return false;
+    }
+
+    intern_string(in, "none", 4);
+    return true;
+}
+
+void free_interner(interner* in)
+{
+    free(in->text);
+    free(in->offsets);
+    free(in->lengths);
+    free(in->hashes);
+    free(in->slots);
+    in->text = NULL;
+    in->offsets = NULL;
+    in->lengths = NULL;
+    in->hashes = NULL;
+    in->slots = NULL;
+    in->count = 0;
+}
+
+
+/*
+* Returns the atom for the first length chars of s, adding a copy of the
+* text to the interner the first time it is seen.
+*/
+atom intern_string(interner* in, const char* s, size_t length)
+{
+    unsigned int hashval = hash_text(s, length);
+    size_t slot = hashval & (in->numslots - 1);
+    while (in->slots[slot] != 0)
+    {
+        atom a = in->slots[slot] - 1;
+        if (in->hashes[a] == hashval && in->lengths[a] == length && memcmp(in->text + in->offsets[a], s, length) == 0)
+        {
+            return a;
+        }
+        slot = (slot + 1) & (in->numslots - 1);
+    }
+
+    // not seen before, so store it
+    if (in->count == in->capacity && !grow_atoms(in))
+    {
+        exit(1);
+    }
+    if (in->textlength + length + 1 > in->textcapacity)
+    {
+        while (in->textlength + length + 1 > in->textcapacity)
+        {
+            in->textcapacity *= 2;
+        }
+        char* temp = realloc(in->text, in->textcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for interner text\n");
+            exit(1);
+        }
+        in->text = temp;
+    }
+
+    atom a = (atom)in->count;
+    memcpy(in->text + in->textlength, s, length);
+    in->text[in->textlength + length] = '\0';
+    in->offsets[a] = (unsigned int)in->textlength;
+    in->lengths[a] = (unsigned int)length;
+    in->hashes[a] = hashval;
+    in->textlength += length + 1;
+    in->count++;
+    in->slots[slot] = a + 1;
+
+    // keep the index at most half full
+    if (in->count * 2 > in->numslots && !grow_slots(in))
+    {
+        exit(1);
+    }
+    return a;
+}
+
+const char* atom_text(const interner* in, atom a)
+{
+    return in->text + in->offsets[a];
+}
+
+size_t atom_length(const interner* in, atom a)
+{
+    return in->lengths[a];
+}
+
+unsigned int atom_hash(const interner* in, atom a)
+{
+    return in->hashes[a];
+}
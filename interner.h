@@ -0,0 +1,36 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// an interned string; two atoms from the same interner are equal exactly when
+// their text is equal, so names can be compared and hashed as integers
+typedef unsigned int atom;
+
+#define ATOM_NONE 0 // always interned first, its text is "none"
+
+// one per compilation: stores each distinct identifier and type name once
+typedef struct interner
+{
+    char* text; // every interned string, NUL-terminated, back to back
+    size_t textlength;
+    size_t textcapacity;
+    unsigned int* offsets; // atom -> offset of its text
+    unsigned int* lengths; // atom -> length of its text
+    unsigned int* hashes; // atom -> precomputed hash of its text
+    size_t count;
+    size_t capacity;
+    atom* slots; // open-addressing index, hash -> atom + 1 (0 marks an empty slot)
+    size_t numslots; // always a power of 2
+} interner;
+
+bool initialize_interner(interner* in);
+void free_interner(interner* in);
+atom intern_string(interner* in, const char* s, size_t length); // returns the existing atom if s was seen before
+const char* atom_text(const interner* in, atom a); // NUL-terminated
+size_t atom_length(const interner* in, atom a);
+unsigned int atom_hash(const interner* in, atom a);
+unsigned int hash_text(const char* s, size_t length);
+
+#endif // INTERNER_H
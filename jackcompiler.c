@@ -1,6 +1,224 @@
 #include "jackcompiler.h"
+#include <stdlib.h>
+#include <string.h>
+#include "jacktokenizer.h"
 
-void dummy_function()
+// what the xmlwriter's flush function needs to hand a chunk to the request's sink
+typedef struct treesink
 {
-    // dummy for compilation
+    const jackrequest* request;
+    outputkind kind;
+} treesink;
+
+static bool flush_to_sink(const char* data, size_t length, void* context)
+{
+    const treesink* sink = context;
+    return sink->request->sink(sink->kind, data, length, sink->request->sinkcontext);
+}
+
+
+void initialize_jack_request(jackrequest* request, const char* name, const char* source, size_t length)
+{
+    request->name = name;
+    request->source = source;
+    request->length = length;
+    request->outputs = OUT_VM;
+    request->optimizations = 0;
+    request->sink = NULL;
+    request->sinkcontext = NULL;
+    request->trace = NULL;
+    request->stats = NULL;
+}
+
+void free_jack_result(jackresult* result)
+{
+    free(result->vm.data);
+    free(result->xml.data);
+    free(result->tree.data);
+    free(result->diagnostics.data);
+    memset(result, 0, sizeof(*result));
+}
+
+
+/*
+* For failures that happen before there is a token stream to report them
+* through.
+*/
+static void fail_before_lexing(const jackrequest* request, jackresult* result, const char* message)
+{
+    const char* name = (request->name != NULL) ? request->name : "";
+    size_t length = strlen(name) + strlen(message) + 4; // ": ", '\n' and NUL
+    result->diagnostics.data = malloc(length * sizeof(*(result->diagnostics.data)));
+    if (result->diagnostics.data != NULL)
+    {
+        result->diagnostics.length = (size_t)sprintf(result->diagnostics.data, "%s: %s\n", name, message);
+    }
+    result->errorcount = 1;
+}
+
+
+/*
+* Every pass starts by expecting a class, and the parsers stop at an assert
+* when there isn't one, so an empty or foreign buffer is turned away here
+* with an error rather than taking down the program embedding this.
+*/
+static bool starts_with_class(tokenstream* ts)
+{
+    if (ts->types[0] == T_EOF)
+    {
+        report_error(ts, "line %u: Unexpected end of file, expected 'class'", ts->linenums[0]);
+        return false;
+    }
+    if (ts->types[0] != T_KEYWORD || ts->keys[0] != K_CLASS)
+    {
+        report_error(ts, "line %u: Unexpected token '%.*s', expected 'class'", ts->linenums[0], (int)ts->lengths[0],
+            ts->text + ts->starts[0]);
+        return false;
+    }
+    return true;
+}
+
+
+/*
+* Runs the .xml or .tree pass. With a sink, the tree streams out through the
+* writer's fixed buffer; without one, the writer's buffer grows to hold all
+* of it and becomes output.
+*/
+static void write_parse_tree(tokenstream* ts, arena* filearena, const jackrequest* request, outputkind kind, jackoutput* output)
+{
+    filestats* stats = request->stats;
+    double start = (stats != NULL) ? stats_clock() : 0.0;
+    double writtenbefore = (stats != NULL) ? stats->seconds[PH_WRITE] : 0.0;
+
+    treesink sink;
+    sink.request = request;
+    sink.kind = kind;
+    xmlwriter xml;
+    initialize_xml_writer(&xml, (request->sink != NULL) ? flush_to_sink : NULL, &sink, (kind == OUT_XML) ? XF_TEXT : XF_BINARY, filearena);
+    xml.stats = stats;
+    tokenize(ts, filearena, &xml);
+
+    if (xml.failed)
+    {
+        report_error(ts, "Error: could not write %s output", (kind == OUT_XML) ? "XML" : "parse tree");
+    }
+    if (request->sink == NULL)
+    {
+        output->data = xml.data;
+        output->length = xml.length;
+        if (stats != NULL)
+        {
+            stats->byteswritten += xml.length;
+        }
+    }
+    if (stats != NULL)
+    {
+        double writetime = stats->seconds[PH_WRITE] - writtenbefore;
+        stats->seconds[PH_PARSE_TREE] += stats_clock() - start - writetime;
+    }
+}
+
+/*
+* Runs the .vm pass and hands the code over in one piece.
+*/
+static void write_vm_code(tokenstream* ts, arena* filearena, const jackrequest* request, jackoutput* output)
+{
+    filestats* stats = request->stats;
+    double start = (stats != NULL) ? stats_clock() : 0.0;
+    double resolvedbefore = (stats != NULL) ? stats->symbols.resolveseconds : 0.0;
+    double generatedbefore = (stats != NULL) ? stats->seconds[PH_OPTIMIZE] + stats->seconds[PH_CODEGEN] : 0.0;
+
+    vmbuffer vm;
+    initialize_vm_buffer(&vm);
+    compile(ts, filearena, &vm, request->optimizations, stats);
+    if (stats != NULL)
+    {
+        double resolvetime = stats->symbols.resolveseconds - resolvedbefore;
+        double generatetime = stats->seconds[PH_OPTIMIZE] + stats->seconds[PH_CODEGEN] - generatedbefore;
+        stats->seconds[PH_RESOLVE] += resolvetime;
+        stats->seconds[PH_PARSE] += stats_clock() - start - resolvetime - generatetime;
+        stats->byteswritten += vm.length;
+        start = stats_clock();
+    }
+
+    if (request->sink == NULL)
+    {
+        output->data = vm.data; // the caller owns it now
+        output->length = vm.length;
+        return;
+    }
+    if (!request->sink(OUT_VM, vm.data, vm.length, request->sinkcontext))
+    {
+        report_error(ts, "Error: could not write VM output");
+    }
+    free_vm_buffer(&vm);
+    end_stats_phase(stats, PH_WRITE, start);
+}
+
+
+/*
+* Lexes the source once, then runs each requested pass over the same token
+* stream, in the order .xml, .tree, .vm. Everything allocated along the way
+* is released before returning, apart from the buffers in result.
+*/
+bool compile_jack_buffer(const jackrequest* request, jackresult* result)
+{
+    memset(result, 0, sizeof(*result));
+    filestats* stats = request->stats;
+    double start = (stats != NULL) ? stats_clock() : 0.0;
+
+    jacksource source;
+    interner names;
+    open_jack_buffer(&source, request->source, request->length);
+    if (!initialize_interner(&names))
+    {
+        fail_before_lexing(request, result, "Error: could not allocate memory for names");
+        return false;
+    }
+
+    arena filearena; // everything the passes allocate, released in one go at the end
+    tokenstream ts;
+    initialize_arena(&filearena, FILE_ARENA_BLOCK_SIZE);
+    bool lexed = lex_token_stream(&ts, &source, &names);
+    end_stats_phase(stats, PH_LEX, start);
+    if (!lexed)
+    {
+        fail_before_lexing(request, result, "Error: could not tokenize source");
+    }
+    else
+    {
+        ts.name = request->name;
+        ts.messages = request->trace;
+        if (stats != NULL)
+        {
+            stats->sourcebytes += source.length;
+            stats->tokens += ts.count;
+        }
+
+        unsigned int outputs = starts_with_class(&ts) ? request->outputs : 0;
+
+        // the parse trees are for debugging purposes, they do not affect the actual VM compilation
+        if (outputs & OUT_XML)
+        {
+            write_parse_tree(&ts, &filearena, request, OUT_XML, &result->xml);
+        }
+        if (outputs & OUT_TREE)
+        {
+            write_parse_tree(&ts, &filearena, request, OUT_TREE, &result->tree);
+        }
+        if (outputs & OUT_VM)
+        {
+            write_vm_code(&ts, &filearena, request, &result->vm);
+        }
+
+        result->diagnostics.data = ts.diagnostics; // the caller owns these now too
+        result->diagnostics.length = ts.diagnosticslength;
+        result->errorcount = ts.errorcount;
+        ts.diagnostics = NULL;
+    }
+    free_token_stream(&ts);
+    free_interner(&names);
+    free_arena(&filearena);
+    close_jack_source(&source);
+    return result->errorcount == 0;
 }
@@ -1,6 +1,53 @@
 #ifndef JACKCOMPILER_H
 #define JACKCOMPILER_H
 
-void dummy_function();
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "options.h"
+#include "compilestats.h"
+
+// libjackc: compiles one Jack class held in memory. Nothing here opens
+// files or prints; sources come in as buffers, and the outputs and error
+// messages go back to the caller. Every call works on its own interner,
+// arenas and tables, so any number of threads can compile at once.
+
+// receives output as it is produced, in order; returns false if it couldn't
+// take it. The VM code arrives in one piece, the parse trees in chunks.
+typedef bool (*jacksink)(outputkind kind, const char* data, size_t length, void* context);
+
+// what to compile and what to produce
+typedef struct jackrequest
+{
+    const char* name; // starts each diagnostic, e.g. "Main.jack"; may be NULL
+    const char* source; // the class, not necessarily NUL-terminated
+    size_t length;
+    unsigned int outputs; // outputkind bits
+    unsigned int optimizations; // optimization bits, for the VM code
+    jacksink sink; // NULL to collect the outputs in jackresult instead
+    void* sinkcontext;
+    FILE* trace; // debug output such as symbol table dumps, NULL for none
+    filestats* stats; // NULL unless the phases should be timed and counted
+} jackrequest;
+
+// a malloc'd buffer the caller owns once compile_jack_buffer() returns
+typedef struct jackoutput
+{
+    char* data; // NULL if nothing was produced
+    size_t length;
+} jackoutput;
+
+typedef struct jackresult
+{
+    jackoutput vm; // these three only without a sink
+    jackoutput xml;
+    jackoutput tree;
+    jackoutput diagnostics; // one error per line, NUL-terminated
+    unsigned int errorcount;
+} jackresult;
+
+void initialize_jack_request(jackrequest* request, const char* name, const char* source, size_t length); // VM code only, into jackresult
+bool compile_jack_buffer(const jackrequest* request, jackresult* result); // false if there were any errors
+void free_jack_result(jackresult* result);
 
 #endif // JACKCOMPILER_H
@@ -0,0 +1,125 @@
+#include "jacksource.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define JACKSOURCE_HAS_MMAP 1
+#endif
+
+#define READ_CHUNK_SIZE 4096
+
+
+/*
+* Reads whatever is left in infile into a malloc'd buffer. Used for streams
+* that can't be mapped, e.g. stdin or a pipe.
+*/
+static bool read_jack_source(jacksource* src, FILE* infile)
+{
+    size_t capacity = READ_CHUNK_SIZE;
+    size_t length = 0;
+    char* buffer = malloc(capacity * sizeof(*buffer));
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for source buffer\n");
+        return false;
+    }
+
+    size_t numread = 0;
+    while ((numread = fread(buffer + length, 1, capacity - length, infile)) > 0)
+    {
+        length += numread;
+        if (length == capacity)
+        {
+            char* temp = realloc(buffer, (capacity *= 2) * sizeof(*buffer));
+            if (temp == NULL)
+            {
+                fprintf(stderr, "Error: could not reallocate memory for source buffer\n");
+                free(buffer);
+                return false;
+            }
+            buffer = temp;
+        }
+    }
+
+    src->data = buffer;
+    src->length = length;
+    src->is_mapped = false;
+    return true;
+}
+
+
+/*
+* Makes the full contents of infile available as one contiguous buffer.
+* Regular files are memory-mapped; anything else falls back to reading the
+* stream into memory. Returns false if neither works.
+*/
+bool open_jack_source(jacksource* src, FILE* infile)
+{
+    src->data = NULL;
+    src->length = 0;
+    src->position = 0;
+    src->is_mapped = false;
+    src->is_borrowed = false;
+
+#ifdef JACKSOURCE_HAS_MMAP
+    struct stat info;
+    int fd = fileno(infile);
+    if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0 && ftell(infile) == 0)
+    {
+        void* mapping = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED)
+        {
+            src->data = mapping;
+            src->length = (size_t)info.st_size;
+            src->is_mapped = true;
+            return true;
+        }
+    }
+#endif
+
+    return read_jack_source(src, infile);
+}
+
+
+/*
+* Lexes straight out of a buffer the caller already holds. The buffer must
+* outlive src and anything lexed from it.
+*/
+void open_jack_buffer(jacksource* src, const char* data, size_t length)
+{
+    src->data = data;
+    src->length = length;
+    src->position = 0;
+    src->is_mapped = false;
+    src->is_borrowed = true;
+}
+
+
+/*
+* Unmaps or frees the source buffer. Any tokens still pointing into it
+* become invalid.
+*/
+void close_jack_source(jacksource* src)
+{
+    if (src->is_borrowed)
+    {
+        // not ours to release
+    }
+#ifdef JACKSOURCE_HAS_MMAP
+    else if (src->is_mapped)
+    {
+        munmap((void*)src->data, src->length);
+    }
+#endif
+    else
+    {
+        free((void*)src->data);
+    }
+    src->data = NULL;
+    src->length = 0;
+    src->position = 0;
+    src->is_mapped = false;
+    src->is_borrowed = false;
+}
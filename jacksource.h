@@ -0,0 +1,23 @@
+#ifndef JACKSOURCE_H
+#define JACKSOURCE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// the entire contents of a .jack file, held in one contiguous buffer so the
+// lexer can index characters directly and tokens can point into it
+typedef struct jacksource
+{
+    const char* data;
+    size_t length;
+    size_t position; // index of the next unread character
+    bool is_mapped; // true if data is an mmap() view, false if it was read into a malloc'd buffer
+    bool is_borrowed; // true if data belongs to whoever called open_jack_buffer()
+} jacksource;
+
+bool open_jack_source(jacksource* src, FILE* infile); // maps or reads all of infile into src
+void open_jack_buffer(jacksource* src, const char* data, size_t length); // uses data in place, without copying
+void close_jack_source(jacksource* src);
+
+#endif // JACKSOURCE_H
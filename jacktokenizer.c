@@ -1,411 +1,643 @@
 #include <stdlib.h>
+#include <stdarg.h>
 #include <assert.h>
 #include <string.h>
 #include "jacktokenizer.h"
 #include "tokenizerengine.h"
 #include "compilationengine.h"
+#include "codegenerator.h"
+#include "constantfolder.h"
+#include "peephole.h"
+#include "charscan.h"
 
 /*
-* Reads characters from infile, skipping comment lines/blocks and spaces.
-* Finds tokens, identifies them, and prints them to outfile, wrapped in
-* XML tags. Most of the work is done here, calling other functions as
-* appropriate.
+* Walks the token stream and prints every token to xml, wrapped in XML tags
+* that show the parse tree (or, with XF_BINARY, as the compact tree format
+* described in xmlwriter.h). Most of the work is done by tokenize_class()
+* and the functions it calls.
 */
-void tokenize(FILE* infile, FILE* outfile)
+void tokenize(tokenstream* ts, arena* filearena, xmlwriter* xml)
 {
-    int linenum = 1;
+    token* t = arena_alloc(filearena, sizeof(*t));
+    symboltable* classtable = arena_alloc(filearena, sizeof(*classtable));
+    symboltable* subtable = arena_alloc(filearena, sizeof(*subtable));
 
-    token* t = malloc(sizeof(*t));
-    symboltable* classtable = malloc(sizeof(*classtable));
-    symboltable* subtable = malloc(sizeof(*subtable));
+    initialize_token(t, filearena);
+    initialize_symbol_table(classtable, ts->names);
+    initialize_symbol_table(subtable, ts->names);
 
-    if (t == NULL)
-    {
-        fprintf(stderr, "Error: could not allocate memory for token\n");
-    }
-    if (classtable == NULL)
-    {
-        fprintf(stderr, "Error: could not allocate memory for classtable\n");
-    }
-    if (subtable == NULL)
+    rewind_token_stream(ts);
+    get_next_token(t, ts);
+    tokenize_class(t, ts, xml, classtable, subtable); // should only be one class per .jack file, so we don't need a loop
+    flush_xml_writer(xml);
+
+    // cleanup, the token and tables themselves go when filearena does
+    free_symbol_table_nodes(classtable);
+    free_symbol_table_nodes(subtable);
+}
+
+/*
+* Similar to tokenize(), but instead of printing tokens with XML tags, this
+* function actually compiles the .jack code into VM commands: it parses the
+* class into a syntax tree in filearena, then walks the tree to generate the
+* code. Strings that only live as long as one subroutine's code come from a
+* scratch arena that the code generator resets. The VM code is collected in
+* vm for the caller to pass on all at once.
+*/
+void compile(tokenstream* ts, arena* filearena, vmbuffer* vm, unsigned int optimizations, filestats* stats)
+{
+    token* t = arena_alloc(filearena, sizeof(*t));
+    symboltable* classtable = arena_alloc(filearena, sizeof(*classtable));
+    symboltable* subtable = arena_alloc(filearena, sizeof(*subtable));
+    arena scratch;
+    symbolstats* symbols = (stats != NULL) ? &stats->symbols : NULL; // lookups are only counted for --stats
+
+    initialize_token(t, filearena);
+    initialize_symbol_table(classtable, ts->names);
+    initialize_symbol_table(subtable, ts->names);
+    subtable->parent = classtable; // names not found in the subroutine resolve to class scope
+    classtable->stats = symbols;
+    subtable->stats = symbols;
+    initialize_arena(&scratch, SCRATCH_ARENA_BLOCK_SIZE);
+
+    rewind_token_stream(ts);
+    get_next_token(t, ts);
+    classnode* tree = compile_class(t, ts, classtable, subtable, filearena); // should only be one class per .jack file, so we don't need a loop
+    if (tree != NULL)
     {
-        fprintf(stderr, "Error: could not allocate memory for subtable\n");
+        double start = (stats != NULL) ? stats_clock() : 0.0;
+        if (optimizations & OPT_FOLD)
+        {
+            unsigned long folded = fold_constants(tree);
+            if (stats != NULL)
+            {
+                stats->folded += folded;
+            }
+        }
+        start = end_stats_phase(stats, PH_OPTIMIZE, start);
+
+        peephole window;
+        if (optimizations & OPT_PEEPHOLE)
+        {
+            initialize_peephole(&window, (stats != NULL) ? &stats->peephole : NULL);
+            vm->peephole = &window;
+        }
+        generate_class(vm, tree, ts->names, &scratch, optimizations, stats);
+        if (vm->peephole != NULL)
+        {
+            flush_peephole(&window, vm);
+            vm->peephole = NULL;
+        }
+        end_stats_phase(stats, PH_CODEGEN, start);
     }
-    if (t != NULL && classtable != NULL && subtable != NULL)
+    if (stats != NULL)
     {
-        initialize_token(t);
-        initialize_symbol_table(classtable);
-        initialize_symbol_table(subtable);
-
-        get_next_token(t, infile, &linenum);
-        tokenize_class(t, infile, outfile, &linenum, classtable, subtable); // should only be one class per .jack file, so we don't need a loop
+        stats->vminstructions += vm->instructions;
     }
 
     // cleanup
-    free_token_fields(t);
-    free(t);
     free_symbol_table_nodes(classtable);
     free_symbol_table_nodes(subtable);
-    free(classtable);
-    free(subtable);
+    free_arena(&scratch);
 }
 
+
 /*
-* Similar to tokenize(), but instead of printing tokens with XML tags, this
-* function actually compiles the .jack code into VM commands.
+* Adds one line to the diagnostics for this file, prefixed with its name,
+* and counts it as an error.
 */
-void compile(FILE* infile, FILE* outfile)
+void report_error(tokenstream* ts, const char* format, ...)
 {
-    int linenum = 1;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    size_t namelength = (ts->name != NULL) ? strlen(ts->name) + 2 : 0; // +2 for ": "
+    size_t needed = ts->diagnosticslength + namelength + (size_t)((length > 0) ? length : 0) + 2; // +1 for '\n', +1 for NUL
+
+    if (needed > ts->diagnosticscapacity)
+    {
+        size_t newcapacity = (ts->diagnosticscapacity == 0) ? 256 : ts->diagnosticscapacity;
+        while (newcapacity < needed)
+        {
+            newcapacity *= 2;
+        }
+        char* temp = realloc(ts->diagnostics, newcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for diagnostics\n");
+            exit(1);
+        }
+        ts->diagnostics = temp;
+        ts->diagnosticscapacity = newcapacity;
+    }
 
-    token* t = malloc(sizeof(*t));
-    symboltable* classtable = malloc(sizeof(*classtable));
-    symboltable* subtable = malloc(sizeof(*subtable));
+    char* dest = ts->diagnostics + ts->diagnosticslength;
+    if (ts->name != NULL)
+    {
+        dest += sprintf(dest, "%s: ", ts->name);
+    }
+    if (length > 0)
+    {
+        va_start(args, format);
+        dest += vsprintf(dest, format, args);
+        va_end(args);
+    }
+    *dest++ = '\n';
+    *dest = '\0';
+    ts->diagnosticslength = (size_t)(dest - ts->diagnostics);
+    ts->errorcount++;
+}
 
-    if (t == NULL)
+/*
+* The parsers' loops run until a particular symbol turns up, which it never
+* does in a truncated class, so each also stops once this returns true.
+* Every pass reads the same stream, so the error is only reported once.
+*/
+bool reached_end_of_file(const token* t, tokenstream* ts)
+{
+    if (t->type != T_EOF)
     {
-        fprintf(stderr, "Error: could not allocate memory for token\n");
+        return false;
     }
-    if (classtable == NULL)
+    if (!ts->reportedend)
     {
-        fprintf(stderr, "Error: could not allocate memory for classtable\n");
+        report_error(ts, "line %u: Unexpected end of file", t->linenum);
+        ts->reportedend = true;
     }
-    if (subtable == NULL)
+    return true;
+}
+
+
+/*
+* Grows every array in the token stream to hold newcapacity tokens.
+*/
+static bool grow_token_stream(tokenstream* ts, size_t newcapacity)
+{
+    unsigned char* types = realloc(ts->types, newcapacity * sizeof(*types));
+    if (types != NULL)
     {
-        fprintf(stderr, "Error: could not allocate memory for subtable\n");
+        ts->types = types;
     }
-    if (t != NULL && classtable != NULL && subtable != NULL)
+    unsigned char* keys = realloc(ts->keys, newcapacity * sizeof(*keys));
+    if (keys != NULL)
     {
-        initialize_token(t);
-        initialize_symbol_table(classtable);
-        initialize_symbol_table(subtable);
-
-        get_next_token(t, infile, &linenum);
-        compile_class(t, infile, outfile, &linenum, classtable, subtable); // should only be one class per .jack file, so we don't need a loop
+        ts->keys = keys;
+    }
+    unsigned int* starts = realloc(ts->starts, newcapacity * sizeof(*starts));
+    if (starts != NULL)
+    {
+        ts->starts = starts;
+    }
+    unsigned int* lengths = realloc(ts->lengths, newcapacity * sizeof(*lengths));
+    if (lengths != NULL)
+    {
+        ts->lengths = lengths;
+    }
+    unsigned int* linenums = realloc(ts->linenums, newcapacity * sizeof(*linenums));
+    if (linenums != NULL)
+    {
+        ts->linenums = linenums;
+    }
+    atom* atoms = realloc(ts->atoms, newcapacity * sizeof(*atoms));
+    if (atoms != NULL)
+    {
+        ts->atoms = atoms;
     }
 
-    // cleanup
-    free_token_fields(t);
-    free(t);
-    free_symbol_table_nodes(classtable);
-    free_symbol_table_nodes(subtable);
-    free(classtable);
-    free(subtable);
+    if (types == NULL || keys == NULL || starts == NULL || lengths == NULL || linenums == NULL || atoms == NULL)
+    {
+        fprintf(stderr, "Error: could not reallocate memory for token stream\n");
+        return false;
+    }
+    ts->capacity = newcapacity;
+    return true;
 }
 
 
 /*
-* Fill the token fields with default values, allocates memory for name and symboldata,
-* and initializes the symboldata node.
+* Lexes the entire source buffer into the token stream, ending with a single
+* T_EOF token. Keywords and identifiers are interned into names. The stream
+* keeps offsets into src->data, so src must stay open for as long as the
+* stream is used.
+*/
+bool lex_token_stream(tokenstream* ts, jacksource* src, interner* names)
+{
+    ts->text = src->data;
+    ts->names = names;
+    ts->types = NULL;
+    ts->keys = NULL;
+    ts->starts = NULL;
+    ts->lengths = NULL;
+    ts->linenums = NULL;
+    ts->atoms = NULL;
+    ts->count = 0;
+    ts->capacity = 0;
+    ts->position = 0;
+    ts->name = NULL;
+    ts->messages = NULL;
+    ts->diagnostics = NULL;
+    ts->diagnosticslength = 0;
+    ts->diagnosticscapacity = 0;
+    ts->errorcount = 0;
+    ts->reportedend = false;
+
+    // a rough guess of one token per 4 bytes of source avoids most regrowth
+    if (!grow_token_stream(ts, (src->length / 4) + 16))
+    {
+        return false;
+    }
+
+    int linenum = 1;
+    token t;
+    t.type = T_DEFAULT;
+    while (t.type != T_EOF)
+    {
+        lex_next_token(&t, src, &linenum);
+
+        if (ts->count == ts->capacity && !grow_token_stream(ts, ts->capacity * 2))
+        {
+            return false;
+        }
+        ts->types[ts->count] = (unsigned char)t.type;
+        ts->keys[ts->count] = (unsigned char)t.key;
+        ts->starts[ts->count] = (t.type == T_EOF) ? (unsigned int)src->length : (unsigned int)(t.start - src->data);
+        ts->lengths[ts->count] = (unsigned int)t.length;
+        ts->linenums[ts->count] = t.linenum;
+        ts->atoms[ts->count] = (t.type == T_KEYWORD || t.type == T_IDENTIFIER) ? intern_string(names, t.start, t.length) : ATOM_NONE;
+        ts->count++;
+    }
+    return true;
+}
+
+/*
+* Moves the stream back to its first token so another pass can read it.
 */
-void initialize_token(token* t)
+void rewind_token_stream(tokenstream* ts)
 {
-    t->name = malloc(MAX_TOKEN_LENGTH * sizeof(*(t->name)));
+    ts->position = 0;
+}
+
+void free_token_stream(tokenstream* ts)
+{
+    free(ts->types);
+    free(ts->keys);
+    free(ts->starts);
+    free(ts->lengths);
+    free(ts->linenums);
+    free(ts->atoms);
+    free(ts->diagnostics);
+    ts->types = NULL;
+    ts->keys = NULL;
+    ts->starts = NULL;
+    ts->lengths = NULL;
+    ts->linenums = NULL;
+    ts->atoms = NULL;
+    ts->diagnostics = NULL;
+    ts->diagnosticslength = 0;
+    ts->diagnosticscapacity = 0;
+    ts->count = 0;
+    ts->capacity = 0;
+    ts->position = 0;
+}
 
-    if (t->name == NULL)
+/*
+* Loads the next token from the stream into t. Once the end is reached, every
+* further call keeps returning the T_EOF token.
+*/
+void get_next_token(token* t, tokenstream* ts)
+{
+    size_t i = ts->position;
+    if (i + 1 < ts->count)
     {
-        fprintf(stderr, "Error: could not allocate memory for t->name\n");
-        exit(1);
+        ts->position++;
     }
 
-    t->type = T_DEFAULT;
-    t->key = K_NA;
-    t->symboldata = malloc(sizeof(*(t->symboldata)));
+    t->start = ts->text + ts->starts[i];
+    t->length = ts->lengths[i];
+    t->type = (tokentype)ts->types[i];
+    t->key = (keyword)ts->keys[i];
+    t->nameatom = ts->atoms[i];
+    t->linenum = ts->linenums[i];
+}
 
-    if (t->symboldata == NULL)
+/*
+* Returns the first character of the token that follows the current one,
+* without consuming anything. Returns EOF if there is no such token.
+*/
+int peek_at_next_token_start(const tokenstream* ts)
+{
+    size_t i = ts->position;
+    if (ts->types[i] == T_EOF)
     {
-        fprintf(stderr, "Error: could not allocate memory for t->symboldata\n");
-        exit(1);
+        return EOF;
     }
+    return (unsigned char)ts->text[ts->starts[i]];
+}
+
+
+/*
+* Fill the token fields with default values, takes memory for symboldata from
+* the arena, and initializes the symboldata node. The token text itself is
+* never copied; start/length point into the source buffer.
+*/
+void initialize_token(token* t, arena* a)
+{
+    t->start = "";
+    t->length = 0;
+    t->type = T_DEFAULT;
+    t->key = K_NA;
+    t->nameatom = ATOM_NONE;
+    t->linenum = 0;
+    t->symboldata = arena_alloc(a, sizeof(*(t->symboldata)));
 
     initialize_blank_node(t->symboldata);
 }
 
-void free_token_fields(token* t)
+
+// character classes for the lexer; each is a single bit so CC_ENDS_WORD can
+// test for several classes with one lookup
+enum
 {
-    free(t->name);
-    free(t->symboldata);
-}
+    CC_OTHER = 0, // letters outside the Jack set, punctuation Jack doesn't use, etc.
+    CC_SPACE = 1,
+    CC_SYMBOL = 2,
+    CC_DIGIT = 4,
+    CC_LETTER = 8, // a-z, A-Z and '_'
+    CC_QUOTE = 16,
+    CC_ENDS_WORD = CC_SPACE | CC_SYMBOL
+};
+
+static const unsigned char charclass[256] =
+{
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['{'] = CC_SYMBOL, ['}'] = CC_SYMBOL, ['('] = CC_SYMBOL, [')'] = CC_SYMBOL, ['['] = CC_SYMBOL,
+    [']'] = CC_SYMBOL, ['.'] = CC_SYMBOL, [','] = CC_SYMBOL, [';'] = CC_SYMBOL, ['+'] = CC_SYMBOL,
+    ['-'] = CC_SYMBOL, ['*'] = CC_SYMBOL, ['/'] = CC_SYMBOL, ['&'] = CC_SYMBOL, ['|'] = CC_SYMBOL,
+    ['<'] = CC_SYMBOL, ['>'] = CC_SYMBOL, ['='] = CC_SYMBOL, ['~'] = CC_SYMBOL,
+    ['0'] = CC_DIGIT, ['1'] = CC_DIGIT, ['2'] = CC_DIGIT, ['3'] = CC_DIGIT, ['4'] = CC_DIGIT,
+    ['5'] = CC_DIGIT, ['6'] = CC_DIGIT, ['7'] = CC_DIGIT, ['8'] = CC_DIGIT, ['9'] = CC_DIGIT,
+    ['a'] = CC_LETTER, ['b'] = CC_LETTER, ['c'] = CC_LETTER, ['d'] = CC_LETTER, ['e'] = CC_LETTER,
+    ['f'] = CC_LETTER, ['g'] = CC_LETTER, ['h'] = CC_LETTER, ['i'] = CC_LETTER, ['j'] = CC_LETTER,
+    ['k'] = CC_LETTER, ['l'] = CC_LETTER, ['m'] = CC_LETTER, ['n'] = CC_LETTER, ['o'] = CC_LETTER,
+    ['p'] = CC_LETTER, ['q'] = CC_LETTER, ['r'] = CC_LETTER, ['s'] = CC_LETTER, ['t'] = CC_LETTER,
+    ['u'] = CC_LETTER, ['v'] = CC_LETTER, ['w'] = CC_LETTER, ['x'] = CC_LETTER, ['y'] = CC_LETTER,
+    ['z'] = CC_LETTER,
+    ['A'] = CC_LETTER, ['B'] = CC_LETTER, ['C'] = CC_LETTER, ['D'] = CC_LETTER, ['E'] = CC_LETTER,
+    ['F'] = CC_LETTER, ['G'] = CC_LETTER, ['H'] = CC_LETTER, ['I'] = CC_LETTER, ['J'] = CC_LETTER,
+    ['K'] = CC_LETTER, ['L'] = CC_LETTER, ['M'] = CC_LETTER, ['N'] = CC_LETTER, ['O'] = CC_LETTER,
+    ['P'] = CC_LETTER, ['Q'] = CC_LETTER, ['R'] = CC_LETTER, ['S'] = CC_LETTER, ['T'] = CC_LETTER,
+    ['U'] = CC_LETTER, ['V'] = CC_LETTER, ['W'] = CC_LETTER, ['X'] = CC_LETTER, ['Y'] = CC_LETTER,
+    ['Z'] = CC_LETTER, ['_'] = CC_LETTER,
+    ['"'] = CC_QUOTE
+};
+
+#define CHAR_CLASS(c) (charclass[(unsigned char)(c)])
+
 
 /*
-* Reads characters from infile, skipping comment lines/blocks and spaces,
-* until it finds and returns a valid token character.
+* Advances through the source buffer, skipping comment lines/blocks and spaces,
+* until it finds and returns a valid token character. The returned character is
+* left unconsumed. Returns EOF at the end of the buffer.
 * Increments linenum upon encountering a newline.
 */
-char find_next_token_start(FILE* infile, int* linenum)
+int find_next_token_start(jacksource* src, int* linenum)
 {
-    char c = fgetc(infile);
-    char c2 = '\0';
+    const char* data = src->data;
+    const size_t length = src->length;
 
-    while (!feof(infile) && (c == ' ' || c == '\t' || c == '/' || c == '\n'))
+    while (src->position < length)
     {
-        if (c == '/')
+        char c = data[src->position];
+        if (CHAR_CLASS(c) == CC_SPACE)
         {
-            // check to see if it's the start of a comment
-            c2 = fgetc(infile);
-            if (c2 == '/')
-            {
-                skip_comment_line(infile);
-                (*linenum)++;
-            }
-            else if (c2 == '*')
-            {
-                int skippedlines = skip_comment_block(infile);
-                (*linenum) += skippedlines;
-            }
-            else
-            {
-                ungetc(c2, infile); // put c2 back into the input stream, since this isn't a comment after all
-                break;
-            }
+            src->position = skip_whitespace_run(data, src->position, length, linenum);
         }
-        else if (c == '\n')
+        else if (c == '/' && src->position + 1 < length && data[src->position + 1] == '/')
         {
+            src->position += 2;
+            skip_comment_line(src);
             (*linenum)++;
         }
-        c = fgetc(infile);
-    }
-    return c;
-}
-
-/*
-* Returns the next valid token character from infile, but puts the character
-* back into the input stream after reading so the file position is either not
-* advanced, or is only advanced until just before the next valid token.
-* Unlike get_next_token_start(), this function does not check for comments
-* mid-line. It should only be called in the middle of compiling an expression
-* and assumes the expression (and the next token) is valid.
-*/
-char peek_at_next_token_start(FILE* infile, int* const linenum)
-{
-    char c = fgetc(infile);
-    while (!feof(infile) && (c == ' ' || c == '\t' || c == '\n'))
-    {
-        if (c == '\n')
+        else if (c == '/' && src->position + 1 < length && data[src->position + 1] == '*')
         {
-            (*linenum)++;
+            src->position += 2;
+            (*linenum) += skip_comment_block(src);
+        }
+        else
+        {
+            return (unsigned char)c;
         }
-        c = fgetc(infile);
     }
-    ungetc(c, infile);
-    return c;
+    return EOF;
 }
 
 /*
-* Reads a string of characters from infile that represent a .jack code token, delineated
-* by whitespace or special characters, and copies it into token.
+* Finds the next .jack code token in the source buffer, delineated by whitespace
+* or special characters, and points the token at it. Nothing is copied.
+* The character class of the first character picks the token type; each type
+* then consumes characters until its class test fails.
 */
-void get_next_token(token* t, FILE* infile, int* linenum)
+void lex_next_token(token* t, jacksource* src, int* linenum)
 {
-    char c = find_next_token_start(infile, linenum);
-    assert(c != ' '); // DEBUG
+    int c = find_next_token_start(src, linenum);
+
+    const char* data = src->data;
+    const size_t length = src->length;
+    size_t position = src->position;
+    t->linenum = (unsigned int)(*linenum);
+    t->start = data + position;
+    t->key = K_NA;
 
     if (c == EOF)
     {
-        t->name[0] = '\0';
+        t->start = "";
+        t->length = 0;
         t->type = T_EOF;
+        return;
     }
-    else
-    {
-        if (c == '{' || c == '}' || c == '(' || c == ')' || c == '[' || c == ']' || c == '.' || c == ','
-        || c == ';' || c == '+' || c == '-' || c == '*' || c == '/' || c == '&' || c == '|' || c == '<'
-        || c == '>' || c == '=' || c == '~')
-        {
-            t->name[0] = c;
-            t->name[1] = '\0';
-            set_token_type(t);
-            set_token_key(t);
-        }
-        else if (c == '"') // start of a string constant, copy until next ", include double quotes but not newlines
-        {
-            t->name[0] = '"';
-            size_t maxlength = MAX_TOKEN_LENGTH;
-            size_t i = 1;
-            c = fgetc(infile);
 
-            while (!feof(infile) && c != '"')
+    switch (CHAR_CLASS(c))
+    {
+        case CC_SYMBOL:
+            position++;
+            t->type = T_SYMBOL;
+            break;
+
+        case CC_QUOTE: // start of a string constant, include double quotes in the view
+            position++;
+            while (position < length && data[position] != '"')
             {
-                if (c == '\n')
+                if (data[position] == '\n')
                 {
                     (*linenum)++;
                 }
-                else
-                {
-                    // every time we reach (last index - 1) of token, double the allocated number of chars
-                    // make sure we always leave room for the closing " and NUL
-                    if (i == (maxlength - 2))
+                position++;
+            }
+            if (position < length)
+            {
+                position++; // closing "
+            }
+            t->type = T_STRING_CONST;
+            break;
+
+        case CC_DIGIT:
+            while (position < length && CHAR_CLASS(data[position]) == CC_DIGIT)
+            {
+                position++;
+            }
+            t->type = T_INT_CONST;
+            break;
+
+        default:
+            // read until whitespace, newline, or special character
+            while (position < length && (CHAR_CLASS(data[position]) & CC_ENDS_WORD) == 0)
+            {
+                position++;
+            }
+            t->type = classify_word(t->start, position - src->position, &t->key);
+            break;
+    }
+
+    t->length = position - src->position;
+    src->position = position;
+}
+
+
+/*
+* Returns true if the length chars at word match the keyword text s.
+*/
+static bool word_is(const char* word, const char* s, size_t length)
+{
+    return memcmp(word, s, length) == 0;
+}
+
+/*
+* Classifies an identifier-shaped word as either a keyword or an identifier,
+* returning the tokentype and storing the keyword in key in one step. Every
+* keyword has a unique (length, first char) pair except true/this and
+* field/false, so the switch needs at most one memcmp to confirm a match.
+*/
+tokentype classify_word(const char* word, size_t length, keyword* key)
+{
+    keyword candidate = K_NA;
+    const char* text = NULL;
+
+    switch (length)
+    {
+        case 2:
+            switch (word[0])
+            {
+                case 'd': candidate = K_DO; text = "do"; break;
+                case 'i': candidate = K_IF; text = "if"; break;
+            }
+            break;
+        case 3:
+            switch (word[0])
+            {
+                case 'v': candidate = K_VAR; text = "var"; break;
+                case 'i': candidate = K_INT; text = "int"; break;
+                case 'l': candidate = K_LET; text = "let"; break;
+            }
+            break;
+        case 4:
+            switch (word[0])
+            {
+                case 'c': candidate = K_CHAR; text = "char"; break;
+                case 'v': candidate = K_VOID; text = "void"; break;
+                case 'n': candidate = K_NULL; text = "null"; break;
+                case 'e': candidate = K_ELSE; text = "else"; break;
+                case 't':
+                    if (word[1] == 'r')
                     {
-                        t->name = realloc(t->name, (maxlength *= 2) * sizeof(*(t->name)));
-                        if (t->name == NULL)
-                        {
-                            fprintf(stderr, "Error: could not reallocate memory for token\n");
-                            exit(1);
-                        }
+                        candidate = K_TRUE; text = "true";
                     }
-                    t->name[i] = c;
-                    i++;
-                }
-                c = fgetc(infile);
+                    else
+                    {
+                        candidate = K_THIS; text = "this";
+                    }
+                    break;
             }
-            t->name[i] = '"';
-            t->name[i+1] = '\0';
-        }
-        else if (c >= '0' && c <= '9')
-        {
-            int i = 0;
-            while (!feof(infile) && (c >= '0' && c <= '9'))
+            break;
+        case 5:
+            switch (word[0])
             {
-                t->name[i] = c;
-                i++;
-                c = fgetc(infile);
+                case 'c': candidate = K_CLASS; text = "class"; break;
+                case 'w': candidate = K_WHILE; text = "while"; break;
+                case 'f':
+                    if (word[1] == 'i')
+                    {
+                        candidate = K_FIELD; text = "field";
+                    }
+                    else
+                    {
+                        candidate = K_FALSE; text = "false";
+                    }
+                    break;
             }
-            ungetc(c, infile); // last char read wasn't a digit, so put it back in the input stream in case it's part of the next token
-            t->name[i] = '\0';
-        }
-        else
-        {
-            // copy until whitespace, newline, or special character
-            int i = 0;
-            while (!feof(infile))
+            break;
+        case 6:
+            switch (word[0])
             {
-                if (c == ' ' || c == '\n' ||c == '{' || c == '}' || c == '(' || c == ')' || c == '[' || c == ']'
-                    || c == '.' || c == ',' || c == ';' || c == '+' || c == '-' || c == '*' || c == '/' || c == '&'
-                    || c == '|' || c == '<' || c == '>' || c == '=' || c == '~')
-                {
-                    break;
-                }
-                else
-                {
-                    t->name[i] = c;
-                    i++;
-                    c = fgetc(infile);
-                }
+                case 'm': candidate = K_METHOD; text = "method"; break;
+                case 's': candidate = K_STATIC; text = "static"; break;
+                case 'r': candidate = K_RETURN; text = "return"; break;
             }
-            ungetc(c, infile); // last char read wasn't part of this token, so put it back in the input stream
-            t->name[i] = '\0';
-        }
-    set_token_type(t);
-    set_token_key(t);
+            break;
+        case 7:
+            candidate = K_BOOLEAN; text = "boolean";
+            break;
+        case 8:
+            candidate = K_FUNCTION; text = "function";
+            break;
+        case 11:
+            candidate = K_CONSTRUCTOR; text = "constructor";
+            break;
+    }
+
+    if (text != NULL && word_is(word, text, length))
+    {
+        *key = candidate;
+        return T_KEYWORD;
     }
+    *key = K_NA; // default for non-keyword tokens
+    return T_IDENTIFIER; // assume token is valid and all other tokens must be identifiers
 }
 
 
-
 /*
-* Sets the type field of the token based on the token's name field.
+* Sets the type and key fields of the token based on the token's text.
 */
 void set_token_type(token* const t)
 {
-    if (t->name[0] >= '0' && t->name[0] <= '9')
+    if (t->start[0] >= '0' && t->start[0] <= '9')
     {
         t->type = T_INT_CONST;
+        t->key = K_NA;
     }
-    else if (t->name[0] == '"')
+    else if (t->start[0] == '"')
     {
         t->type = T_STRING_CONST;
+        t->key = K_NA;
     }
-    else if (t->name[0] == '{' || t->name[0] == '}' || t->name[0] == '(' || t->name[0] == ')' || t->name[0] == '[' || t->name[0] == ']'
-             || t->name[0] == '.' || t->name[0] == ',' || t->name[0] == ';' || t->name[0] == '+' || t->name[0] == '-' || t->name[0] == '*'
-             || t->name[0] == '/' || t->name[0] == '&' || t->name[0] == '|' || t->name[0] == '<' || t->name[0] == '>' || t->name[0] == '='
-             || t->name[0] == '~')
+    else if (CHAR_CLASS(t->start[0]) == CC_SYMBOL)
     {
         t->type = T_SYMBOL;
+        t->key = K_NA;
     }
-    else if (strcmp(t->name, "class") == 0 || strcmp(t->name, "constructor") == 0 || strcmp(t->name, "function") == 0 || strcmp(t->name, "method") == 0
-        || strcmp(t->name, "field") == 0 || strcmp(t->name, "static") == 0 || strcmp(t->name, "var") == 0 || strcmp(t->name, "int") == 0
-        || strcmp(t->name, "char") == 0 || strcmp(t->name, "boolean") == 0 || strcmp(t->name, "void") == 0 || strcmp(t->name, "true") == 0
-        || strcmp(t->name, "false") == 0 || strcmp(t->name, "null") == 0 || strcmp(t->name, "this") == 0 || strcmp(t->name, "let") == 0
-        || strcmp(t->name, "do") == 0 || strcmp(t->name, "if") == 0 || strcmp(t->name, "else") == 0 || strcmp(t->name, "while") == 0
-        || strcmp(t->name, "return") == 0)
-    {
-        t->type = T_KEYWORD;
-    }
-    else // assume token is valid and all other tokens must be identifiers
+    else
     {
-        t->type = T_IDENTIFIER;
+        t->type = classify_word(t->start, t->length, &t->key);
     }
 }
 
 /*
-* Sets the key field of the token, based on the token's name.
-*/
-void set_token_key(token* t)
-{
-    if (strcmp(t->name, "class") == 0) {
-        t->key = K_CLASS;
-    }
-    else if (strcmp(t->name, "constructor") == 0) {
-        t->key = K_CONSTRUCTOR;
-    }
-    else if (strcmp(t->name, "function") == 0) {
-        t->key = K_FUNCTION;
-    }
-    else if (strcmp(t->name, "method") == 0) {
-        t->key = K_METHOD;
-    }
-    else if (strcmp(t->name, "field") == 0) {
-        t->key = K_FIELD;
-    }
-    else if (strcmp(t->name, "static") == 0) {
-        t->key = K_STATIC;
-    }
-    else if (strcmp(t->name, "var") == 0) {
-        t->key = K_VAR;
-    }
-    else if (strcmp(t->name, "int") == 0) {
-        t->key = K_INT;
-    }
-    else if (strcmp(t->name, "char") == 0) {
-        t->key = K_CHAR;
-    }
-    else if (strcmp(t->name, "boolean") == 0) {
-        t->key = K_BOOLEAN;
-    }
-    else if (strcmp(t->name, "void") == 0) {
-        t->key = K_VOID;
-    }
-    else if (strcmp(t->name, "true") == 0) {
-        t->key = K_TRUE;
-    }
-    else if (strcmp(t->name, "false") == 0) {
-        t->key = K_FALSE;
-    }
-    else if (strcmp(t->name, "null") == 0) {
-        t->key = K_NULL;
-    }
-    else if (strcmp(t->name, "this") == 0) {
-        t->key = K_THIS;
-    }
-    else if (strcmp(t->name, "let") == 0) {
-        t->key = K_LET;
-    }
-    else if (strcmp(t->name, "do") == 0) {
-        t->key = K_DO;
-    }
-    else if (strcmp(t->name, "if") == 0) {
-        t->key = K_IF;
-    }
-    else if (strcmp(t->name, "else") == 0) {
-        t->key = K_ELSE;
-    }
-    else if (strcmp(t->name, "while") == 0) {
-        t->key = K_WHILE;
-    }
-    else if (strcmp(t->name, "return") == 0) {
-        t->key = K_RETURN;
-    }
-    else {
-        t->key = K_NA; // default for non-keyword tokens
-    }
-}
-
-/*
-* For one-character token, returns the single character instead of the char* string.
+* For one-character token, returns the single character instead of the token text.
 */
 char get_symbol(const token* t)
 {
     assert (t->type == T_SYMBOL); // DEBUG, but shouldn't cause problems if called on other types
-    return t->name[0];
+    return t->start[0];
 }
 
 
@@ -416,70 +648,49 @@ char get_symbol(const token* t)
 int get_intval(const token* t)
 {
     assert(t->type == T_INT_CONST); // DEBUG
-    return atoi(t->name);
+    int value = 0;
+    for (size_t i = 0; i < t->length; i++)
+    {
+        value = (value * 10) + (t->start[i] - '0');
+    }
+    return value;
 }
 
 /*
-* Copies the string contents of t->name into destination, ignoring double quotes.
+* Copies the string contents of the token into destination, ignoring double quotes
+* and newlines. Destination needs room for t->length + 1 chars.
 */
 void get_stringval(char* destination, const token* t)
 {
     size_t i = 0;
-    for (size_t j = 0; j < strlen(t->name); j++)
+    for (size_t j = 0; j < t->length; j++)
     {
-        if (t->name[j] != '"')
+        if (t->start[j] != '"' && t->start[j] != '\n')
         {
-            destination[i] = t->name[j];
+            destination[i] = t->start[j];
             i++;
         }
     }
     destination[i] = '\0';
 }
 
-
 /*
-* Reads from the file until the end of the line, ignoring whatever is read.
+* Advances to just past the end of the current line, ignoring whatever is read.
 */
-void skip_comment_line(FILE* infile)
+void skip_comment_line(jacksource* src)
 {
-    char c = '\0';
-    while (!feof(infile) && c != '\n')
-    {
-        c = fgetc(infile);
-    }
+    src->position = find_line_end(src->data, src->position, src->length);
 }
 
 
 /*
-* Reads from the file until the star-slash combination is encountered, ignoring
-* whatever is read. Returns the number of newlines encountered.
+* Advances until just past the star-slash combination, ignoring whatever is
+* read. Returns the number of newlines encountered.
 */
-int skip_comment_block(FILE* infile)
+int skip_comment_block(jacksource* src)
 {
     int skippedlines = 0;
-    char c = '\0';
-    char c2 = '\0';
-    while (!feof(infile))
-    {
-        c = fgetc(infile);
-        if (c == '\n')
-        {
-            skippedlines++;
-        }
-        if (c == '*' && !feof(infile))
-        {
-            // might be the end of the comment block, check next character
-            c2 = fgetc(infile);
-            if (c2 == '/')
-            {
-                break;
-            }
-            else
-            {
-                ungetc(c2, infile);
-            }
-        }
-    }
+    src->position = find_block_comment_end(src->data, src->position, src->length, &skippedlines);
     return skippedlines;
 }
 
@@ -487,75 +698,36 @@ int skip_comment_block(FILE* infile)
 /*
 * Determines the appropriate XML tags for the current token, then prints the token,
 * wrapped in tags and offset with spaces, e.g: <tag> token </tag>
+* The text goes straight from the source buffer into the writer's buffer.
 */
-void print_terminal_with_tags(const token* t, const symboltable* st, FILE* outfile, const int* const indent)
+void print_terminal_with_tags(const token* t, const symboltable* st, xmlwriter* xml, const int* const indent)
 {
-    char* tagtype = malloc(32 * sizeof(*tagtype));
-    char* namecopy = malloc((strlen(t->name) + 1 ) * sizeof(*namecopy)); // +1 for NUL
-    if (tagtype == NULL || namecopy == NULL)
+    xmltag tag = XT_DEFAULT;
+    switch (t->type)
     {
-        fprintf(stderr, "Error: could not allocate memory for either tagtype or namecopy\n");
-    }
-    else
+        case T_KEYWORD:
+            tag = XT_KEYWORD;
+            break;
+        case T_SYMBOL:
+            tag = XT_SYMBOL;
+            break;
+        case T_INT_CONST:
+            tag = XT_INTEGER_CONSTANT;
+            break;
+        case T_STRING_CONST:
+            tag = XT_STRING_CONSTANT;
+            break;
+        case T_IDENTIFIER:
+            tag = XT_IDENTIFIER;
+            break;
+        default:
+            break;
+    }
+    write_xml_terminal(xml, tag, t->start, t->length, *indent);
+
+    if (xml->format == XF_TEXT)
     {
-        strcpy(namecopy, t->name);
-
-        switch (t->type)
-        {
-            case T_KEYWORD:
-                strcpy(tagtype, "keyword");
-                break;
-            case T_SYMBOL:
-                strcpy(tagtype, "symbol");
-                char symbol = get_symbol(t);
-                if (symbol == '<' || symbol == '>' || symbol == '&')
-                {
-                    // need more space for converted symbols
-                    // "&amp;" is the longest, so make sure we have room for 5 chars + 1 NUL
-                    char* temp = realloc(namecopy, 6 * sizeof(*temp));
-                    if (temp == NULL)
-                    {
-                        fprintf(stderr, "Error: could not reallocate memory for namecopy\n");
-                        strcpy(namecopy, "0");
-                    }
-                    else
-                    {
-                        namecopy = temp;
-                        if (get_symbol(t) == '<')
-                        {
-                            strcpy(namecopy, "&lt;");
-                        }
-                        else if (get_symbol(t) == '>')
-                        {
-                            strcpy(namecopy, "&gt;");
-                        }
-                        else if (get_symbol(t) == '&')
-                        {
-                            strcpy(namecopy, "&amp;");
-                        }
-                    }
-                }
-                break;
-            case T_INT_CONST:
-                strcpy(tagtype, "integerConstant");
-                break;
-            case T_STRING_CONST:
-                strcpy(tagtype, "stringConstant");
-                get_stringval(namecopy, t);
-                break;
-            case T_IDENTIFIER:
-                strcpy(tagtype, "identifier");
-                break;
-            default:
-                strcpy(tagtype, "DEFAULT");
-        }
-
-        fprintf(outfile, "%*s<%s> %s </%s>\n", *indent, "", tagtype, namecopy, tagtype);
-
-        print_symboldata_for_identifiers(t, st, outfile, indent); // DEBUG
-
-        free(tagtype);
-        free(namecopy);
+        print_symboldata_for_identifiers(t, st, xml, indent); // DEBUG
     }
 }
 
@@ -564,44 +736,59 @@ void print_terminal_with_tags(const token* t, const symboltable* st, FILE* outfi
 * Prints symbol information for identifier tokens. Used for debugging, will
 * show what needs to be added to the symboltable.
 */
-void print_symboldata_for_identifiers(const token* t, const symboltable* st, FILE* outfile, const int* const indent)
+void print_symboldata_for_identifiers(const token* t, const symboltable* st, xmlwriter* xml, const int* const indent)
 {
     if (t->type == T_IDENTIFIER)
     {
-        strcpy(t->symboldata->name, t->name);
-
-        fprintf(outfile, "%*sNAME: %s, TYPE: %s, KIND: %s, ", (*indent) + INDENT_WIDTH, "", t->symboldata->name, t->symboldata->type,
-            convert_symbolkind_to_string(t->symboldata->kind));
+        t->symboldata->name = t->nameatom;
+        const char* kindtext = convert_symbolkind_to_string(t->symboldata->kind);
+
+        write_xml_indent(xml, (*indent) + INDENT_WIDTH);
+        write_xml_text(xml, "NAME: ", 6);
+        write_xml_text(xml, atom_text(st->names, t->symboldata->name), atom_length(st->names, t->symboldata->name));
+        write_xml_text(xml, ", TYPE: ", 8);
+        write_xml_text(xml, atom_text(st->names, t->symboldata->type), atom_length(st->names, t->symboldata->type));
+        write_xml_text(xml, ", KIND: ", 8);
+        write_xml_text(xml, kindtext, strlen(kindtext));
+        write_xml_text(xml, ", ", 2);
 
         if (t->symboldata->is_being_defined == true || t->symboldata->kind == SK_ARG)
         {
             if (t->symboldata->kind == SK_STATIC)
             {
-                fprintf(outfile, "STATICINDEX: %u\n", st->staticindex);
+                write_xml_text(xml, "STATICINDEX: ", 13);
+                write_xml_uint(xml, st->staticindex);
+                write_xml_text(xml, "\n", 1);
             }
             else if (t->symboldata->kind == SK_FIELD)
             {
-                fprintf(outfile, "FIELDINDEX: %u\n", st->fieldindex);
+                write_xml_text(xml, "FIELDINDEX: ", 12);
+                write_xml_uint(xml, st->fieldindex);
+                write_xml_text(xml, "\n", 1);
             }
             else if (t->symboldata->kind == SK_ARG)
             {
-                fprintf(outfile, "ARGINDEX: %u\n", st->argindex);
+                write_xml_text(xml, "ARGINDEX: ", 10);
+                write_xml_uint(xml, st->argindex);
+                write_xml_text(xml, "\n", 1);
             }
             else if (t->symboldata->kind == SK_VAR)
             {
-                fprintf(outfile, "VARINDEX: %u\n", st->varindex);
+                write_xml_text(xml, "VARINDEX: ", 10);
+                write_xml_uint(xml, st->varindex);
+                write_xml_text(xml, "\n", 1);
             }
         }
         else
         {
-            fprintf(outfile, "INDEX: NA\n");
+            write_xml_text(xml, "INDEX: NA\n", 10);
         }
     }
 }
 
 /*
-* Creates a new tablenode with the same attributes as t->symboldata, then
-* appends the node to symboltable and updates the indices accordingly.
+* Fills a tablenode with the same attributes as t->symboldata, then appends
+* a copy of it to symboltable and updates the indices accordingly.
 * NOTE: accepts all tokens, but only adds identifiers to symboltable if they
 * are being defined, or if they are being passed as arguments.
 */
@@ -609,44 +796,37 @@ void copy_symboldata_into_symbol_table(const token* t, symboltable* st)
 {
     if (t->type == T_IDENTIFIER && (t->symboldata->is_being_defined == true || t->symboldata->kind == SK_ARG))
     {
-        strcpy(t->symboldata->name, t->name);
+        t->symboldata->name = t->nameatom;
 
-        tablenode* newnode = malloc(sizeof(*newnode));
-        if (newnode == NULL)
-        {
-            fprintf(stderr, "Error: could not allocate memory for newnode\n");
-        }
-        else
-        {
-            initialize_blank_node(newnode);
+        tablenode newnode;
+        initialize_blank_node(&newnode);
 
-            strcpy(newnode->name, t->symboldata->name);
-            strcpy(newnode->type, t->symboldata->type);
-            newnode->kind = t->symboldata->kind;
-
-            switch (newnode->kind)
-            {
-                case SK_STATIC:
-                    newnode->index = st->staticindex;
-                    (st->staticindex)++;
-                    break;
-                case SK_FIELD:
-                    newnode->index = st->fieldindex;
-                    (st->fieldindex)++;
-                    break;
-                case SK_ARG:
-                    newnode->index = st->argindex;
-                    (st->argindex)++;
-                    break;
-                case SK_VAR:
-                    newnode->index = st->varindex;
-                    (st->varindex)++;
-                default:
-                    break;
-            }
+        newnode.name = t->symboldata->name;
+        newnode.type = t->symboldata->type;
+        newnode.kind = t->symboldata->kind;
 
-            append_node(st, newnode);
+        switch (newnode.kind)
+        {
+            case SK_STATIC:
+                newnode.index = st->staticindex;
+                (st->staticindex)++;
+                break;
+            case SK_FIELD:
+                newnode.index = st->fieldindex;
+                (st->fieldindex)++;
+                break;
+            case SK_ARG:
+                newnode.index = st->argindex;
+                (st->argindex)++;
+                break;
+            case SK_VAR:
+                newnode.index = st->varindex;
+                (st->varindex)++;
+            default:
+                break;
         }
+
+        append_node(st, &newnode);
     }
 }
 
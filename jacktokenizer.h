@@ -4,8 +4,12 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include "symboltable.h"
-
-#define MAX_TOKEN_LENGTH 32 // arbitrary assumption about max length of tokens to simplify malloc calls and reduce realloc
+#include "jacksource.h"
+#include "arena.h"
+#include "xmlwriter.h"
+#include "vmwriter.h"
+#include "compilestats.h"
+#include "options.h"
 
 typedef enum tokentype
 {
@@ -26,33 +30,67 @@ typedef enum keyword
 } keyword;
 
 
+// tokens are views into the jacksource buffer; start is NOT NUL-terminated
 typedef struct token
 {
-    char* name;
+    const char* start;
+    size_t length;
     tokentype type;
     keyword key;
+    atom nameatom; // interned text of keywords and identifiers, ATOM_NONE for other tokens
+    unsigned int linenum;
     tablenode* symboldata;
 } token;
 
+// every token in a file, lexed once up front and stored as parallel arrays
+// so both the XML and VM passes can walk it without touching the source again
+typedef struct tokenstream
+{
+    const char* text; // source buffer that the offsets point into
+    unsigned char* types; // tokentype
+    unsigned char* keys; // keyword
+    unsigned int* starts; // offset of the first char of each token in text
+    unsigned int* lengths;
+    unsigned int* linenums;
+    atom* atoms;
+    interner* names; // the per-compilation interner the atoms belong to
+    size_t count; // includes the trailing T_EOF token
+    size_t capacity;
+    size_t position; // index of the next token handed out by get_next_token()
+    const char* name; // of the source, to start each diagnostic with, or NULL
+    FILE* messages; // debug output such as symbol table dumps, NULL for none
+    char* diagnostics; // error messages so far, one per line, NUL-terminated; see report_error()
+    size_t diagnosticslength;
+    size_t diagnosticscapacity;
+    unsigned int errorcount; // lines in diagnostics
+    bool reportedend; // a pass ran into the end of the source looking for more of the class
+} tokenstream;
+
+
+void initialize_token(token* t, arena* a);
+void tokenize(tokenstream* ts, arena* filearena, xmlwriter* xml); // prints the parse tree as XML or binary
+void compile(tokenstream* ts, arena* filearena, vmbuffer* vm, unsigned int optimizations, filestats* stats); // compiles tokens into VM commands; stats may be NULL
+void report_error(tokenstream* ts, const char* format, ...); // adds a line to ts->diagnostics
+bool reached_end_of_file(const token* t, tokenstream* ts); // true at T_EOF, which is reported as an error once per stream
 
-void initialize_token(token* t);
-void tokenize(FILE* infile, FILE* outfile); // tokenizes and prints tokens with XML tags
-void compile(FILE* infile, FILE* outfile); // tokenizes and compiles into VM commands
+bool lex_token_stream(tokenstream* ts, jacksource* src, interner* names); // lexes all of src into ts
+void rewind_token_stream(tokenstream* ts);
+void free_token_stream(tokenstream* ts);
+void get_next_token(token* t, tokenstream* ts); // replaces advance() in book API
+int peek_at_next_token_start(const tokenstream* ts); // first char of the token after t, or EOF
 
-char find_next_token_start(FILE* infile, int* const linenum);
-char peek_at_next_token_start(FILE* infile, int* const linenum);
-void get_next_token(token* t, FILE* infile, int* const linenum); // replaces advance() in book API
-void set_token_type(token* t); // book API
-void set_token_key(token* t); // book API
+int find_next_token_start(jacksource* src, int* const linenum);
+void lex_next_token(token* t, jacksource* src, int* const linenum);
+void set_token_type(token* t); // book API, also sets the key field
+tokentype classify_word(const char* word, size_t length, keyword* key); // keyword vs identifier, sets key
 char get_symbol(const token* t); // book API
 int get_intval(const token* t); // book API
 void get_stringval(char* destination, const token* t); // book API
-int skip_comment_block(FILE* infile); // returns number of comment lines skipped
-void skip_comment_line(FILE* infile);
-void print_terminal_with_tags(const token* t, const symboltable* st, FILE* outfile, const int* const indent); // prints token wrapped in appropriate XML tags
-void print_symboldata_for_identifiers(const token* t, const symboltable* st, FILE* outfile, const int* const indent);
+int skip_comment_block(jacksource* src); // returns number of comment lines skipped
+void skip_comment_line(jacksource* src);
+void print_terminal_with_tags(const token* t, const symboltable* st, xmlwriter* xml, const int* const indent); // prints token wrapped in appropriate XML tags
+void print_symboldata_for_identifiers(const token* t, const symboltable* st, xmlwriter* xml, const int* const indent);
 void copy_symboldata_into_symbol_table(const token* t, symboltable* st);
-void free_token_fields(token* t);
 bool is_statement(const token* const t);
 bool is_binary_operator(const token* const t);
 bool is_unary_operator(const token* const t);
@@ -0,0 +1,557 @@
+#include "linker.h"
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "interner.h"
+#include "jacksource.h"
+#include "filehandling.h"
+
+#define INITIAL_LINKER_SIZE 64
+#define MAX_VM_WORDS 3 // "push static 3", "call Math.multiply 2"
+#define MAX_VM_INDEX 32767 // the largest constant a VM command can hold
+
+// one function of the program, found in one of the .vm files
+typedef struct vmfunction
+{
+    atom name;
+    size_t file; // index into the linker's files
+    size_t offset; // of its first command in the linker's text
+    size_t length; // of all its commands, each on its own line
+    unsigned long commands;
+    size_t firstcall; // the functions it calls are calls[firstcall] to calls[firstcall + numcalls - 1]
+    size_t numcalls;
+    bool reachable;
+} vmfunction;
+
+// one .vm file, and what of it made it into the program
+typedef struct vmclassfile
+{
+    char* name; // within the directory
+    unsigned int numstatics; // one past the highest static it uses
+    unsigned int firststatic; // where its statics start in the linked program
+    unsigned long functions;
+    unsigned long commands;
+    unsigned long keptfunctions;
+    unsigned long keptcommands;
+} vmclassfile;
+
+typedef struct linker
+{
+    interner names; // function names
+    vmclassfile* files; // sorted by name, so the output doesn't depend on directory order
+    size_t numfiles;
+    vmfunction* functions; // in file order, then source order
+    size_t numfunctions;
+    size_t functioncapacity;
+    atom* calls;
+    size_t numcalls;
+    size_t callcapacity;
+    char* text; // every command of every file, without comments or indentation, one per line
+    size_t textlength;
+    size_t textcapacity;
+    size_t* definitions; // atom -> index of the function it names + 1, 0 if it isn't defined
+} linker;
+
+
+/*
+* Grows *buffer to hold at least needed items of size bytes, doubling it.
+*/
+static void* grow_array(void* buffer, size_t* capacity, size_t needed, size_t size, const char* what)
+{
+    if (needed <= *capacity)
+    {
+        return buffer;
+    }
+    size_t newcapacity = (*capacity == 0) ? INITIAL_LINKER_SIZE : *capacity * 2;
+    while (newcapacity < needed)
+    {
+        newcapacity *= 2;
+    }
+    void* temp = realloc(buffer, newcapacity * size);
+    if (temp == NULL)
+    {
+        fprintf(stderr, "Error: could not reallocate memory for %s\n", what);
+        exit(1);
+    }
+    *capacity = newcapacity;
+    return temp;
+}
+
+/*
+* Returns a malloc'd "directory/name".
+*/
+static char* join_path(const char* const directoryname, const char* const name)
+{
+    size_t length = strlen(directoryname) + strlen(PATH_SEPARATOR) + strlen(name) + 1; // +1 for NUL
+    char* filename = malloc(length * sizeof(*filename));
+    if (filename == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for filename\n");
+        exit(1);
+    }
+    snprintf(filename, length, "%s%s%s", directoryname, PATH_SEPARATOR, name);
+    return filename;
+}
+
+static bool is_vm_file(const char* const filename)
+{
+    size_t length = strlen(filename);
+    return length > 3 && strcmp(filename + length - 3, ".vm") == 0;
+}
+
+static int compare_file_names(const void* a, const void* b)
+{
+    return strcmp(((const vmclassfile*)a)->name, ((const vmclassfile*)b)->name);
+}
+
+/*
+* Lists the .vm files of the directory, apart from output (which may be
+* one of them, left by the last link).
+*/
+static void list_vm_files(linker* l, DIR* directory, const char* const directoryname, const struct stat* output)
+{
+    size_t capacity = 0;
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (!is_vm_file(entry->d_name))
+        {
+            continue;
+        }
+        char* filename = join_path(directoryname, entry->d_name);
+        struct stat info;
+        if (output != NULL && stat(filename, &info) == 0 && info.st_dev == output->st_dev && info.st_ino == output->st_ino)
+        {
+            free(filename);
+            continue;
+        }
+        free(filename);
+
+        l->files = grow_array(l->files, &capacity, l->numfiles + 1, sizeof(*l->files), "file list");
+        vmclassfile* file = &l->files[l->numfiles++];
+        memset(file, 0, sizeof(*file));
+        file->name = malloc((strlen(entry->d_name) + 1) * sizeof(*file->name));
+        if (file->name == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate memory for filename\n");
+            exit(1);
+        }
+        strcpy(file->name, entry->d_name);
+    }
+    qsort(l->files, l->numfiles, sizeof(*l->files), compare_file_names);
+}
+
+
+/*
+* Splits line, without its comment, into up to MAX_VM_WORDS words. Returns
+* how many there were, which may be more than it kept.
+*/
+static int split_vm_line(const char* line, size_t length, const char** words, size_t* lengths)
+{
+    int count = 0;
+    size_t i = 0;
+    while (i < length)
+    {
+        while (i < length && (line[i] == ' ' || line[i] == '\t' || line[i] == '\r'))
+        {
+            i++;
+        }
+        if (i == length || (line[i] == '/' && i + 1 < length && line[i + 1] == '/'))
+        {
+            break;
+        }
+        size_t start = i;
+        while (i < length && line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+        {
+            i++;
+        }
+        if (count < MAX_VM_WORDS)
+        {
+            words[count] = line + start;
+            lengths[count] = i - start;
+        }
+        count++;
+    }
+    return count;
+}
+
+static bool word_is(const char* word, size_t length, const char* text)
+{
+    return length == strlen(text) && memcmp(word, text, length) == 0;
+}
+
+/*
+* Reads a segment index, which must be all digits. The word isn't
+* NUL-terminated, so only its length characters are looked at.
+*/
+static bool parse_vm_index(const char* word, size_t length, unsigned int* index)
+{
+    unsigned long value = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (word[i] < '0' || word[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (unsigned long)(word[i] - '0');
+        if (value > MAX_VM_INDEX)
+        {
+            return false;
+        }
+    }
+    *index = (unsigned int)value;
+    return length > 0;
+}
+
+/*
+* Reads the commands of one file into the linker, starting a new function
+* at each function command.
+*/
+static bool read_vm_file(linker* l, size_t fileindex, const char* data, size_t length)
+{
+    vmclassfile* file = &l->files[fileindex];
+    vmfunction* function = NULL;
+    size_t linenum = 0;
+    const char* end = data + length;
+    for (const char* line = data; line < end; )
+    {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        size_t linelength = (newline != NULL) ? (size_t)(newline - line) : (size_t)(end - line);
+        const char* words[MAX_VM_WORDS];
+        size_t lengths[MAX_VM_WORDS];
+        int count = split_vm_line(line, linelength, words, lengths);
+        linenum++;
+
+        if (count > MAX_VM_WORDS)
+        {
+            fprintf(stderr, "Error: %s line %zu: more than %d words, which no VM command has\n", file->name, linenum,
+                MAX_VM_WORDS);
+            return false;
+        }
+        if (count > 0)
+        {
+            if (word_is(words[0], lengths[0], "function") && count >= 2)
+            {
+                l->functions = grow_array(l->functions, &l->functioncapacity, l->numfunctions + 1, sizeof(*l->functions),
+                    "function list");
+                function = &l->functions[l->numfunctions++];
+                function->name = intern_string(&l->names, words[1], lengths[1]);
+                function->file = fileindex;
+                function->offset = l->textlength;
+                function->length = 0;
+                function->commands = 0;
+                function->firstcall = l->numcalls;
+                function->numcalls = 0;
+                function->reachable = false;
+                file->functions++;
+            }
+            else if (function == NULL)
+            {
+                fprintf(stderr, "Error: %s line %zu: command outside a function\n", file->name, linenum);
+                return false;
+            }
+            else if (word_is(words[0], lengths[0], "call") && count >= 2)
+            {
+                l->calls = grow_array(l->calls, &l->callcapacity, l->numcalls + 1, sizeof(*l->calls), "call list");
+                l->calls[l->numcalls++] = intern_string(&l->names, words[1], lengths[1]);
+                function->numcalls++;
+            }
+            else if ((word_is(words[0], lengths[0], "push") || word_is(words[0], lengths[0], "pop")) && count >= 3
+                && word_is(words[1], lengths[1], "static"))
+            {
+                unsigned int index;
+                if (!parse_vm_index(words[2], lengths[2], &index))
+                {
+                    fprintf(stderr, "Error: %s line %zu: '%.*s' is not a static index\n", file->name, linenum,
+                        (int)lengths[2], words[2]);
+                    return false;
+                }
+                if (index + 1 > file->numstatics)
+                {
+                    file->numstatics = index + 1;
+                }
+            }
+
+            // keep the command as its words, one space apart
+            size_t commandlength = (size_t)count; // the spaces, and a newline
+            for (int i = 0; i < count; i++)
+            {
+                commandlength += lengths[i];
+            }
+            l->text = grow_array(l->text, &l->textcapacity, l->textlength + commandlength, sizeof(*l->text), "VM text");
+            for (int i = 0; i < count; i++)
+            {
+                memcpy(l->text + l->textlength, words[i], lengths[i]);
+                l->textlength += lengths[i];
+                l->text[l->textlength++] = (i + 1 < count) ? ' ' : '\n';
+            }
+            function->length = l->textlength - function->offset;
+            function->commands++;
+            file->commands++;
+        }
+        line += linelength + 1;
+    }
+    return true;
+}
+
+
+/*
+* Marks every function reachable from the entry points. Returns false if
+* the directory defines none of them.
+*/
+static bool mark_reachable(linker* l)
+{
+    size_t* stack = malloc((l->numfunctions + 1) * sizeof(*stack));
+    if (stack == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for call graph\n");
+        exit(1);
+    }
+    size_t depth = 0;
+
+    const char* entrypoints[] = LINK_ENTRY_POINTS;
+    for (size_t i = 0; i < sizeof(entrypoints) / sizeof(entrypoints[0]); i++)
+    {
+        atom name = intern_string(&l->names, entrypoints[i], strlen(entrypoints[i]));
+        if (l->definitions[name] != 0 && !l->functions[l->definitions[name] - 1].reachable)
+        {
+            l->functions[l->definitions[name] - 1].reachable = true;
+            stack[depth++] = l->definitions[name] - 1;
+        }
+    }
+    bool found = depth > 0;
+
+    while (depth > 0)
+    {
+        vmfunction* function = &l->functions[stack[--depth]];
+        for (size_t i = 0; i < function->numcalls; i++)
+        {
+            size_t callee = l->definitions[l->calls[function->firstcall + i]];
+            if (callee != 0 && !l->functions[callee - 1].reachable)
+            {
+                l->functions[callee - 1].reachable = true;
+                stack[depth++] = callee - 1;
+            }
+        }
+    }
+    free(stack);
+    return found;
+}
+
+/*
+* Writes the commands of function, moving its statics up by firststatic.
+* Returns the number of bytes written.
+*/
+static size_t write_function_text(FILE* outfile, const linker* l, const vmfunction* function, unsigned int firststatic)
+{
+    size_t written = 0;
+    const char* end = l->text + function->offset + function->length;
+    for (const char* line = l->text + function->offset; line < end; )
+    {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        size_t length = (size_t)(newline - line) + 1;
+        const char* prefix = NULL;
+        if (strncmp(line, "push static ", 12) == 0)
+        {
+            prefix = "push static";
+        }
+        else if (strncmp(line, "pop static ", 11) == 0)
+        {
+            prefix = "pop static";
+        }
+
+        if (prefix != NULL)
+        {
+            unsigned long index = strtoul(line + strlen(prefix) + 1, NULL, 10); // checked to be digits, and every line ends in a newline
+            int count = fprintf(outfile, "%s %lu\n", prefix, index + firststatic);
+            written += (count > 0) ? (size_t)count : 0;
+        }
+        else
+        {
+            written += fwrite(line, 1, length, outfile);
+        }
+        line += length;
+    }
+    return written;
+}
+
+static void print_link_report(FILE* report, const linker* l, const char* const outputname, size_t byteswritten)
+{
+    unsigned long functions = 0;
+    unsigned long keptfunctions = 0;
+    unsigned long commands = 0;
+    unsigned long keptcommands = 0;
+    fprintf(report, "Linked %zu classes into %s:\n", l->numfiles, outputname);
+    for (size_t i = 0; i < l->numfiles; i++)
+    {
+        const vmclassfile* file = &l->files[i];
+        fprintf(report, "  %-20s %4lu of %4lu functions, %6lu of %6lu commands\n", file->name, file->keptfunctions,
+            file->functions, file->keptcommands, file->commands);
+        functions += file->functions;
+        keptfunctions += file->keptfunctions;
+        commands += file->commands;
+        keptcommands += file->keptcommands;
+    }
+    fprintf(report, "  %-20s %4lu of %4lu functions, %6lu of %6lu commands (%.1f%% smaller), %zu bytes\n", "total",
+        keptfunctions, functions, keptcommands, commands,
+        (commands > 0) ? 100.0 * (double)(commands - keptcommands) / (double)commands : 0.0, byteswritten);
+
+    bool* listed = calloc(l->names.count, sizeof(*listed));
+    if (listed == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for link report\n");
+        exit(1);
+    }
+    bool any = false;
+    for (size_t i = 0; i < l->numfunctions; i++)
+    {
+        const vmfunction* function = &l->functions[i];
+        for (size_t j = 0; function->reachable && j < function->numcalls; j++)
+        {
+            atom callee = l->calls[function->firstcall + j];
+            if (l->definitions[callee] == 0 && !listed[callee])
+            {
+                fprintf(report, "%s%s", any ? ", " : "  calls outside the directory: ", atom_text(&l->names, callee));
+                listed[callee] = true;
+                any = true;
+            }
+        }
+    }
+    if (any)
+    {
+        fprintf(report, "\n");
+    }
+    free(listed);
+}
+
+
+static void free_linker(linker* l)
+{
+    for (size_t i = 0; i < l->numfiles; i++)
+    {
+        free(l->files[i].name);
+    }
+    free(l->files);
+    free(l->functions);
+    free(l->calls);
+    free(l->text);
+    free(l->definitions);
+    free_interner(&l->names);
+}
+
+bool link_directory(const char* const directoryname, const char* const outputname, FILE* report)
+{
+    linker l;
+    memset(&l, 0, sizeof(l));
+    if (!initialize_interner(&l.names))
+    {
+        fprintf(stderr, "Error: could not allocate memory for function names\n");
+        exit(1);
+    }
+
+    DIR* directory = opendir(directoryname);
+    if (directory == NULL)
+    {
+        fprintf(stderr, "Error: could not open %s to link it\n", directoryname);
+        free_linker(&l);
+        return false;
+    }
+    struct stat output;
+    bool outputexists = stat(outputname, &output) == 0;
+    list_vm_files(&l, directory, directoryname, outputexists ? &output : NULL);
+    closedir(directory);
+
+    bool succeeded = true;
+    for (size_t i = 0; i < l.numfiles && succeeded; i++)
+    {
+        char* filename = join_path(directoryname, l.files[i].name);
+        FILE* infile = fopen(filename, "rb");
+        jacksource source;
+        if (infile == NULL || !open_jack_source(&source, infile))
+        {
+            fprintf(stderr, "Error: could not read %s\n", filename);
+            succeeded = false;
+        }
+        else
+        {
+            succeeded = read_vm_file(&l, i, source.data, source.length);
+            close_jack_source(&source);
+        }
+        if (infile != NULL)
+        {
+            fclose(infile);
+        }
+        free(filename);
+    }
+
+    // intern the entry points too, so every name the call graph looks up has a slot
+    const char* entrypoints[] = LINK_ENTRY_POINTS;
+    for (size_t i = 0; i < sizeof(entrypoints) / sizeof(entrypoints[0]); i++)
+    {
+        intern_string(&l.names, entrypoints[i], strlen(entrypoints[i]));
+    }
+    l.definitions = calloc(l.names.count, sizeof(*l.definitions));
+    if (l.definitions == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for function table\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < l.numfunctions && succeeded; i++)
+    {
+        atom name = l.functions[i].name;
+        if (l.definitions[name] != 0)
+        {
+            fprintf(stderr, "Error: %s is defined in both %s and %s\n", atom_text(&l.names, name),
+                l.files[l.functions[l.definitions[name] - 1].file].name, l.files[l.functions[i].file].name);
+            succeeded = false;
+        }
+        l.definitions[name] = i + 1;
+    }
+    if (succeeded && !mark_reachable(&l))
+    {
+        fprintf(stderr, "Error: %s defines neither Sys.init nor Main.main, so there is nothing to link\n", directoryname);
+        succeeded = false;
+    }
+
+    FILE* outfile = succeeded ? fopen(outputname, "w") : NULL;
+    if (succeeded && outfile == NULL)
+    {
+        fprintf(stderr, "Error: could not create %s\n", outputname);
+        succeeded = false;
+    }
+    if (succeeded)
+    {
+        unsigned int nextstatic = 0;
+        for (size_t i = 0; i < l.numfiles; i++)
+        {
+            l.files[i].firststatic = nextstatic;
+            nextstatic += l.files[i].numstatics;
+        }
+
+        size_t byteswritten = 0;
+        for (size_t i = 0; i < l.numfunctions; i++)
+        {
+            vmfunction* function = &l.functions[i];
+            if (function->reachable)
+            {
+                vmclassfile* file = &l.files[function->file];
+                byteswritten += write_function_text(outfile, &l, function, file->firststatic);
+                file->keptfunctions++;
+                file->keptcommands += function->commands;
+            }
+        }
+        if (fclose(outfile) != 0)
+        {
+            fprintf(stderr, "Error: could not write %s\n", outputname);
+            succeeded = false;
+        }
+        else if (report != NULL)
+        {
+            print_link_report(report, &l, outputname, byteswritten);
+        }
+    }
+
+    free_linker(&l);
+    return succeeded;
+}
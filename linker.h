@@ -0,0 +1,19 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Links a compiled directory into one program. Every .vm file in the
+// directory is read, calls are followed from the entry points, and only
+// the functions they can reach are written, all to one .vm file. The
+// book's VM translator numbers statics per file, so each class's statics
+// are moved past those of the classes written before it. Calls to
+// functions the directory doesn't define (the OS, when the VM emulator
+// provides it) are kept and listed in the report.
+
+#define LINK_ENTRY_POINTS { "Sys.init", "Main.main" } // Sys.init is what the VM's bootstrap code calls
+
+bool link_directory(const char* const directoryname, const char* const outputname, FILE* report); // false if nothing was written
+
+#endif // LINKER_H
@@ -5,7 +5,9 @@
 * This program parses .jack files and translates Jack code
 * into VM code. If a directory name is provided, it will
 * translate each .jack file in that directory into its own
-* .vm file (ignoring sub-directories).
+* .vm file (ignoring sub-directories). The XML parse tree
+* used for debugging is only written when asked for with
+* --emit xml (see options.c).
 *
 * NOTES:
 * 1) When the user provides a directory name, this program
@@ -18,7 +20,6 @@
 * multiple periods will cause errors.
 *
 * TODO:
-* 1) Replace "char c" with "int c" anytime fgetc() is being used, since fgetc() returns type int.
 * 2) Add compilation errors with filenames and linenums whenever an unexpected token is encountered.
 *       -Make a general check_expected_token() function?
 * 3) Break up functions in general.
@@ -27,26 +28,45 @@
 ******************************************************************************************************************/
 
 #include "filehandling.h"
+#include "watchmode.h"
+#include "linker.h"
 
 /*
 * Main function.
-* Attempts to open the provided filename as a directory and compile all
-* .jack files within. If that fails, attempts to compile it as a single file.
+* Reads the options, then attempts to open the provided name as a directory
+* and compile all .jack files within. If that fails, attempts to compile it
+* as a single file. With --watch, a directory is then recompiled file by
+* file as it changes, and with --link, the directory's .vm files are linked
+* into one program after each build.
 */
 int main(int argc, char** argv)
 {
-    if (argc != 2) // ensure correct usage
+    compileoptions options;
+    if (!parse_command_line(argc, argv, &options)) // ensure correct usage
     {
-        fprintf(stderr, "Usage: elements_11 [directory name or filename.jack]\n");
+        print_usage("elements_11");
         return 1;
     }
 
-    // the tokenizing functions create XML output for debugging purposes
-    // they do not affect the actual VM compilation
-    if (tokenize_directory(argv[1]) == false || compile_directory(argv[1]) == false)
+    // each file is lexed once; the token stream then produces whichever
+    // outputs were asked for, by default just the VM code
+    if (compile_directory(options.inputname, &options) == false)
     {
-        tokenize_single_file(argv[1]);
-        compile_single_file(argv[1]);
+        if (options.watch || options.linkfile != NULL)
+        {
+            fprintf(stderr, "Error: %s needs a directory\n", options.watch ? "--watch" : "--link");
+            return 1;
+        }
+        compile_single_file(options.inputname, &options);
+    }
+    else if (options.linkfile != NULL && !link_directory(options.inputname, options.linkfile,
+        (options.stats == SF_JSON && options.statsfile == NULL) ? stderr : stdout)) // keep JSON stats parseable
+    {
+        return 1;
+    }
+    else if (options.watch && !watch_directory(options.inputname, &options))
+    {
+        return 1;
     }
 
     return 0;
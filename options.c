@@ -0,0 +1,332 @@
+#include "options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "workpool.h"
+#include "buildcache.h"
+
+
+/*
+* Turns a comma-separated list such as "vm,tree" into output bits. "both" is
+* short for "vm,xml". Returns false if any name isn't recognized.
+*/
+static bool parse_outputs(const char* list, unsigned int* outputs)
+{
+    *outputs = 0;
+    while (*list != '\0')
+    {
+        size_t length = strcspn(list, ",");
+        if (length == 2 && strncmp(list, "vm", 2) == 0)
+        {
+            *outputs |= OUT_VM;
+        }
+        else if (length == 3 && strncmp(list, "xml", 3) == 0)
+        {
+            *outputs |= OUT_XML;
+        }
+        else if (length == 4 && strncmp(list, "both", 4) == 0)
+        {
+            *outputs |= OUT_VM | OUT_XML;
+        }
+        else if (length == 4 && strncmp(list, "tree", 4) == 0)
+        {
+            *outputs |= OUT_TREE;
+        }
+        else
+        {
+            fprintf(stderr, "Error: unknown output '%.*s'\n", (int)length, list);
+            return false;
+        }
+        list += length;
+        if (*list == ',')
+        {
+            list++;
+        }
+    }
+    return *outputs != 0;
+}
+
+
+/*
+* Turns a comma-separated list such as "fold" into optimization bits. "all"
+* turns on every pass, "none" turns them all off. Returns false if any name
+* isn't recognized.
+*/
+static bool parse_optimizations(const char* list, unsigned int* optimizations)
+{
+    *optimizations = 0;
+    while (*list != '\0')
+    {
+        size_t length = strcspn(list, ",");
+        if (length == 4 && strncmp(list, "fold", 4) == 0)
+        {
+            *optimizations |= OPT_FOLD;
+        }
+        else if (length == 8 && strncmp(list, "strength", 8) == 0)
+        {
+            *optimizations |= OPT_STRENGTH;
+        }
+        else if (length == 8 && strncmp(list, "peephole", 8) == 0)
+        {
+            *optimizations |= OPT_PEEPHOLE;
+        }
+        else if (length == 8 && strncmp(list, "branches", 8) == 0)
+        {
+            *optimizations |= OPT_BRANCHES;
+        }
+        else if (length == 7 && strncmp(list, "strings", 7) == 0)
+        {
+            *optimizations |= OPT_STRINGS;
+        }
+        else if (length == 3 && strncmp(list, "all", 3) == 0)
+        {
+            *optimizations |= ALL_OPTIMIZATIONS;
+        }
+        else if (length == 4 && strncmp(list, "none", 4) == 0)
+        {
+            *optimizations = 0;
+        }
+        else
+        {
+            fprintf(stderr, "Error: unknown optimization '%.*s'\n", (int)length, list);
+            return false;
+        }
+        list += length;
+        if (*list == ',')
+        {
+            list++;
+        }
+    }
+    return true;
+}
+
+
+/*
+* Reads the thread count for -j. 0 means one per processor.
+*/
+static bool parse_jobs(const char* text, int* jobs)
+{
+    char* end = NULL;
+    long n = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || n < 0 || n > 4096)
+    {
+        fprintf(stderr, "Error: -j needs a number of threads, got '%s'\n", text);
+        return false;
+    }
+    *jobs = (n == 0) ? count_processors() : (int)n;
+    return true;
+}
+
+
+/*
+* Fills options from argv. Options may come before or after the input name.
+*/
+bool parse_command_line(int argc, char** argv, compileoptions* options)
+{
+    options->outputs = OUT_VM;
+    options->optimizations = 0;
+    options->jobs = 1;
+    options->usecache = true;
+    options->watch = false;
+    options->latencyfile = NULL;
+    options->linkfile = NULL;
+    options->stats = SF_NONE;
+    options->statsfile = NULL;
+    options->inputname = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--emit") == 0 || strcmp(arg, "-e") == 0)
+        {
+            if (i + 1 >= argc || !parse_outputs(argv[++i], &(options->outputs)))
+            {
+                return false;
+            }
+        }
+        else if (strncmp(arg, "--emit=", 7) == 0)
+        {
+            if (!parse_outputs(arg + 7, &(options->outputs)))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--optimize") == 0 || strcmp(arg, "-O") == 0)
+        {
+            if (i + 1 >= argc || !parse_optimizations(argv[++i], &(options->optimizations)))
+            {
+                return false;
+            }
+        }
+        else if (strncmp(arg, "--optimize=", 11) == 0)
+        {
+            if (!parse_optimizations(arg + 11, &(options->optimizations)))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--jobs") == 0 || strcmp(arg, "-j") == 0)
+        {
+            if (i + 1 >= argc || !parse_jobs(argv[++i], &(options->jobs)))
+            {
+                return false;
+            }
+        }
+        else if (strncmp(arg, "--jobs=", 7) == 0 || (strncmp(arg, "-j", 2) == 0 && arg[2] != '\0'))
+        {
+            if (!parse_jobs(arg + ((arg[1] == 'j') ? 2 : 7), &(options->jobs)))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--no-cache") == 0)
+        {
+            options->usecache = false;
+        }
+        else if (strcmp(arg, "--watch") == 0 || strcmp(arg, "-w") == 0)
+        {
+            options->watch = true;
+        }
+        else if (strcmp(arg, "--latency-json") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+            options->latencyfile = argv[++i];
+        }
+        else if (strncmp(arg, "--latency-json=", 15) == 0)
+        {
+            options->latencyfile = arg + 15;
+        }
+        else if (strcmp(arg, "--link") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+            options->linkfile = argv[++i];
+        }
+        else if (strncmp(arg, "--link=", 7) == 0)
+        {
+            options->linkfile = arg + 7;
+        }
+        else if (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0)
+        {
+            options->stats = SF_TEXT;
+        }
+        else if (strcmp(arg, "--stats=json") == 0)
+        {
+            options->stats = SF_JSON;
+        }
+        else if (strcmp(arg, "--stats-file") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+            options->statsfile = argv[++i];
+        }
+        else if (strncmp(arg, "--stats-file=", 13) == 0)
+        {
+            options->statsfile = arg + 13;
+        }
+        else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+        {
+            return false;
+        }
+        else if (arg[0] == '-' && arg[1] != '\0')
+        {
+            fprintf(stderr, "Error: unknown option %s\n", arg);
+            return false;
+        }
+        else if (options->inputname == NULL)
+        {
+            options->inputname = arg;
+        }
+        else
+        {
+            fprintf(stderr, "Error: only one directory or file can be compiled at a time\n");
+            return false;
+        }
+    }
+    if (options->latencyfile != NULL && !options->watch)
+    {
+        fprintf(stderr, "Error: --latency-json only applies to --watch\n");
+        return false;
+    }
+    if (options->linkfile != NULL && !(options->outputs & OUT_VM))
+    {
+        fprintf(stderr, "Error: --link needs vm output\n");
+        return false;
+    }
+    if (options->statsfile != NULL && options->stats == SF_NONE)
+    {
+        options->stats = SF_TEXT;
+    }
+    return options->inputname != NULL;
+}
+
+void print_usage(const char* programname)
+{
+    fprintf(stderr, "Usage: %s [options] [directory name or filename.jack]\n", programname);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -e, --emit LIST   outputs to write for each file, comma separated:\n");
+    fprintf(stderr, "                      vm    compiled VM code (the default)\n");
+    fprintf(stderr, "                      xml   annotated XML parse tree, for debugging\n");
+    fprintf(stderr, "                      tree  compact binary parse tree\n");
+    fprintf(stderr, "                      both  same as vm,xml\n");
+    fprintf(stderr, "  -O, --optimize LIST\n");
+    fprintf(stderr, "                    optimizations to apply, comma separated (default none):\n");
+    fprintf(stderr, "                      fold      evaluate constant expressions at compile time\n");
+    fprintf(stderr, "                      strength  multiply and divide by constants with adds instead of\n");
+    fprintf(stderr, "                                calls to Math.multiply and Math.divide\n");
+    fprintf(stderr, "                      peephole  rewrite wasteful runs of VM commands as they are written\n");
+    fprintf(stderr, "                      branches  lay out if and while statements to run fewer branches\n");
+    fprintf(stderr, "                      all       every optimization above\n");
+    fprintf(stderr, "                      strings   build each string literal once per class and reuse it;\n");
+    fprintf(stderr, "                                not part of all, as every use then shares one String\n");
+    fprintf(stderr, "  -j, --jobs N      compile up to N files of a directory at once (0: one per processor)\n");
+    fprintf(stderr, "      --no-cache    recompile every file of a directory, even unchanged ones\n");
+    fprintf(stderr, "  -w, --watch       after compiling a directory, recompile its files as they are saved\n");
+    fprintf(stderr, "      --latency-json FILE\n");
+    fprintf(stderr, "                    with --watch, write the rebuild latencies to FILE as JSON on exit\n");
+    fprintf(stderr, "      --link FILE   after compiling a directory, write the functions Sys.init and Main.main\n");
+    fprintf(stderr, "                    can reach, from every .vm file in it, to FILE; put FILE outside the\n");
+    fprintf(stderr, "                    directory, or a VM emulator loading the directory sees everything twice\n");
+    fprintf(stderr, "      --stats[=text|json]\n");
+    fprintf(stderr, "                    time each phase and count tokens, symbols and output, per file and in total\n");
+    fprintf(stderr, "      --stats-file FILE\n");
+    fprintf(stderr, "                    write the --stats report to FILE instead of standard output\n");
+    fprintf(stderr, "  -h, --help        show this message\n");
+}
+
+
+/*
+* Identifies this build of the compiler by hashing its own executable, so a
+* change to any of its sources gives a different key. If the executable
+* can't be read, falls back to when this file was compiled, which misses
+* changes to the other sources but still tells most builds apart.
+*/
+static unsigned long long compiler_build_key(void)
+{
+    static unsigned long long key = 0; // 0 until computed; FNV-1a of any input is practically never 0
+    if (key == 0 && !hash_file_contents(COMPILER_EXECUTABLE, &key))
+    {
+        key = hash_bytes(__DATE__ " " __TIME__, strlen(__DATE__ " " __TIME__), FNV_OFFSET_BASIS);
+    }
+    return key;
+}
+
+/*
+* Hashes every option that changes what gets written, along with the build
+* of the compiler, so outputs cached by a different build are never reused.
+* -j and the cache setting itself don't affect output.
+*/
+unsigned long long options_key(const compileoptions* options)
+{
+    char description[128];
+    int length = snprintf(description, sizeof(description), "%016llx outputs=%u optimizations=%u", compiler_build_key(),
+        options->outputs, options->optimizations);
+    return hash_bytes(description, (size_t)length, FNV_OFFSET_BASIS);
+}
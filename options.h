@@ -0,0 +1,48 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include "compilestats.h"
+
+#define COMPILER_EXECUTABLE "/proc/self/exe" // hashed into options_key(), so a rebuilt compiler invalidates the cache
+
+// the files compile_jack_file() can write for each .jack input, as bits of compileoptions.outputs
+typedef enum outputkind
+{
+    OUT_VM = 1, // .vm, the compiled program
+    OUT_XML = 2, // .xml, the annotated parse tree used for debugging
+    OUT_TREE = 4 // .tree, the parse tree in the compact binary form described in xmlwriter.h
+} outputkind;
+
+// passes over the syntax tree and VM code that --optimize can turn on, as bits of compileoptions.optimizations
+typedef enum optimization
+{
+    OPT_FOLD = 1, // evaluate constant expressions at compile time
+    OPT_STRENGTH = 2, // multiply and divide by constants without calling Math
+    OPT_PEEPHOLE = 4, // rewrite short runs of wasteful VM commands, as peephole.c describes
+    OPT_BRANCHES = 8, // lay out if and while to run fewer branches
+    OPT_STRINGS = 16 // build each string literal once and keep it in a static; not in "all", see codegenerator.c
+} optimization;
+
+#define ALL_OPTIMIZATIONS (OPT_FOLD | OPT_STRENGTH | OPT_PEEPHOLE | OPT_BRANCHES)
+
+// everything the command line can ask for
+typedef struct compileoptions
+{
+    unsigned int outputs; // OUT_VM unless --emit says otherwise
+    unsigned int optimizations; // none unless --optimize says otherwise, so output matches the book's compiler
+    int jobs; // files compiled at once in directory mode, 1 unless -j says otherwise
+    bool usecache; // skip unchanged files in directory mode, true unless --no-cache
+    bool watch; // keep running and recompile files of the directory as they are saved
+    const char* latencyfile; // where watch mode dumps its rebuild latencies as JSON, or NULL
+    const char* linkfile; // where to link a directory's .vm files into one program, as linker.h describes, or NULL
+    statsformat stats; // SF_NONE unless --stats
+    const char* statsfile; // where --stats goes, NULL for stdout
+    const char* inputname; // a directory or a .jack file
+} compileoptions;
+
+bool parse_command_line(int argc, char** argv, compileoptions* options); // false if the usage message should be shown
+void print_usage(const char* programname);
+unsigned long long options_key(const compileoptions* options); // identifies the options that affect output files
+
+#endif // OPTIONS_H
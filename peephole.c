@@ -0,0 +1,281 @@
+#include "peephole.h"
+#include <string.h>
+
+/*
+* A rule matches a run of consecutive commands, one pattern entry each, and
+* replaces the run with its replacement. Whatever the patterns can't say,
+* such as two labels having to be the same, is checked by the rule's
+* condition. Nothing in the window matches before a command is added, so
+* only runs ending at the new command, or after the last rewrite, are tried.
+* One rewrite can set up the next: "while (~done)" ends in "not, not,
+* if-goto", which not-not turns into a plain "if-goto".
+*/
+
+#define ANY_INDEX -1
+#define OPS(op) (1u << (op))
+#define ARGS(arg) (1u << (arg))
+
+#define NEW -1 // as a replacement's from: build the command from op, arg and index
+#define KEEP -1 // as a replacement's op or arg: keep the copied command's
+
+typedef struct vmpattern
+{
+    unsigned int ops; // OPS() of each opcode that matches
+    unsigned int args; // ARGS() of each segment or arithmetic command that matches, 0 for any
+    int index; // the push or pop index that matches, or ANY_INDEX
+} vmpattern;
+
+typedef struct vmreplacement
+{
+    int from; // the matched command to copy, or NEW
+    int op;
+    int arg;
+    int index; // only for NEW
+} vmreplacement;
+
+typedef struct peepholeruledef
+{
+    const char* name; // as --stats reports it
+    int length;
+    vmpattern pattern[MAX_PEEPHOLE_PATTERN];
+    bool (*condition)(const vminstruction* match); // NULL if the pattern says it all
+    int replacementlength;
+    vmreplacement replacement[MAX_PEEPHOLE_PATTERN];
+    bool deadcode; // the matched code never runs, so removing it saves no cycles
+} peepholeruledef;
+
+
+static bool same_location(const vminstruction* match)
+{
+    return match[0].arg == match[1].arg && match[0].index == match[1].index;
+}
+
+static bool nonzero_constant(const vminstruction* match)
+{
+    return match[0].index != 0;
+}
+
+static bool jumps_to_next_label(const vminstruction* match)
+{
+    return strcmp(match[0].label, match[1].label) == 0;
+}
+
+// if-goto A, goto B, label A
+static bool skips_over_goto(const vminstruction* match)
+{
+    return strcmp(match[2].label, match[4].label) == 0;
+}
+
+// the value pushed doesn't depend on temp 1, pointer 1 or that, so it can be pushed after pointer 1 is set
+static bool independent_of_array_target(const vminstruction* match)
+{
+    vmsegment segment = (vmsegment)match[1].arg;
+    return segment != VMS_THAT && !((segment == VMS_TEMP || segment == VMS_POINTER) && match[1].index == 1);
+}
+
+
+#define ANY_PUSH { OPS(VMO_PUSH), 0, ANY_INDEX }
+#define CONSTANT(n) { OPS(VMO_PUSH), ARGS(VMS_CONST), n }
+#define ARITHMETIC(commands) { OPS(VMO_ARITHMETIC), commands, ANY_INDEX }
+#define JUMP(op) { OPS(op), 0, ANY_INDEX }
+#define COPY(n) { n, KEEP, KEEP, 0 }
+
+// indexed by peepholerule
+static const peepholeruledef rules[NUM_PEEPHOLE_RULES] =
+{
+    // the same cost, but the other rules only need to know one form of true
+    { "true", 2, { CONSTANT(1), ARITHMETIC(ARGS(VMC_NEG)) }, NULL,
+        2, { { NEW, VMO_PUSH, VMS_CONST, 0 }, { NEW, VMO_ARITHMETIC, VMC_NOT, 0 } }, false },
+    { "not-not", 2, { ARITHMETIC(ARGS(VMC_NOT)), ARITHMETIC(ARGS(VMC_NOT)) }, NULL, 0, { { 0 } }, false },
+    { "neg-neg", 2, { ARITHMETIC(ARGS(VMC_NEG)), ARITHMETIC(ARGS(VMC_NEG)) }, NULL, 0, { { 0 } }, false },
+    { "zero-operand", 2, { CONSTANT(0), ARITHMETIC(ARGS(VMC_ADD) | ARGS(VMC_SUB) | ARGS(VMC_OR)) }, NULL,
+        0, { { 0 } }, false },
+    { "push-pop", 2, { ANY_PUSH, { OPS(VMO_POP), 0, ANY_INDEX } }, same_location, 0, { { 0 } }, false },
+    { "never-taken", 2, { CONSTANT(0), JUMP(VMO_IF) }, NULL, 0, { { 0 } }, false },
+    { "always-taken", 2, { CONSTANT(ANY_INDEX), JUMP(VMO_IF) }, nonzero_constant,
+        1, { { 1, VMO_GOTO, KEEP, 0 } }, false },
+    { "always-taken-true", 3, { CONSTANT(0), ARITHMETIC(ARGS(VMC_NOT)), JUMP(VMO_IF) }, NULL,
+        1, { { 2, VMO_GOTO, KEEP, 0 } }, false },
+    // only for comparisons: for any other value, not v being nonzero doesn't mean v is zero
+    { "inverted-if", 5, { ARITHMETIC(ARGS(VMC_EQ) | ARGS(VMC_GT) | ARGS(VMC_LT)), ARITHMETIC(ARGS(VMC_NOT)),
+        JUMP(VMO_IF), JUMP(VMO_GOTO), JUMP(VMO_LABEL) }, skips_over_goto,
+        3, { COPY(0), { 3, VMO_IF, KEEP, 0 }, COPY(4) }, false },
+    { "goto-next", 2, { JUMP(VMO_GOTO), JUMP(VMO_LABEL) }, jumps_to_next_label, 1, { COPY(1) }, false },
+    { "unreachable", 2, { { OPS(VMO_GOTO) | OPS(VMO_RETURN), 0, ANY_INDEX },
+        { OPS(VMO_PUSH) | OPS(VMO_POP) | OPS(VMO_ARITHMETIC) | OPS(VMO_GOTO) | OPS(VMO_IF) | OPS(VMO_RETURN), 0, ANY_INDEX } },
+        NULL, 1, { COPY(0) }, true },
+    // pop temp 1, push x, push temp 1, pop pointer 1, pop that 0 -> pop pointer 1, push x, pop that 0
+    { "array-store", 5, { { OPS(VMO_POP), ARGS(VMS_TEMP), 1 }, ANY_PUSH, { OPS(VMO_PUSH), ARGS(VMS_TEMP), 1 },
+        { OPS(VMO_POP), ARGS(VMS_POINTER), 1 }, { OPS(VMO_POP), ARGS(VMS_THAT), 0 } }, independent_of_array_target,
+        3, { COPY(3), COPY(1), COPY(4) }, false }
+};
+
+
+/*
+* Roughly how many Hack instructions a straightforward VM translator, as
+* designed in the book, runs for instruction.
+*/
+static int estimated_cycles(const vminstruction* instruction)
+{
+    vmsegment segment = (vmsegment)instruction->arg;
+    bool direct = segment == VMS_CONST || segment == VMS_STATIC || segment == VMS_TEMP || segment == VMS_POINTER;
+    switch (instruction->op)
+    {
+        case VMO_PUSH:
+            return direct ? 7 : 9;
+        case VMO_POP:
+            return direct ? 5 : 12;
+        case VMO_ARITHMETIC:
+            switch ((vmcommand)instruction->arg)
+            {
+                case VMC_NEG:
+                case VMC_NOT:
+                    return 3;
+                case VMC_EQ:
+                case VMC_GT:
+                case VMC_LT:
+                    return 12;
+                case VMC_MULT:
+                case VMC_DIV:
+                    return 50; // the call alone
+                default:
+                    return 5;
+            }
+        case VMO_LABEL:
+            return 0;
+        case VMO_GOTO:
+            return 2;
+        case VMO_IF:
+            return 5;
+        case VMO_RETURN:
+            return 50;
+    }
+    return 0;
+}
+
+
+static bool matches_rule(const peepholeruledef* rule, const vminstruction* match)
+{
+    for (int i = rule->length - 1; i >= 0; i--) // the newest command rules out most rules
+    {
+        const vmpattern* pattern = &rule->pattern[i];
+        if (!(pattern->ops & OPS(match[i].op)) || (pattern->args != 0 && !(pattern->args & ARGS(match[i].arg)))
+            || (pattern->index != ANY_INDEX && pattern->index != match[i].index))
+        {
+            return false;
+        }
+    }
+    return rule->condition == NULL || rule->condition(match);
+}
+
+/*
+* Replaces the commands matched at start with the rule's replacement.
+*/
+static void apply_rule(peephole* p, int start, peepholerule id)
+{
+    const peepholeruledef* rule = &rules[id];
+    vminstruction* match = &p->window[start];
+    vminstruction replacement[MAX_PEEPHOLE_PATTERN];
+    long cycles = 0;
+    for (int i = 0; i < rule->replacementlength; i++)
+    {
+        const vmreplacement* r = &rule->replacement[i];
+        if (r->from == NEW)
+        {
+            replacement[i].op = (vmopcode)r->op;
+            replacement[i].arg = r->arg;
+            replacement[i].index = r->index;
+            replacement[i].label[0] = '\0';
+        }
+        else
+        {
+            replacement[i] = match[r->from];
+            if (r->op != KEEP)
+            {
+                replacement[i].op = (vmopcode)r->op;
+            }
+            if (r->arg != KEEP)
+            {
+                replacement[i].arg = r->arg;
+            }
+        }
+        cycles -= estimated_cycles(&replacement[i]);
+    }
+    for (int i = 0; i < rule->length; i++)
+    {
+        cycles += estimated_cycles(&match[i]);
+    }
+
+    int after = p->count - start - rule->length; // commands following the match
+    memmove(match + rule->replacementlength, match + rule->length, (size_t)after * sizeof(*match));
+    memcpy(match, replacement, (size_t)rule->replacementlength * sizeof(*match));
+    p->count += rule->replacementlength - rule->length;
+
+    if (p->stats != NULL)
+    {
+        p->stats->hits[id]++;
+        p->stats->removed += (unsigned long)(rule->length - rule->replacementlength);
+        p->stats->cycles += rule->deadcode ? 0 : cycles;
+    }
+}
+
+/*
+* Applies the first rule matching a run that ends at *firstend or later,
+* and sets *firstend to where the replacement starts. Returns false if no
+* rule matched.
+*/
+static bool apply_first_match(peephole* p, int* firstend)
+{
+    for (int end = *firstend; end < p->count; end++)
+    {
+        for (int id = 0; id < NUM_PEEPHOLE_RULES; id++)
+        {
+            int start = end + 1 - rules[id].length;
+            if (start >= 0 && matches_rule(&rules[id], &p->window[start]))
+            {
+                apply_rule(p, start, (peepholerule)id);
+                *firstend = start;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
+void initialize_peephole(peephole* p, peepholestats* stats)
+{
+    p->count = 0;
+    p->stats = stats;
+}
+
+void add_to_peephole(peephole* p, vmbuffer* vm, const vminstruction* instruction)
+{
+    p->window[p->count++] = *instruction;
+    int firstend = p->count - 1;
+    while (apply_first_match(p, &firstend))
+    {
+    }
+
+    // rules never add commands, so at most one is over
+    if (p->count > PEEPHOLE_WINDOW)
+    {
+        write_vm_instruction(vm, &p->window[0]);
+        memmove(p->window, p->window + 1, (size_t)(p->count - 1) * sizeof(p->window[0]));
+        p->count--;
+    }
+}
+
+void flush_peephole(peephole* p, vmbuffer* vm)
+{
+    for (int i = 0; i < p->count; i++)
+    {
+        write_vm_instruction(vm, &p->window[i]);
+    }
+    p->count = 0;
+}
+
+const char* peephole_rule_name(peepholerule rule)
+{
+    return rules[rule].name;
+}
@@ -0,0 +1,53 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdbool.h>
+#include "vmwriter.h"
+
+// The peephole pass holds the last few VM commands of a file back from the
+// vmbuffer and rewrites any run of them that matches a rule in the table in
+// peephole.c. Calls and function declarations flush it, so no rule looks
+// across them.
+
+#define PEEPHOLE_WINDOW 8 // commands held back; at least as many as the longest pattern
+#define MAX_PEEPHOLE_PATTERN 5
+
+// indexed the same way as the rule table in peephole.c
+typedef enum peepholerule
+{
+    PR_TRUE, // push constant 1, neg -> push constant 0, not
+    PR_NOT_NOT, // not, not -> nothing
+    PR_NEG_NEG, // neg, neg -> nothing
+    PR_ZERO_OPERAND, // push constant 0, add/sub/or -> nothing
+    PR_PUSH_POP, // push x, pop x -> nothing
+    PR_NEVER_TAKEN, // push constant 0, if-goto -> nothing
+    PR_ALWAYS_TAKEN, // push constant n (n != 0), if-goto L -> goto L
+    PR_ALWAYS_TAKEN_TRUE, // push constant 0, not, if-goto L -> goto L
+    PR_INVERTED_IF, // comparison, not, if-goto A, goto B, label A -> comparison, if-goto B, label A
+    PR_GOTO_NEXT, // goto L, label L -> label L
+    PR_UNREACHABLE, // goto or return, then anything but a label -> goto or return
+    PR_ARRAY_STORE, // let a[i] = x for a simple x stores through pointer 1 without temp 1
+    NUM_PEEPHOLE_RULES
+} peepholerule;
+
+// what the pass did, for --stats
+typedef struct peepholestats
+{
+    unsigned long hits[NUM_PEEPHOLE_RULES];
+    unsigned long removed; // commands
+    long cycles; // Hack instructions no longer executed each time the rewritten code runs, estimated
+} peepholestats;
+
+typedef struct peephole
+{
+    vminstruction window[PEEPHOLE_WINDOW + 1]; // oldest first
+    int count;
+    peepholestats* stats; // may be NULL
+} peephole;
+
+void initialize_peephole(peephole* p, peepholestats* stats);
+void add_to_peephole(peephole* p, vmbuffer* vm, const vminstruction* instruction); // applies the rules, writes out what falls off the window
+void flush_peephole(peephole* p, vmbuffer* vm); // writes out everything held back
+const char* peephole_rule_name(peepholerule rule);
+
+#endif // PEEPHOLE_H
@@ -5,24 +5,36 @@
 
 
 /*
-* Frees all nodes in the provided symboltable and creates a new one.
+* Empties the provided symboltable for a new subroutine scope. Nothing is
+* freed: bumping the generation makes every existing slot read as empty,
+* and the entry array is written over from the start.
 */
 void start_subroutine(symboltable* subtable)
 {
-    free_symbol_table_nodes(subtable);
-    initialize_symbol_table(subtable);
+    subtable->generation++;
+    if (subtable->generation == 0)
+    {
+        // the counter wrapped, so old stamps could match again; clear them for real
+        memset(subtable->slots, 0, subtable->numslots * sizeof(*(subtable->slots)));
+        subtable->generation = 1;
+    }
+    subtable->count = 0;
+    subtable->staticindex = 0;
+    subtable->fieldindex = 0;
+    subtable->argindex = 0;
+    subtable->varindex = 0;
 }
 
 
 /*
 * Copies name, type, and kind into node fields. A "setter" function.
 */
-void define(tablenode* node, const char* name, const char* type, const symbolkind kind)
+void define(tablenode* node, atom name, atom type, const symbolkind kind)
 {
     assert (node != NULL); // DEBUG
 
-    strcpy (node->name, name);
-    strcpy (node->type, type);
+    node->name = name;
+    node->type = type;
     node->kind = kind;
 }
 
@@ -54,7 +66,7 @@ unsigned int var_count(const symboltable* st, const symbolkind kind)
 * Returns the kind of the named identifier in the provided symbol table.
 * If the identifier is unknown in the table, returns SK_NONE.
 */
-symbolkind kind_of(const symboltable* st, const char* name)
+symbolkind kind_of(const symboltable* st, atom name)
 {
     tablenode* temp = search_symbol_table(st, name);
     if (temp == NULL)
@@ -70,14 +82,14 @@ symbolkind kind_of(const symboltable* st, const char* name)
 
 /*
 * Returns the type of the named identifier in the provided symbol table.
-* If the identifier is unknown in the table, returns NONE.
+* If the identifier is unknown in the table, returns ATOM_NONE.
 */
-char* type_of(const symboltable* st, const char* name)
+atom type_of(const symboltable* st, atom name)
 {
     tablenode* temp = search_symbol_table(st, name);
     if (temp == NULL)
     {
-        return "NONE";
+        return ATOM_NONE;
     }
     else
     {
@@ -90,7 +102,7 @@ char* type_of(const symboltable* st, const char* name)
 * Returns the type of the named identifier in the provided symbol table.
 * If the identifier is unknown in the table, returns -1.
 */
-int index_of(const symboltable* st, const char* name)
+int index_of(const symboltable* st, atom name)
 {
     tablenode* temp = search_symbol_table(st, name);
     if (temp == NULL)
@@ -105,20 +117,32 @@ int index_of(const symboltable* st, const char* name)
 
 
 /*
-* Sets all tablenode pointers in the array to NULL and sets indices to 0.
+* Allocates an empty table with INITIAL_TABLE_SLOTS slots and sets indices to 0.
+* names is the interner that the table's atoms come from.
 */
-void initialize_symbol_table(symboltable* st)
+void initialize_symbol_table(symboltable* st, const interner* names)
 {
     assert (st != NULL); // DEBUG
 
-    for (size_t i = 0; i < TABLE_SIZE; i++)
+    st->count = 0;
+    st->capacity = INITIAL_TABLE_SLOTS / 2;
+    st->numslots = INITIAL_TABLE_SLOTS;
+    st->generation = 1; // calloc'd slots have generation 0, so they start out empty
+    st->entries = malloc(st->capacity * sizeof(*(st->entries)));
+    st->slots = calloc(st->numslots, sizeof(*(st->slots)));
+    if (st->entries == NULL || st->slots == NULL)
     {
-        st->headnodes[i] = NULL;
+        fprintf(stderr, "Error: could not allocate memory for symbol table\n");
+        exit(1);
     }
+
     st->staticindex = 0;
     st->fieldindex = 0;
     st->argindex = 0;
     st->varindex = 0;
+    st->names = names;
+    st->parent = NULL;
+    st->stats = NULL;
 }
 
 /*
@@ -127,40 +151,24 @@ void initialize_symbol_table(symboltable* st)
 */
 void initialize_blank_node(tablenode* node)
 {
-    strcpy(node->name, "none");
-    strcpy(node->type, "none");
+    node->name = ATOM_NONE;
+    node->type = ATOM_NONE;
     node->kind = SK_NONE;
     node->index = 0;
     node->is_being_defined = false;
-    node->next = NULL;
 }
 
 /*
-* Prints all entries in the symbol table, including the index
-* of the current node. For nodes that begin linked lists,
-* the list is traversed and printed with -> to show links.
+* Prints all entries in the symbol table in the order they were defined,
+* each numbered by its position in that order.
 */
-void print_symbol_table(const symboltable* st)
+void print_symbol_table(const symboltable* st, FILE* outfile)
 {
-    for (size_t i = 0; i < TABLE_SIZE; i++)
+    for (size_t i = 0; i < st->count; i++)
     {
-        if (st->headnodes[i] == NULL)
-        {
-            // printf("[%d] -> NULL\n", i);
-        }
-        else
-        {
-            printf("[%d] NAME: %s, TYPE: %s, KIND: %s, INDEX: %d\n", i, st->headnodes[i]->name, st->headnodes[i]->type,
-                convert_symbolkind_to_string(st->headnodes[i]->kind), st->headnodes[i]->index);
-
-            tablenode* temp = st->headnodes[i]->next;
-            while (temp != NULL)
-            {
-                printf("    -> NAME: %s, TYPE: %s, KIND: %s, INDEX: %d\n", temp->name, temp->type,
-                convert_symbolkind_to_string(temp->kind), temp->index);
-                temp = temp->next;
-            }
-        }
+        const tablenode* node = &st->entries[i];
+        fprintf(outfile, "[%d] NAME: %s, TYPE: %s, KIND: %s, INDEX: %u\n", (int)i, atom_text(st->names, node->name),
+            atom_text(st->names, node->type), convert_symbolkind_to_string(node->kind), node->index);
     }
 }
 
@@ -188,96 +196,163 @@ const char* convert_symbolkind_to_string(symbolkind sk)
 }
 
 /*
-* Frees all allocated memory for nodes in the symboltable.
+* Frees the entry array and slot index of the symboltable.
 */
 void free_symbol_table_nodes(symboltable* st)
 {
-    for (size_t i = 0; i < TABLE_SIZE; i++)
+    free(st->entries);
+    free(st->slots);
+    st->entries = NULL;
+    st->slots = NULL;
+    st->count = 0;
+    st->capacity = 0;
+    st->numslots = 0;
+}
+
+
+/*
+* Returns the starting slot hash for the provided name. Atoms are small
+* consecutive integers, so they are scrambled with a multiplicative
+* (Fibonacci) hash before being masked to the table size.
+*/
+unsigned int hash_atom(atom name)
+{
+    return name * 2654435761u;
+}
+
+
+/*
+* Returns the slot where name is stored, or the empty slot where it would go.
+*/
+static size_t find_slot(const symboltable* st, atom name)
+{
+    size_t mask = st->numslots - 1;
+    size_t slot = hash_atom(name) & mask;
+    unsigned long probes = 1;
+    while (st->slots[slot].generation == st->generation && st->entries[st->slots[slot].entry].name != name)
+    {
+        slot = (slot + 1) & mask;
+        probes++;
+    }
+    if (st->stats != NULL)
     {
-        if (st->headnodes[i] != NULL)
+        st->stats->probes += probes;
+        if (probes > st->stats->longestprobe)
         {
-            free_tablenode(st->headnodes[i]);
-            st->headnodes[i] = NULL;
+            st->stats->longestprobe = probes;
         }
     }
+    return slot;
 }
 
+
 /*
-* Frees the memory allocated for a single node.
-* If a linked list is encountered, frees all nodes in the list.
+* Doubles the slot index and re-inserts every entry of the current scope.
+* Entries are re-inserted in definition order, so a name defined twice
+* still finds its first entry.
 */
-void free_tablenode(tablenode* node)
+static void grow_slots(symboltable* st)
 {
-    tablenode* temp = node;
-    tablenode* temp2 = NULL;
-    while (temp != NULL)
+    size_t newnumslots = st->numslots * 2;
+    tableslot* newslots = calloc(newnumslots, sizeof(*newslots));
+    if (newslots == NULL)
     {
-        temp2 = temp->next;
-        free(temp);
-        temp = temp2;
+        fprintf(stderr, "Error: could not allocate memory for symbol table slots\n");
+        exit(1);
     }
-    /*
-    Alterate recursive method:
-    if (node != NULL)
+    for (size_t i = 0; i < st->count; i++)
     {
-        free_tablenode(node->next);
-        free(node);
+        size_t slot = hash_atom(st->entries[i].name) & (newnumslots - 1);
+        while (newslots[slot].generation == st->generation)
+        {
+            slot = (slot + 1) & (newnumslots - 1);
+        }
+        newslots[slot].entry = (unsigned int)i;
+        newslots[slot].generation = st->generation;
     }
-    */
+    free(st->slots);
+    st->slots = newslots;
+    st->numslots = newnumslots;
 }
 
 
 /*
-* Returns a hash value for the provided string.
+* Copies newnode to the end of the entry array and indexes it by name.
+* If the name is already defined, the earlier entry keeps winning lookups.
 */
-unsigned int hash_string(const char* s)
+void append_node(symboltable* st, const tablenode* newnode)
 {
-    unsigned int hashval = 0;
-    for(size_t i = 0; i < strlen(s); i++)
+    if ((st->count + 1) * 100 > st->numslots * MAX_LOAD_PERCENT)
     {
-        hashval = s[i] + ((hashval << 5) - hashval);
+        grow_slots(st);
     }
-    return hashval % TABLE_SIZE;
+    if (st->count == st->capacity)
+    {
+        size_t newcapacity = st->capacity * 2;
+        tablenode* temp = realloc(st->entries, newcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for symbol table entries\n");
+            exit(1);
+        }
+        st->entries = temp;
+        st->capacity = newcapacity;
+    }
+
+    if (st->stats != NULL)
+    {
+        st->stats->defined++;
+    }
+    st->entries[st->count] = *newnode;
+    size_t slot = find_slot(st, newnode->name);
+    if (st->slots[slot].generation != st->generation)
+    {
+        st->slots[slot].entry = (unsigned int)st->count;
+        st->slots[slot].generation = st->generation;
+    }
+    st->count++;
 }
 
 /*
-* Hashes the name string of newnode and appends the node to the
-* symboltable at the appropriate location.
+* Returns a pointer to the entry in the symboltable with a "name" field
+* equal to the provided name atom. Returns NULL if no match is found.
 */
-void append_node(symboltable* st, tablenode* newnode)
+tablenode* search_symbol_table(const symboltable* st, atom name)
 {
-    unsigned int hashval = hash_string(newnode->name);
-
-    if (st->headnodes[hashval] == NULL)
+    if (st->stats != NULL)
     {
-        st->headnodes[hashval] = newnode;
+        st->stats->lookups++;
     }
-    else
+    size_t slot = find_slot(st, name);
+    if (st->slots[slot].generation != st->generation)
     {
-        // already a symbol at this index, so traverse linked list until the end and insert
-        tablenode* temp = st->headnodes[hashval];
-
-        while (temp->next != NULL)
-        {
-            temp = temp->next;
-        }
-        temp->next = newnode;
+        return NULL;
     }
+    return &st->entries[st->slots[slot].entry];
 }
 
+
 /*
-* Returns a pointer to the first node in the symboltable with a "name" field
-* equal to the provided name string. Returns NULL if no match is found.
+* Looks name up in st and then in each enclosing scope until it is found,
+* returning its kind, index and type together so callers only search once.
 */
-tablenode* search_symbol_table(const symboltable* st, const char* name)
+resolvedsymbol resolve_symbol(const symboltable* st, atom name)
 {
-    unsigned int hashval = hash_string(name);
-    tablenode* temp = st->headnodes[hashval];
+    resolvedsymbol result;
+    result.kind = SK_NONE;
+    result.index = 0;
+    result.type = ATOM_NONE;
 
-    while (temp != NULL && strcmp(name, temp->name) != 0)
+    for (const symboltable* scope = st; scope != NULL; scope = scope->parent)
     {
-        temp = temp->next;
+        const tablenode* node = search_symbol_table(scope, name);
+        if (node != NULL)
+        {
+            result.kind = node->kind;
+            result.index = node->index;
+            result.type = node->type;
+            break;
+        }
     }
-
-    return temp;
+    return result;
 }
@@ -1,12 +1,13 @@
 #ifndef SYMBOLTABLE_H
 #define SYMBOLTABLE_H
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include "interner.h"
 
-#define TABLE_SIZE 31 // prime, for hashing purposes
-#define MAX_NAME_LENGTH 64 // arbitrary assumption about max variable name length
-#define MAX_TYPE_LENGTH 64 // arbitrary assumption about max type name length
+#define INITIAL_TABLE_SLOTS 32 // power of 2, so slot numbers can be masked instead of divided
+#define MAX_LOAD_PERCENT 70 // the slot index doubles before it gets fuller than this
 
 typedef enum symbolkind
 {
@@ -19,41 +20,79 @@ typedef enum symbolkind
 
 typedef struct tablenode
 {
-    char name[MAX_NAME_LENGTH];
-    char type[MAX_TYPE_LENGTH];
+    atom name;
+    atom type;
     symbolkind kind;
     unsigned int index;
     bool is_being_defined;
-    struct tablenode* next;
 } tablenode;
 
+// lookup counters, shared by the tables of one compilation
+typedef struct symbolstats
+{
+    unsigned long lookups; // calls to search_symbol_table()
+    unsigned long probes; // slots examined by lookups and by append_node()
+    unsigned long longestprobe; // most slots examined by one of them
+    unsigned long defined; // calls to append_node()
+    bool timed; // whether the code generator times its resolve_symbol() calls
+    double resolveseconds; // and how long they took
+} symbolstats;
+
+// a slot in the lookup index; it only counts as occupied if its generation
+// matches the table's current generation
+typedef struct tableslot
+{
+    unsigned int entry; // position in the entries array
+    unsigned int generation;
+} tableslot;
+
+// Entries are stored by value in one array, in the order they were defined.
+// Lookups go through an open-addressing (linear probing) index of slots.
+// Starting a new scope bumps the generation, which empties every slot at
+// once; the entry array and slot index are kept and reused.
 typedef struct symboltable
 {
-    tablenode* headnodes[TABLE_SIZE];
+    tablenode* entries;
+    size_t count;
+    size_t capacity;
+    tableslot* slots;
+    size_t numslots; // always a power of 2
+    unsigned int generation;
     unsigned int staticindex;
     unsigned int fieldindex;
     unsigned int argindex;
     unsigned int varindex;
+    const interner* names; // where name and type atoms get their text, for printing
+    const struct symboltable* parent; // enclosing scope searched by resolve_symbol(), NULL for the class scope
+    symbolstats* stats; // optional, NULL if nobody is counting
 } symboltable;
 
+// everything the code generator needs to know about a name, from one lookup
+typedef struct resolvedsymbol
+{
+    symbolkind kind; // SK_NONE if the name isn't in any enclosing scope
+    unsigned int index;
+    atom type;
+} resolvedsymbol;
+
 
 // book API functions
 void start_subroutine(symboltable* subtable);
-void define(tablenode* node, const char* name, const char* type, const symbolkind kind);
+void define(tablenode* node, atom name, atom type, const symbolkind kind);
 unsigned int var_count(const symboltable* st, const symbolkind kind);
-symbolkind kind_of(const symboltable* st, const char* name);
-char* type_of(const symboltable* st, const char* name);
-int index_of(const symboltable* st, const char* name);
+symbolkind kind_of(const symboltable* st, atom name);
+atom type_of(const symboltable* st, atom name);
+int index_of(const symboltable* st, atom name);
 
 // my functions
-void initialize_symbol_table(symboltable* const st);
+resolvedsymbol resolve_symbol(const symboltable* st, atom name); // searches st, then its parent scopes
+void initialize_symbol_table(symboltable* const st, const interner* names);
 void initialize_blank_node(tablenode* node);
 const char* convert_symbolkind_to_string(symbolkind sk);
-void print_symbol_table(const symboltable* st);
+void print_symbol_table(const symboltable* st, FILE* outfile);
 void free_symbol_table_nodes(symboltable* st);
-void free_tablenode(tablenode* node);
-unsigned int hash_string(const char* s);
-void append_node(symboltable* st, tablenode* newnode);
-tablenode* search_symbol_table(const symboltable* st, const char* name);
+unsigned int hash_atom(atom name);
+void append_node(symboltable* st, const tablenode* newnode); // copies newnode into the table
+tablenode* search_symbol_table(const symboltable* st, atom name);
 
 #endif // SYMBOLTABLE_H
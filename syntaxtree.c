@@ -0,0 +1,53 @@
+#include "syntaxtree.h"
+#include <string.h>
+
+
+void begin_span(sourcespan* span, const token* t, const tokenstream* ts)
+{
+    span->offset = (unsigned int)(t->start - ts->text);
+    span->length = (unsigned int)t->length;
+    span->linenum = t->linenum;
+}
+
+void end_span(sourcespan* span, const token* t, const tokenstream* ts)
+{
+    unsigned int end = (unsigned int)(t->start - ts->text + t->length);
+    if (end > span->offset)
+    {
+        span->length = end - span->offset;
+    }
+}
+
+void extend_span(sourcespan* span, const sourcespan* last)
+{
+    unsigned int end = last->offset + last->length;
+    if (end > span->offset)
+    {
+        span->length = end - span->offset;
+    }
+}
+
+
+/*
+* Returns a zeroed expression of the given kind, starting at t.
+*/
+expression* new_expression(arena* a, expressionkind kind, const token* t, const tokenstream* ts)
+{
+    expression* e = arena_alloc(a, sizeof(*e));
+    memset(e, 0, sizeof(*e));
+    e->kind = kind;
+    begin_span(&e->span, t, ts);
+    return e;
+}
+
+/*
+* Returns a zeroed statement of the given kind, starting at t.
+*/
+statement* new_statement(arena* a, statementkind kind, const token* t, const tokenstream* ts)
+{
+    statement* s = arena_alloc(a, sizeof(*s));
+    memset(s, 0, sizeof(*s));
+    s->kind = kind;
+    begin_span(&s->span, t, ts);
+    return s;
+}
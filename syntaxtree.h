@@ -0,0 +1,168 @@
+#ifndef SYNTAXTREE_H
+#define SYNTAXTREE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "jacktokenizer.h"
+#include "arena.h"
+
+// The parsed form of one class, built by compilationengine.c and walked by
+// codegenerator.c. Every node lives in the file arena and goes when it does.
+// Names are resolved against the symbol tables while parsing, so variables
+// already carry the kind and index the code generator needs.
+
+// the source text a node was parsed from
+typedef struct sourcespan
+{
+    unsigned int offset; // of the node's first char in the source
+    unsigned int length; // up to the end of its last token
+    unsigned int linenum;
+} sourcespan;
+
+typedef struct variableref
+{
+    atom name;
+    symbolkind kind; // SK_NONE if the name couldn't be resolved
+    unsigned int index;
+} variableref;
+
+typedef enum expressionkind
+{
+    EX_INT,
+    EX_STRING,
+    EX_TRUE,
+    EX_FALSE,
+    EX_NULL,
+    EX_THIS,
+    EX_VARIABLE, // name, or name[index]
+    EX_CALL,
+    EX_UNARY,
+    EX_BINARY
+} expressionkind;
+
+typedef enum callkind
+{
+    CALL_FUNCTION, // Class.function(...), constructors included
+    CALL_METHOD, // object.method(...)
+    CALL_SELF // method(...), on this
+} callkind;
+
+typedef struct expression expression;
+
+typedef struct callnode
+{
+    callkind kind;
+    atom classname; // for CALL_METHOD, the type of the object
+    atom subroutinename;
+    variableref object; // CALL_METHOD only
+    expression* arguments; // linked through next
+    unsigned int numargs;
+} callnode;
+
+struct expression
+{
+    expressionkind kind;
+    sourcespan span;
+    expression* next; // the following argument, in an argument list
+    union
+    {
+        int intval;
+        struct
+        {
+            const char* text; // quotes removed, NUL-terminated
+            size_t length;
+        } string;
+        struct
+        {
+            variableref variable;
+            expression* index; // NULL unless this is an array entry
+        } variable;
+        callnode call;
+        struct
+        {
+            char op; // '-' or '~'
+            expression* operand;
+        } unary;
+        struct
+        {
+            char op; // Jack has no precedence, so a + b * c is (a + b) * c
+            expression* left;
+            expression* right;
+        } binary;
+    } as;
+};
+
+typedef enum statementkind
+{
+    ST_LET,
+    ST_IF,
+    ST_WHILE,
+    ST_DO,
+    ST_RETURN
+} statementkind;
+
+typedef struct statement statement;
+
+struct statement
+{
+    statementkind kind;
+    sourcespan span;
+    statement* next; // the following statement in the same block
+    union
+    {
+        struct
+        {
+            variableref target;
+            expression* index; // NULL unless assigning to target[index]
+            expression* value;
+        } let;
+        struct
+        {
+            expression* condition;
+            statement* thenbranch;
+            statement* elsebranch;
+            bool haselse; // an empty else block still gets its labels
+        } ifelse;
+        struct
+        {
+            expression* condition;
+            statement* body;
+        } loop;
+        expression* call; // ST_DO, always an EX_CALL
+        expression* value; // ST_RETURN, NULL for a bare return
+    } as;
+};
+
+typedef enum subroutinekind
+{
+    SUB_CONSTRUCTOR,
+    SUB_FUNCTION,
+    SUB_METHOD
+} subroutinekind;
+
+typedef struct subroutinenode
+{
+    subroutinekind kind;
+    atom name;
+    unsigned int numlocals;
+    statement* body;
+    sourcespan span;
+    struct subroutinenode* next;
+} subroutinenode;
+
+typedef struct classnode
+{
+    atom name;
+    unsigned int numfields; // words a constructor allocates
+    unsigned int numstatics; // static variables declared, numbered from 0
+    subroutinenode* subroutines; // in source order
+    sourcespan span;
+} classnode;
+
+expression* new_expression(arena* a, expressionkind kind, const token* t, const tokenstream* ts); // span starts at t
+statement* new_statement(arena* a, statementkind kind, const token* t, const tokenstream* ts);
+void begin_span(sourcespan* span, const token* t, const tokenstream* ts);
+void end_span(sourcespan* span, const token* t, const tokenstream* ts); // extends span to the end of t
+void extend_span(sourcespan* span, const sourcespan* last); // extends span to the end of last
+
+#endif // SYNTAXTREE_H
@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# Build cache test.
+#
+# Compiles the Pong sources twice with one build of the compiler, then once
+# with a build that differs only in codegenerator.c. The second run must find
+# every file up to date and the third none, since a changed compiler may
+# write different code.
+#
+# Run from the repository root:
+#   sh tests/cache_test.sh
+
+set -e
+CFLAGS="-std=c99 -D_POSIX_C_SOURCE=200809L -D_DEFAULT_SOURCE -O2"
+work=$(mktemp -d "${TMPDIR:-/tmp}/cachetestXXXXXX") # no "." in it, see the notes in main.c
+trap 'rm -rf "$work"' EXIT
+
+mkdir "$work/obj" "$work/Pong"
+for source in *.c; do
+    cc $CFLAGS -c "$source" -o "$work/obj/$(basename "$source" .c).o"
+done
+cc "$work"/obj/*.o -o "$work/compiler" -lpthread
+cc $CFLAGS -O0 -c codegenerator.c -o "$work/obj/codegenerator.o" # options.o is kept as it was
+cc "$work"/obj/*.o -o "$work/rebuilt" -lpthread
+cp testdirectory/*.jack "$work/Pong"
+
+fail=0
+check()
+{
+    if ! grep -q "$2" "$work/output"; then
+        echo "FAIL: $1: expected \"$2\""
+        fail=1
+    fi
+}
+
+"$work/compiler" "$work/Pong" > "$work/output"
+check "first build" "0 of 12 files up to date"
+"$work/compiler" "$work/Pong" > "$work/output"
+check "same compiler" "12 of 12 files up to date"
+"$work/rebuilt" "$work/Pong" > "$work/output"
+check "rebuilt compiler" "0 of 12 files up to date"
+"$work/rebuilt" "$work/Pong" > "$work/output"
+check "rebuilt compiler again" "12 of 12 files up to date"
+
+if [ $fail -eq 0 ]; then
+    echo "cache_test: OK"
+fi
+exit $fail
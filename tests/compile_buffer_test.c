@@ -0,0 +1,70 @@
+/*
+* In-memory compile API test.
+*
+* Hands compile_jack_buffer() sources that aren't a class, including an
+* empty one, and classes cut off partway through, and checks that each
+* fails with a diagnostic instead of stopping or hanging the program, then
+* that a real class still compiles.
+*
+* Build from the repository root:
+*   gcc -std=c99 -D_DEFAULT_SOURCE -I. tests/compile_buffer_test.c jackcompiler.c jacktokenizer.c jacksource.c
+*       charscan.c interner.c symboltable.c tokenizerengine.c compilationengine.c syntaxtree.c codegenerator.c
+*       constantfolder.c vmwriter.c peephole.c arena.c xmlwriter.c compilestats.c -o compile_buffer_test
+* Run:
+*   ./compile_buffer_test
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "../jackcompiler.h"
+
+static int failures = 0;
+
+/*
+* Compiles source into every output and checks whether it succeeded as
+* expected and, if not, that the diagnostics mention expected.
+*/
+static void check_compile(const char* description, const char* source, bool shouldsucceed, const char* expected)
+{
+    jackrequest request;
+    jackresult result;
+    initialize_jack_request(&request, "Test.jack", source, strlen(source));
+    request.outputs = OUT_VM | OUT_XML | OUT_TREE;
+    bool succeeded = compile_jack_buffer(&request, &result);
+
+    if (succeeded != shouldsucceed)
+    {
+        fprintf(stderr, "FAIL: %s: compile %s\n", description, succeeded ? "succeeded" : "failed");
+        failures++;
+    }
+    else if (!shouldsucceed && (result.diagnostics.data == NULL || strstr(result.diagnostics.data, expected) == NULL))
+    {
+        fprintf(stderr, "FAIL: %s: diagnostics don't mention \"%s\": %s", description, expected,
+            (result.diagnostics.data != NULL) ? result.diagnostics.data : "(none)\n");
+        failures++;
+    }
+    else if (shouldsucceed && (result.vm.data == NULL || strstr(result.vm.data, expected) == NULL))
+    {
+        fprintf(stderr, "FAIL: %s: VM code doesn't contain \"%s\"\n", description, expected);
+        failures++;
+    }
+    free_jack_result(&result);
+}
+
+int main(void)
+{
+    check_compile("empty source", "", false, "Unexpected end of file, expected 'class'");
+    check_compile("only a comment", "// nothing here\n", false, "Unexpected end of file, expected 'class'");
+    check_compile("no class", "function void f() { return; }", false, "Unexpected token 'function', expected 'class'");
+    check_compile("truncated field list", "class Test { field int x", false, "Unexpected end of file");
+    check_compile("truncated parameter list", "class Test { function void f(int a, int b", false, "Unexpected end of file");
+    check_compile("truncated local list", "class Test { function void f() { var int i, j", false, "Unexpected end of file");
+    check_compile("truncated call", "class Test { function void f() { do Output.printInt(1,", false, "Unexpected end of file");
+    check_compile("a class", "class Test { function int f() { return 1; } }", true, "function Test.f 0");
+
+    if (failures == 0)
+    {
+        printf("compile_buffer_test: OK\n");
+    }
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#!/bin/sh
+#
+# Linker test.
+#
+# Links a directory of hand-written .vm files and compares the result with
+# what it should be: unreachable functions dropped, statics moved past the
+# classes before them, comments and indentation gone. Then checks that a
+# line with more words than any VM command is rejected rather than run
+# into the next line, that a file may end without a newline, and that a
+# static index has to be a number.
+#
+# Run from the repository root:
+#   sh tests/link_test.sh
+
+set -e
+CFLAGS="-std=c99 -D_POSIX_C_SOURCE=200809L -D_DEFAULT_SOURCE -O2"
+work=$(mktemp -d "${TMPDIR:-/tmp}/linktestXXXXXX") # no "." in it, see the notes in main.c
+trap 'rm -rf "$work"' EXIT
+
+cc $CFLAGS *.c -o "$work/compiler" -lpthread
+mkdir "$work/src"
+cat > "$work/src/Main.vm" <<'VM'
+// Main.main uses Foo.used but not Foo.unused
+function Main.main 0
+    push constant 3   // an argument
+    call Foo.used 1
+    pop static 1
+    push static 1
+    return
+VM
+cat > "$work/src/Foo.vm" <<'VM'
+function Foo.unused 0
+push static 2
+return
+function Foo.used 0
+push argument 0
+pop static 0
+call Math.abs 1
+return
+VM
+cat > "$work/expected.vm" <<'VM'
+function Foo.used 0
+push argument 0
+pop static 0
+call Math.abs 1
+return
+function Main.main 0
+push constant 3
+call Foo.used 1
+pop static 4
+push static 4
+return
+VM
+
+fail=0
+if ! "$work/compiler" "$work/src" --link "$work/linked.vm" > "$work/output" 2>&1; then
+    echo "FAIL: linking failed:"
+    cat "$work/output"
+    fail=1
+elif ! cmp -s "$work/linked.vm" "$work/expected.vm"; then
+    echo "FAIL: linked program differs from what was expected:"
+    diff "$work/expected.vm" "$work/linked.vm" || true
+    fail=1
+elif ! grep -q "calls outside the directory: Math.abs" "$work/output"; then
+    echo "FAIL: the report doesn't list the call to Math.abs"
+    fail=1
+fi
+
+echo "push constant 1 2" >> "$work/src/Foo.vm"
+echo "return" >> "$work/src/Foo.vm"
+rm -f "$work/linked.vm"
+if "$work/compiler" "$work/src" --link "$work/linked.vm" > "$work/output" 2>&1; then
+    echo "FAIL: a line with four words was linked"
+    fail=1
+elif ! grep -q "Foo.vm line 9: more than 3 words" "$work/output"; then
+    echo "FAIL: the error doesn't point at the line with four words:"
+    cat "$work/output"
+    fail=1
+elif [ -e "$work/linked.vm" ]; then
+    echo "FAIL: a linked program was written anyway"
+    fail=1
+fi
+
+# the last command has no newline after it, so its index ends the file
+mkdir "$work/unterminated"
+printf 'function Main.main 0\npush static 0\npop static 1\nreturn\n' > "$work/unterminated/Main.vm"
+printf 'function Sys.init 0\ncall Main.main 0\npush static 1' > "$work/unterminated/Sys.vm"
+if ! "$work/compiler" "$work/unterminated" --link "$work/linked.vm" > "$work/output" 2>&1; then
+    echo "FAIL: a file without a final newline wasn't linked:"
+    cat "$work/output"
+    fail=1
+elif [ "$(tail -n 1 "$work/linked.vm")" != "push static 3" ]; then
+    echo "FAIL: the last command of a file without a final newline came out as \"$(tail -n 1 "$work/linked.vm")\""
+    fail=1
+fi
+
+mkdir "$work/badindex"
+printf 'function Main.main 0\npush constant 0\npop static x1\nreturn\n' > "$work/badindex/Main.vm"
+if "$work/compiler" "$work/badindex" --link "$work/linked.vm" > "$work/output" 2>&1; then
+    echo "FAIL: a static index that isn't a number was linked"
+    fail=1
+elif ! grep -q "Main.vm line 3: 'x1' is not a static index" "$work/output"; then
+    echo "FAIL: the error doesn't point at the bad static index:"
+    cat "$work/output"
+    fail=1
+fi
+
+if [ $fail -eq 0 ]; then
+    echo "link_test: OK"
+fi
+exit $fail
@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Watch mode test.
+#
+# Pauses a watching compiler, saves more .jack files than fit the initial
+# list of changed files, resumes it and checks that every one of them is
+# rebuilt, even though they all arrive in the same few batches of events.
+#
+# Run from the repository root (Linux only, as watch mode uses inotify):
+#   sh tests/watch_test.sh
+
+set -e
+CFLAGS="-std=c99 -D_POSIX_C_SOURCE=200809L -D_DEFAULT_SOURCE -O2"
+NUMFILES=100 # more than INITIAL_PENDING_FILES in watchmode.c
+work=$(mktemp -d "${TMPDIR:-/tmp}/watchtestXXXXXX") # no "." in it, see the notes in main.c
+watcher=
+trap '[ -n "$watcher" ] && kill -9 $watcher 2>/dev/null; rm -rf "$work"' EXIT
+
+cc $CFLAGS *.c -o "$work/compiler" -lpthread
+mkdir "$work/src"
+echo "class Main { function void main() { return; } }" > "$work/src/Main.jack"
+
+"$work/compiler" --watch "$work/src" > "$work/output" 2>&1 &
+watcher=$!
+tries=0
+until grep -q "Watching" "$work/output"; do
+    tries=$((tries + 1))
+    if [ $tries -gt 100 ]; then
+        echo "FAIL: the compiler never started watching"
+        exit 1
+    fi
+    sleep 0.1
+done
+
+kill -STOP $watcher
+i=0
+while [ $i -lt $NUMFILES ]; do
+    echo "class C$i { function int f() { return $i; } }" > "$work/src/C$i.jack"
+    i=$((i + 1))
+done
+kill -CONT $watcher
+
+tries=0
+while [ "$(ls "$work/src" | grep -c '^C[0-9]*\.vm$')" -lt $NUMFILES ] && [ $tries -lt 100 ]; do
+    tries=$((tries + 1))
+    sleep 0.1
+done
+kill -INT $watcher
+wait $watcher || true
+watcher=
+
+built=$(ls "$work/src" | grep -c '^C[0-9]*\.vm$' || true)
+if [ "$built" -ne $NUMFILES ]; then
+    echo "FAIL: $built of $NUMFILES saved files were rebuilt"
+    exit 1
+fi
+echo "watch_test: OK"
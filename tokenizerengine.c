@@ -18,47 +18,48 @@
 * print & get are called together so frequently it would be helpful to make a
 * print_and_get_next() function that calls both. Maybe call it tokenize_token()?
 */
-void tokenize_class(token* t, FILE* infile, FILE* outfile, int* linenum, symboltable* classtable, symboltable* subtable)
+void tokenize_class(token* t, tokenstream* ts, xmlwriter* xml, symboltable* classtable, symboltable* subtable)
 {
     assert (t->key == K_CLASS); // DEBUG
 
     if (t->key != K_CLASS)
     {
-        fprintf(stderr, "line %d: Unexpected token '%s', expected 'class'\n", *linenum, t->name); // TODO: add filename to this message
+        report_error(ts, "line %u: Unexpected token '%.*s', expected 'class'", t->linenum, (int)t->length, t->start);
     }
     else
     {
         int indentstart = 0;
         int* indent = &indentstart;
-        fprintf(outfile, "%*s<class>\n", *indent, "");
+        write_xml_open_tag(xml, XT_CLASS, *indent);
         (*indent) += INDENT_WIDTH;
 
-        print_terminal_with_tags(t, classtable, outfile, indent);
-        get_next_token(t, infile, linenum);
-        print_terminal_with_tags(t, classtable, outfile, indent);
-        get_next_token(t, infile, linenum);
-        print_terminal_with_tags(t, classtable, outfile, indent); // '{'
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, classtable, xml, indent);
+        get_next_token(t, ts);
+        print_terminal_with_tags(t, classtable, xml, indent);
+        get_next_token(t, ts);
+        print_terminal_with_tags(t, classtable, xml, indent); // '{'
+        get_next_token(t, ts);
 
         while(t->key == K_STATIC || t->key == K_FIELD)
         {
-            tokenize_class_var_dec(t, infile, outfile, linenum, indent, classtable);
+            tokenize_class_var_dec(t, ts, xml, indent, classtable);
         }
         while(t->key == K_CONSTRUCTOR || t->key == K_FUNCTION || t->key == K_METHOD || t->key == K_VOID)
         {
-            tokenize_subroutine(t, infile, outfile, linenum, indent, subtable);
+            tokenize_subroutine(t, ts, xml, indent, subtable);
         }
-        print_terminal_with_tags(t, classtable, outfile, indent); // '}'
+        reached_end_of_file(t, ts); // wherever a truncated class ends, the parser runs out here
+        print_terminal_with_tags(t, classtable, xml, indent); // '}'
 
         (*indent) -= INDENT_WIDTH;
-        fprintf(outfile, "%*s</class>\n", *indent, "");
+        write_xml_close_tag(xml, XT_CLASS, *indent);
     }
 }
 
 
-void tokenize_class_var_dec(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_class_var_dec(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
-    fprintf(outfile, "%*s<classVarDec>\n", *indent, "");
+    write_xml_open_tag(xml, XT_CLASS_VAR_DEC, *indent);
     (*indent) += INDENT_WIDTH;
     if (t->key == K_STATIC)
     {
@@ -70,140 +71,140 @@ void tokenize_class_var_dec(token* t, FILE* infile, FILE* outfile, int* linenum,
     }
     t->symboldata->is_being_defined = true;
 
-    print_terminal_with_tags(t, st, outfile, indent); // field or static
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // field or static
+    get_next_token(t, ts);
 
-    strcpy(t->symboldata->type, t->name);
+    t->symboldata->type = t->nameatom;
 
-    print_terminal_with_tags(t, st, outfile, indent); // type
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // type
+    get_next_token(t, ts);
 
-    while( !(t->type == T_SYMBOL && get_symbol(t) == ';') )
+    while( !(t->type == T_SYMBOL && get_symbol(t) == ';') && !reached_end_of_file(t, ts) )
     {
-        print_terminal_with_tags(t, st, outfile, indent);
+        print_terminal_with_tags(t, st, xml, indent);
         copy_symboldata_into_symbol_table(t, st);
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
 
     t->symboldata->is_being_defined = false;
     t->symboldata->kind = SK_NONE;
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</classVarDec>\n", *indent, "");
+    write_xml_close_tag(xml, XT_CLASS_VAR_DEC, *indent);
 }
 
 
-void tokenize_subroutine(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_subroutine(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
-    fprintf(outfile, "%*s<subroutineDec>\n", *indent, "");
+    write_xml_open_tag(xml, XT_SUBROUTINE_DEC, *indent);
     (*indent) += INDENT_WIDTH;
 
     start_subroutine(st); // clear symboltable for each subroutine
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    print_terminal_with_tags(t, st, outfile, indent); // '('
-    get_next_token(t, infile, linenum);
-    tokenize_parameter_list(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent); // ')'
-    get_next_token(t, infile, linenum);
-    fprintf(outfile, "%*s<subroutineBody>\n", *indent, "");
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    print_terminal_with_tags(t, st, xml, indent); // '('
+    get_next_token(t, ts);
+    tokenize_parameter_list(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent); // ')'
+    get_next_token(t, ts);
+    write_xml_open_tag(xml, XT_SUBROUTINE_BODY, *indent);
     (*indent) += INDENT_WIDTH;
 
-    print_terminal_with_tags(t, st, outfile, indent); // '{'
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // '{'
+    get_next_token(t, ts);
     while (t->key == K_VAR)
     {
-        tokenize_var_dec(t, infile, outfile, linenum, indent, st);
+        tokenize_var_dec(t, ts, xml, indent, st);
     }
     if (is_statement(t))
     {
-        tokenize_statements(t, infile, outfile, linenum, indent, st);
+        tokenize_statements(t, ts, xml, indent, st);
     }
-    print_terminal_with_tags(t, st, outfile, indent); // '}'
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // '}'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</subroutineBody>\n", *indent, "");
+    write_xml_close_tag(xml, XT_SUBROUTINE_BODY, *indent);
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</subroutineDec>\n", *indent, "");
+    write_xml_close_tag(xml, XT_SUBROUTINE_DEC, *indent);
 }
 
 
-void tokenize_parameter_list(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_parameter_list(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
-    fprintf(outfile, "%*s<parameterList>\n", *indent, "");
+    write_xml_open_tag(xml, XT_PARAMETER_LIST, *indent);
     (*indent) += INDENT_WIDTH;
     t->symboldata->kind = SK_ARG;
 
-    while ( !(t->type == T_SYMBOL && get_symbol(t) == ')'))
+    while ( !(t->type == T_SYMBOL && get_symbol(t) == ')') && !reached_end_of_file(t, ts) )
     {
-        strcpy(t->symboldata->type, t->name);
+        t->symboldata->type = t->nameatom;
 
-        print_terminal_with_tags(t, st, outfile, indent); // type
-        get_next_token(t, infile, linenum);
-        print_terminal_with_tags(t, st, outfile, indent); // name
+        print_terminal_with_tags(t, st, xml, indent); // type
+        get_next_token(t, ts);
+        print_terminal_with_tags(t, st, xml, indent); // name
         copy_symboldata_into_symbol_table(t, st);
 
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
 
         if (t->type == T_SYMBOL && get_symbol(t) == ',')
         {
-            print_terminal_with_tags(t, st, outfile, indent);
-            get_next_token(t, infile, linenum);
+            print_terminal_with_tags(t, st, xml, indent);
+            get_next_token(t, ts);
         }
     }
 
     t->symboldata->kind = SK_NONE;
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</parameterList>\n", *indent, "");
+    write_xml_close_tag(xml, XT_PARAMETER_LIST, *indent);
 }
 
 
-void tokenize_var_dec(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_var_dec(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     assert(t->key == K_VAR); // DEBUG
 
-    fprintf(outfile, "%*s<varDec>\n", *indent, "");
+    write_xml_open_tag(xml, XT_VAR_DEC, *indent);
     (*indent) += INDENT_WIDTH;
     t->symboldata->kind = SK_VAR;
     t->symboldata->is_being_defined = true;
 
-    print_terminal_with_tags(t, st, outfile, indent); // var
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // var
+    get_next_token(t, ts);
 
-    strcpy(t->symboldata->type, t->name);
+    t->symboldata->type = t->nameatom;
 
-    print_terminal_with_tags(t, st, outfile, indent); // type
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // type
+    get_next_token(t, ts);
 
-    while ( !(t->type == T_SYMBOL && get_symbol(t) == ';') )
+    while ( !(t->type == T_SYMBOL && get_symbol(t) == ';') && !reached_end_of_file(t, ts) )
     {
-        print_terminal_with_tags(t, st, outfile, indent);
+        print_terminal_with_tags(t, st, xml, indent);
         copy_symboldata_into_symbol_table(t, st);
-        get_next_token(t, infile, linenum);
+        get_next_token(t, ts);
     }
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
 
     t->symboldata->is_being_defined = false;
     t->symboldata->kind = SK_NONE;
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</varDec>\n", *indent, "");
+    write_xml_close_tag(xml, XT_VAR_DEC, *indent);
 }
 
 
-void tokenize_statements(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_statements(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     // assert(is_statement(t)); // DEBUG, currently this will cause an abort for empty while blocks
 
-    fprintf(outfile, "%*s<statements>\n", *indent, "");
+    write_xml_open_tag(xml, XT_STATEMENTS, *indent);
     (*indent) += INDENT_WIDTH;
 
     while (is_statement(t))
@@ -211,261 +212,261 @@ void tokenize_statements(token* t, FILE* infile, FILE* outfile, int* linenum, in
         // K_ELSE is handled in tokenize_if() and not included here
         if (t->key == K_LET)
         {
-            tokenize_let(t, infile, outfile, linenum, indent, st);
+            tokenize_let(t, ts, xml, indent, st);
         }
         else if (t->key == K_IF)
         {
-            tokenize_if(t, infile, outfile, linenum, indent, st);
+            tokenize_if(t, ts, xml, indent, st);
         }
         else if (t->key == K_WHILE)
         {
-            tokenize_while(t, infile, outfile, linenum, indent, st);
+            tokenize_while(t, ts, xml, indent, st);
         }
         else if (t->key == K_DO)
         {
-            tokenize_do(t, infile, outfile, linenum, indent, st);
+            tokenize_do(t, ts, xml, indent, st);
         }
         else if (t->key == K_RETURN)
         {
-            tokenize_return(t, infile, outfile, linenum, indent, st);
+            tokenize_return(t, ts, xml, indent, st);
         }
     }
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</statements>\n", *indent, "");
+    write_xml_close_tag(xml, XT_STATEMENTS, *indent);
 }
 
 
-void tokenize_do(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_do(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     assert(t->key == K_DO); // DEBUG
 
-    fprintf(outfile, "%*s<doStatement>\n", *indent, "");
+    write_xml_open_tag(xml, XT_DO_STATEMENT, *indent);
     (*indent) += INDENT_WIDTH;
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    tokenize_subroutine_call(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    tokenize_subroutine_call(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</doStatement>\n", *indent, "");
+    write_xml_close_tag(xml, XT_DO_STATEMENT, *indent);
 }
 
 
-void tokenize_let(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_let(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     assert(t->key == K_LET); // DEBUG
 
-    fprintf(outfile, "%*s<letStatement>\n", *indent, "");
+    write_xml_open_tag(xml, XT_LET_STATEMENT, *indent);
     (*indent) += INDENT_WIDTH;
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
     if (t->type == T_SYMBOL && get_symbol(t) == '[')
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        tokenize_expression(t, infile, outfile, linenum, indent, st);
-        print_terminal_with_tags(t, st, outfile, indent); // ']'
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        tokenize_expression(t, ts, xml, indent, st);
+        print_terminal_with_tags(t, st, xml, indent); // ']'
+        get_next_token(t, ts);
     }
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    tokenize_expression(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    tokenize_expression(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</letStatement>\n", *indent, "");
+    write_xml_close_tag(xml, XT_LET_STATEMENT, *indent);
 }
 
 
-void tokenize_while(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_while(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     assert(t->key == K_WHILE); // DEBUG
 
-    fprintf(outfile, "%*s<whileStatement>\n", *indent, "");
+    write_xml_open_tag(xml, XT_WHILE_STATEMENT, *indent);
     (*indent) += INDENT_WIDTH;
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
     if (t->type == T_SYMBOL && get_symbol(t) == '(')
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        tokenize_expression(t, infile, outfile, linenum, indent, st);
-        print_terminal_with_tags(t, st, outfile, indent); // ')'
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        tokenize_expression(t, ts, xml, indent, st);
+        print_terminal_with_tags(t, st, xml, indent); // ')'
+        get_next_token(t, ts);
     }
-    print_terminal_with_tags(t, st, outfile, indent); // '{'
-    get_next_token(t, infile, linenum);
-    tokenize_statements(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent); // '}'
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // '{'
+    get_next_token(t, ts);
+    tokenize_statements(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent); // '}'
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</whileStatement>\n", *indent, "");
+    write_xml_close_tag(xml, XT_WHILE_STATEMENT, *indent);
 }
 
 
-void tokenize_return(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_return(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     assert(t->key == K_RETURN); // DEBUG
 
-    fprintf(outfile, "%*s<returnStatement>\n", *indent, "");
+    write_xml_open_tag(xml, XT_RETURN_STATEMENT, *indent);
     (*indent) += INDENT_WIDTH;
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
     if ( !(t->type == T_SYMBOL && get_symbol(t) == ';') )
     {
-        tokenize_expression(t, infile, outfile, linenum, indent, st);
+        tokenize_expression(t, ts, xml, indent, st);
     }
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</returnStatement>\n", *indent, "");
+    write_xml_close_tag(xml, XT_RETURN_STATEMENT, *indent);
 }
 
 
-void tokenize_if(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_if(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     assert(t->key == K_IF); // DEBUG
 
-    fprintf(outfile, "%*s<ifStatement>\n", *indent, "");
+    write_xml_open_tag(xml, XT_IF_STATEMENT, *indent);
     (*indent) += INDENT_WIDTH;
 
-    print_terminal_with_tags(t, st, outfile, indent);
-    get_next_token(t, infile, linenum);
-    print_terminal_with_tags(t, st, outfile, indent); // '('
-    get_next_token(t, infile, linenum);
-    tokenize_expression(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent); // ')'
-    get_next_token(t, infile, linenum);
-    print_terminal_with_tags(t, st, outfile, indent); // '{'
-    get_next_token(t, infile, linenum);
-    tokenize_statements(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent); // '}'
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent);
+    get_next_token(t, ts);
+    print_terminal_with_tags(t, st, xml, indent); // '('
+    get_next_token(t, ts);
+    tokenize_expression(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent); // ')'
+    get_next_token(t, ts);
+    print_terminal_with_tags(t, st, xml, indent); // '{'
+    get_next_token(t, ts);
+    tokenize_statements(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent); // '}'
+    get_next_token(t, ts);
     if (t->key == K_ELSE)
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        print_terminal_with_tags(t, st, outfile, indent); // '{'
-        get_next_token(t, infile, linenum);
-        tokenize_statements(t, infile, outfile, linenum, indent, st);
-        print_terminal_with_tags(t, st, outfile, indent); // '}'
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        print_terminal_with_tags(t, st, xml, indent); // '{'
+        get_next_token(t, ts);
+        tokenize_statements(t, ts, xml, indent, st);
+        print_terminal_with_tags(t, st, xml, indent); // '}'
+        get_next_token(t, ts);
     }
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</ifStatement>\n", *indent, "");
+    write_xml_close_tag(xml, XT_IF_STATEMENT, *indent);
 }
 
 
-void tokenize_expression(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_expression(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
-    fprintf(outfile, "%*s<expression>\n", *indent, "");
+    write_xml_open_tag(xml, XT_EXPRESSION, *indent);
     (*indent) += INDENT_WIDTH;
 
-    tokenize_term(t, infile, outfile, linenum, indent, st);
+    tokenize_term(t, ts, xml, indent, st);
     while (is_binary_operator(t))
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        tokenize_term(t, infile, outfile, linenum, indent, st);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        tokenize_term(t, ts, xml, indent, st);
     }
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</expression>\n", *indent, "");
+    write_xml_close_tag(xml, XT_EXPRESSION, *indent);
 }
 
 
-void tokenize_term(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_term(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
-    fprintf(outfile, "%*s<term>\n", *indent, "");
+    write_xml_open_tag(xml, XT_TERM, *indent);
     (*indent) += INDENT_WIDTH;
 
-    char nextchar = peek_at_next_token_start(infile, linenum);
+    char nextchar = peek_at_next_token_start(ts);
 
     if (nextchar == '[')
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        print_terminal_with_tags(t, st, outfile, indent); // '['
-        get_next_token(t, infile, linenum);
-        tokenize_expression(t, infile, outfile, linenum, indent, st);
-        print_terminal_with_tags(t, st, outfile, indent); // ']'
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        print_terminal_with_tags(t, st, xml, indent); // '['
+        get_next_token(t, ts);
+        tokenize_expression(t, ts, xml, indent, st);
+        print_terminal_with_tags(t, st, xml, indent); // ']'
+        get_next_token(t, ts);
     }
     else if (t->type == T_SYMBOL && get_symbol(t) == '(')
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        tokenize_expression(t, infile, outfile, linenum, indent, st);
-        print_terminal_with_tags(t, st, outfile, indent); // ')'
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        tokenize_expression(t, ts, xml, indent, st);
+        print_terminal_with_tags(t, st, xml, indent); // ')'
+        get_next_token(t, ts);
     }
     else if (is_unary_operator(t))
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
-        tokenize_term(t, infile, outfile, linenum, indent, st);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
+        tokenize_term(t, ts, xml, indent, st);
     }
     else if (nextchar == '.' || nextchar == '(')
     {
         // beware of catching nested expressions, e.g. ((a+2)-1), with this condition
         // also, unary operators with parentheses, e.g. -(a+3)
         // shouldn't happen due to order of ifs, but maybe put in an explicit check
-        tokenize_subroutine_call(t, infile, outfile, linenum, indent, st);
+        tokenize_subroutine_call(t, ts, xml, indent, st);
     }
     else
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
     }
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</term>\n", *indent, "");
+    write_xml_close_tag(xml, XT_TERM, *indent);
 }
 
 
-void tokenize_expression_list(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_expression_list(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
-    fprintf(outfile, "%*s<expressionList>\n", *indent, "");
+    write_xml_open_tag(xml, XT_EXPRESSION_LIST, *indent);
     (*indent) += INDENT_WIDTH;
 
     if ( !(t->type == T_SYMBOL && get_symbol(t) == ')')) // make sure it's not an empty expressionList, e.g. ()
     {
-        tokenize_expression(t, infile, outfile, linenum, indent, st);
+        tokenize_expression(t, ts, xml, indent, st);
         while (t->type == T_SYMBOL && get_symbol(t) == ',')
         {
-            print_terminal_with_tags(t, st, outfile, indent);
-            get_next_token(t, infile, linenum);
-            tokenize_expression(t, infile, outfile, linenum, indent, st);
+            print_terminal_with_tags(t, st, xml, indent);
+            get_next_token(t, ts);
+            tokenize_expression(t, ts, xml, indent, st);
         }
     }
 
     (*indent) -= INDENT_WIDTH;
-    fprintf(outfile, "%*s</expressionList>\n", *indent, "");
+    write_xml_close_tag(xml, XT_EXPRESSION_LIST, *indent);
 }
 
 
-void tokenize_subroutine_call(token* t, FILE* infile, FILE* outfile, int* linenum, int* indent, symboltable* st)
+void tokenize_subroutine_call(token* t, tokenstream* ts, xmlwriter* xml, int* indent, symboltable* st)
 {
     // this is a helper function for tokenize_do() and tokenize_term(), so no <tags> are needed
-    while ( !(t->type == T_SYMBOL && get_symbol(t) == '(') )
+    while ( !(t->type == T_SYMBOL && get_symbol(t) == '(') && !reached_end_of_file(t, ts) )
     {
-        print_terminal_with_tags(t, st, outfile, indent);
-        get_next_token(t, infile, linenum);
+        print_terminal_with_tags(t, st, xml, indent);
+        get_next_token(t, ts);
     }
-    print_terminal_with_tags(t, st, outfile, indent); // '('
-    get_next_token(t, infile, linenum);
-    tokenize_expression_list(t, infile, outfile, linenum, indent, st);
-    print_terminal_with_tags(t, st, outfile, indent); // ')'
-    get_next_token(t, infile, linenum);
+    print_terminal_with_tags(t, st, xml, indent); // '('
+    get_next_token(t, ts);
+    tokenize_expression_list(t, ts, xml, indent, st);
+    print_terminal_with_tags(t, st, xml, indent); // ')'
+    get_next_token(t, ts);
 }
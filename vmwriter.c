@@ -1,84 +1,343 @@
 #include "vmwriter.h"
+#include <stdlib.h>
+#include <string.h>
+#include "peephole.h"
+
+#define MAX_INT_DIGITS 11 // "-2147483648"
+
+// a string literal along with its length, so appending it is a single memcpy()
+typedef struct vmtext
+{
+    const char* text;
+    size_t length;
+} vmtext;
+
+#define VMTEXT(s) { s, sizeof(s) - 1 }
+
+// indexed by vmsegment
+static const vmtext pushprefixes[] =
+{
+    VMTEXT("push NONE "), VMTEXT("push constant "), VMTEXT("push argument "), VMTEXT("push local "),
+    VMTEXT("push static "), VMTEXT("push this "), VMTEXT("push that "), VMTEXT("push pointer "), VMTEXT("push temp ")
+};
+
+static const vmtext popprefixes[] =
+{
+    VMTEXT("pop NONE "), VMTEXT("pop constant "), VMTEXT("pop argument "), VMTEXT("pop local "),
+    VMTEXT("pop static "), VMTEXT("pop this "), VMTEXT("pop that "), VMTEXT("pop pointer "), VMTEXT("pop temp ")
+};
+
+// indexed by vmcommand, each including its newline
+static const vmtext arithmeticlines[] =
+{
+    VMTEXT("NONE\n"), VMTEXT("add\n"), VMTEXT("sub\n"), VMTEXT("neg\n"), VMTEXT("eq\n"), VMTEXT("gt\n"),
+    VMTEXT("lt\n"), VMTEXT("and\n"), VMTEXT("or\n"), VMTEXT("not\n"),
+    VMTEXT("call Math.multiply 2\n"), VMTEXT("call Math.divide 2\n")
+};
+
+
+void initialize_vm_buffer(vmbuffer* vm)
+{
+    vm->data = NULL;
+    vm->length = 0;
+    vm->capacity = 0;
+    vm->instructions = 0;
+    vm->peephole = NULL;
+}
+
+void free_vm_buffer(vmbuffer* vm)
+{
+    free(vm->data);
+    initialize_vm_buffer(vm);
+}
+
+
+/*
+* Makes sure at least extra more bytes fit, growing the buffer geometrically.
+* Returns where the next byte goes.
+*/
+static char* reserve_vm_space(vmbuffer* vm, size_t extra)
+{
+    if (vm->length + extra > vm->capacity)
+    {
+        size_t newcapacity = (vm->capacity == 0) ? INITIAL_VM_BUFFER_SIZE : vm->capacity * 2;
+        while (vm->length + extra > newcapacity)
+        {
+            newcapacity *= 2;
+        }
+        char* temp = realloc(vm->data, newcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for VM buffer\n");
+            exit(1);
+        }
+        vm->data = temp;
+        vm->capacity = newcapacity;
+    }
+    return vm->data + vm->length;
+}
+
+
+/*
+* Formats n in decimal at dest and returns the number of chars written.
+*/
+static size_t format_int(char* dest, int n)
+{
+    char digits[MAX_INT_DIGITS];
+    size_t count = 0;
+    size_t length = 0;
+    unsigned int value = (unsigned int)n;
+    if (n < 0)
+    {
+        dest[length++] = '-';
+        value = 0u - value;
+    }
+    do
+    {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0)
+    {
+        dest[length++] = digits[--count];
+    }
+    return length;
+}
+
+
+/*
+* Appends "<prefix><number>\n"; every command that ends in an integer goes through here.
+*/
+static void append_command_with_int(vmbuffer* vm, const char* prefix, size_t prefixlength, int n)
+{
+    char* dest = reserve_vm_space(vm, prefixlength + MAX_INT_DIGITS + 1);
+    memcpy(dest, prefix, prefixlength);
+    size_t length = prefixlength + format_int(dest + prefixlength, n);
+    dest[length++] = '\n';
+    vm->length += length;
+}
+
+
+/*
+* Appends "<command> <name>" with no line ending, for the commands that take a label or function name.
+*/
+static void append_command_with_name(vmbuffer* vm, const char* command, size_t commandlength, const char* name)
+{
+    size_t namelength = strlen(name);
+    char* dest = reserve_vm_space(vm, commandlength + namelength + MAX_INT_DIGITS + 2); // room for " <int>\n" too
+    memcpy(dest, command, commandlength);
+    memcpy(dest + commandlength, name, namelength);
+    vm->length += commandlength + namelength;
+}
+
+
+/*
+* Hands instruction to the peephole pass if there is one. Returns false if
+* it should be written out as text now instead.
+*/
+static bool buffer_vm_instruction(vmbuffer* vm, vmopcode op, int arg, int index, const char* label)
+{
+    if (vm->peephole == NULL)
+    {
+        return false;
+    }
+
+    vminstruction instruction;
+    instruction.op = op;
+    instruction.arg = arg;
+    instruction.index = index;
+    instruction.label[0] = '\0';
+    if (label != NULL)
+    {
+        if (strlen(label) >= sizeof(instruction.label))
+        {
+            flush_peephole(vm->peephole, vm); // too long to hold, so nothing before it may be held either
+            return false;
+        }
+        strcpy(instruction.label, label);
+    }
+    add_to_peephole(vm->peephole, vm, &instruction);
+    return true;
+}
+
+
+static void append_push(vmbuffer* vm, vmsegment segment, int index)
+{
+    vm->instructions++;
+    append_command_with_int(vm, pushprefixes[segment].text, pushprefixes[segment].length, index);
+}
+
+static void append_pop(vmbuffer* vm, vmsegment segment, int index)
+{
+    vm->instructions++;
+    append_command_with_int(vm, popprefixes[segment].text, popprefixes[segment].length, index);
+}
+
+static void append_arithmetic(vmbuffer* vm, vmcommand command)
+{
+    vm->instructions++;
+    char* dest = reserve_vm_space(vm, arithmeticlines[command].length);
+    memcpy(dest, arithmeticlines[command].text, arithmeticlines[command].length);
+    vm->length += arithmeticlines[command].length;
+}
+
+static void append_label_command(vmbuffer* vm, const char* command, size_t commandlength, const char* label)
+{
+    vm->instructions++;
+    append_command_with_name(vm, command, commandlength, label);
+    vm->data[vm->length++] = '\n';
+}
+
+static void append_return(vmbuffer* vm)
+{
+    vm->instructions++;
+    char* dest = reserve_vm_space(vm, 7);
+    memcpy(dest, "return\n", 7);
+    vm->length += 7;
+}
 
 
 /*
 * Writes a VM push command.
 */
-void write_push(FILE* outfile, vmsegment segment, int index)
+void write_push(vmbuffer* vm, vmsegment segment, int index)
 {
-    fprintf(outfile, "push %s %d\n", convert_vmsegment_to_string(segment), index);
+    if (!buffer_vm_instruction(vm, VMO_PUSH, segment, index, NULL))
+    {
+        append_push(vm, segment, index);
+    }
 }
 
 
 /*
 *  Writes a VM pop command.
 */
-void write_pop(FILE* outfile, vmsegment segment, int index)
+void write_pop(vmbuffer* vm, vmsegment segment, int index)
 {
-    fprintf(outfile, "pop %s %d\n", convert_vmsegment_to_string(segment), index);
+    if (!buffer_vm_instruction(vm, VMO_POP, segment, index, NULL))
+    {
+        append_pop(vm, segment, index);
+    }
 }
 
 
 /*
 *  Writes a VM arithmetic command.
 */
-void write_arithmetic(FILE* outfile, vmcommand command)
+void write_arithmetic(vmbuffer* vm, vmcommand command)
 {
-    fprintf(outfile, "%s\n", convert_vmcommand_to_string(command));
+    if (!buffer_vm_instruction(vm, VMO_ARITHMETIC, command, 0, NULL))
+    {
+        append_arithmetic(vm, command);
+    }
 }
 
 
 /*
 *  Writes a VM label command.
 */
-void write_label(FILE* outfile, const char* label)
+void write_label(vmbuffer* vm, const char* label)
 {
-    fprintf(outfile, "label %s\n", label);
+    if (!buffer_vm_instruction(vm, VMO_LABEL, 0, 0, label))
+    {
+        append_label_command(vm, "label ", 6, label);
+    }
 }
 
 
 /*
 *  Writes a VM goto command.
 */
-void write_goto(FILE* outfile, const char* label)
+void write_goto(vmbuffer* vm, const char* label)
 {
-    fprintf(outfile, "goto %s\n", label);
+    if (!buffer_vm_instruction(vm, VMO_GOTO, 0, 0, label))
+    {
+        append_label_command(vm, "goto ", 5, label);
+    }
 }
 
 
 /*
 *  Writes a VM If-goto command.
 */
-void write_if(FILE* outfile, const char* label)
+void write_if(vmbuffer* vm, const char* label)
 {
-    fprintf(outfile, "if-goto %s\n", label);
+    if (!buffer_vm_instruction(vm, VMO_IF, 0, 0, label))
+    {
+        append_label_command(vm, "if-goto ", 8, label);
+    }
 }
 
 
 /*
-*  Writes a VM call command.
+*  Writes a VM call command. Calls are never held back, so anything the
+*  peephole pass is holding goes first.
 */
-void write_call(FILE* outfile, const char* name, int numargs)
+void write_call(vmbuffer* vm, const char* name, int numargs)
 {
-    fprintf(outfile, "call %s %d\n", name, numargs);
+    if (vm->peephole != NULL)
+    {
+        flush_peephole(vm->peephole, vm);
+    }
+    vm->instructions++;
+    append_command_with_name(vm, "call ", 5, name);
+    append_command_with_int(vm, " ", 1, numargs);
 }
 
 
 /*
 *  Writes a VM function command.
 */
-void write_function(FILE* outfile, const char* name, int numlocals)
+void write_function(vmbuffer* vm, const char* name, int numlocals)
 {
-    fprintf(outfile, "function %s %d\n", name, numlocals);
+    if (vm->peephole != NULL)
+    {
+        flush_peephole(vm->peephole, vm);
+    }
+    vm->instructions++;
+    append_command_with_name(vm, "function ", 9, name);
+    append_command_with_int(vm, " ", 1, numlocals);
 }
 
 
 /*
 * Writes a VM return command.
 */
-void write_return(FILE* outfile)
+void write_return(vmbuffer* vm)
+{
+    if (!buffer_vm_instruction(vm, VMO_RETURN, 0, 0, NULL))
+    {
+        append_return(vm);
+    }
+}
+
+
+void write_vm_instruction(vmbuffer* vm, const vminstruction* instruction)
 {
-    fprintf(outfile, "return\n");
+    switch (instruction->op)
+    {
+        case VMO_PUSH:
+            append_push(vm, (vmsegment)instruction->arg, instruction->index);
+            break;
+        case VMO_POP:
+            append_pop(vm, (vmsegment)instruction->arg, instruction->index);
+            break;
+        case VMO_ARITHMETIC:
+            append_arithmetic(vm, (vmcommand)instruction->arg);
+            break;
+        case VMO_LABEL:
+            append_label_command(vm, "label ", 6, instruction->label);
+            break;
+        case VMO_GOTO:
+            append_label_command(vm, "goto ", 5, instruction->label);
+            break;
+        case VMO_IF:
+            append_label_command(vm, "if-goto ", 8, instruction->label);
+            break;
+        case VMO_RETURN:
+            append_return(vm);
+            break;
+    }
 }
 
 
@@ -2,8 +2,13 @@
 #define VMWRITER_H
 
 #include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include "symboltable.h"
 
+#define INITIAL_VM_BUFFER_SIZE 65536
+#define MAX_VM_LABEL_LENGTH 32 // longer labels are written straight out rather than buffered for the peephole pass
+
 typedef enum vmsegment
 {
     VMS_NONE, // default
@@ -33,19 +38,56 @@ typedef enum vmcommand
     VMC_DIV   // they are included here because * and / are in the list of recognized Jack operators
 } vmcommand;
 
+typedef enum vmopcode
+{
+    VMO_PUSH,
+    VMO_POP,
+    VMO_ARITHMETIC,
+    VMO_LABEL,
+    VMO_GOTO,
+    VMO_IF,
+    VMO_RETURN
+} vmopcode;
+
+// one VM command held back by the peephole pass; calls and function
+// declarations are never held back, so they have no opcode here
+typedef struct vminstruction
+{
+    vmopcode op;
+    int arg; // the vmsegment of a push or pop, or the vmcommand of an arithmetic command
+    int index; // of a push or pop
+    char label[MAX_VM_LABEL_LENGTH]; // of a label, goto or if-goto
+} vminstruction;
+
+struct peephole;
+
+// VM commands for a whole file are collected here as text and handed over
+// in one piece at the end
+typedef struct vmbuffer
+{
+    char* data;
+    size_t length;
+    size_t capacity;
+    unsigned long instructions; // commands written so far
+    struct peephole* peephole; // if not NULL, commands go through it before becoming text
+} vmbuffer;
+
 
 // book API functions
-void write_push(FILE* outfile, vmsegment segment, int index);
-void write_pop(FILE* outfile, vmsegment segment, int index);
-void write_arithmetic(FILE* outfile, vmcommand command);
-void write_label(FILE* outfile, const char* label);
-void write_goto(FILE* outfile, const char* label);
-void write_if(FILE* outfile, const char* label);
-void write_call(FILE* outfile, const char* name, int numargs);
-void write_function(FILE* outfile, const char* name, int numlocals);
-void write_return(FILE* outfile);
+void write_push(vmbuffer* vm, vmsegment segment, int index);
+void write_pop(vmbuffer* vm, vmsegment segment, int index);
+void write_arithmetic(vmbuffer* vm, vmcommand command);
+void write_label(vmbuffer* vm, const char* label);
+void write_goto(vmbuffer* vm, const char* label);
+void write_if(vmbuffer* vm, const char* label);
+void write_call(vmbuffer* vm, const char* name, int numargs);
+void write_function(vmbuffer* vm, const char* name, int numlocals);
+void write_return(vmbuffer* vm);
 
 // my functions
+void initialize_vm_buffer(vmbuffer* vm);
+void free_vm_buffer(vmbuffer* vm);
+void write_vm_instruction(vmbuffer* vm, const vminstruction* instruction); // as text, bypassing the peephole pass
 char* convert_vmcommand_to_string(vmcommand command);
 char* convert_vmsegment_to_string(vmsegment segment);
 vmcommand convert_unary_operator_to_vmcommand(char op);
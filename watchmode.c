@@ -0,0 +1,345 @@
+#include "watchmode.h"
+#include <stdio.h>
+
+#ifdef WATCHMODE_HAS_INOTIFY
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "filehandling.h"
+#include "buildcache.h"
+#include "compilestats.h"
+#include "linker.h"
+
+#define WATCH_BUFFER_SIZE 4096 // enough for dozens of events per read()
+#define WATCH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM)
+#define INITIAL_PENDING_FILES 64 // distinct files named by one batch of events; the list grows if a batch names more
+
+// one rebuild, timed
+typedef struct rebuildsample
+{
+    char* name;
+    double eventtooutput; // ms from reading the change event to closing the last output file
+    double savetooutput; // ms from the file's modification time, which the kernel stamps from a coarse clock, so it can read a few ms high
+    bool succeeded;
+} rebuildsample;
+
+// everything watch mode keeps between events
+typedef struct watchstate
+{
+    const char* directoryname;
+    const compileoptions* options;
+    buildcache hashes; // content hash of every file as last compiled, so saves that change nothing are skipped
+    rebuildsample* samples;
+    size_t count;
+    size_t capacity;
+} watchstate;
+
+static volatile sig_atomic_t stopwatching = 0;
+
+static void stop_watching(int signalnumber)
+{
+    (void)signalnumber;
+    stopwatching = 1;
+}
+
+static double milliseconds_between(const struct timespec* start, const struct timespec* end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1e3 + (double)(end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void add_sample(watchstate* state, const char* name, double eventtooutput, double savetooutput, bool succeeded)
+{
+    if (state->count == state->capacity)
+    {
+        size_t newcapacity = (state->capacity == 0) ? 64 : state->capacity * 2;
+        rebuildsample* temp = realloc(state->samples, newcapacity * sizeof(*temp));
+        if (temp == NULL)
+        {
+            fprintf(stderr, "Error: could not reallocate memory for latency samples\n");
+            exit(1);
+        }
+        state->samples = temp;
+        state->capacity = newcapacity;
+    }
+    rebuildsample* sample = &state->samples[state->count++];
+    sample->name = malloc((strlen(name) + 1) * sizeof(*(sample->name))); // +1 for NUL
+    if (sample->name == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for latency samples\n");
+        exit(1);
+    }
+    strcpy(sample->name, name);
+    sample->eventtooutput = eventtooutput;
+    sample->savetooutput = savetooutput;
+    sample->succeeded = succeeded;
+}
+
+
+/*
+* Recompiles one file of the watched directory after an event named it.
+* Deleted files are dropped from the cache, and files whose contents match
+* what was last compiled (editors often write a file twice per save) are
+* left alone as long as their outputs are still there.
+*/
+static void rebuild_file(watchstate* state, const char* name, const struct timespec* eventtime)
+{
+    size_t length = strlen(state->directoryname) + strlen(PATH_SEPARATOR) + strlen(name) + 1; // +1 for NUL
+    char* filename = malloc(length * sizeof(*filename));
+    if (filename == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for filename\n");
+        exit(1);
+    }
+    snprintf(filename, length, "%s%s%s", state->directoryname, PATH_SEPARATOR, name);
+
+    struct stat info;
+    unsigned long long hash = 0;
+    unsigned long long cachedhash = 0;
+    if (stat(filename, &info) != 0)
+    {
+        fprintf(stdout, "%s was removed\n", filename);
+        remove_cache_entry(&state->hashes, name);
+    }
+    else if (!hash_file_contents(filename, &hash))
+    {
+        fprintf(stderr, "Error: could not read %s\n", filename);
+    }
+    else if (find_cached_hash(&state->hashes, name, &cachedhash) && cachedhash == hash
+        && outputs_exist(filename, state->options->outputs))
+    {
+        // nothing to do
+    }
+    else
+    {
+        bool succeeded = compile_jack_file(filename, state->options, stdout, stderr, NULL);
+        struct timespec writtentime;
+        struct timespec writtenwalltime;
+        clock_gettime(CLOCK_MONOTONIC, &writtentime);
+        clock_gettime(CLOCK_REALTIME, &writtenwalltime);
+
+        if (succeeded)
+        {
+            set_cache_entry(&state->hashes, name, hash);
+        }
+        else
+        {
+            remove_cache_entry(&state->hashes, name); // try again on the next save
+        }
+        double eventtooutput = milliseconds_between(eventtime, &writtentime);
+        double savetooutput = milliseconds_between(&info.st_mtim, &writtenwalltime);
+        add_sample(state, name, eventtooutput, savetooutput, succeeded);
+        fprintf(stdout, "%s %s: %.2f ms from event to output (%.2f ms from save)\n", succeeded ? "Rebuilt" : "Failed",
+            filename, eventtooutput, savetooutput);
+    }
+    free(filename);
+}
+
+static int compare_doubles(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/*
+* Prints the count and the min, median, 95th percentile and max of the
+* event-to-output latencies.
+*/
+static void print_latency_summary(const watchstate* state, FILE* outfile)
+{
+    fprintf(outfile, "Watch mode: %zu rebuild%s\n", state->count, (state->count == 1) ? "" : "s");
+    if (state->count == 0)
+    {
+        return;
+    }
+
+    double* sorted = malloc(state->count * sizeof(*sorted));
+    if (sorted == NULL)
+    {
+        fprintf(stderr, "Error: could not allocate memory for latency summary\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < state->count; i++)
+    {
+        sorted[i] = state->samples[i].eventtooutput;
+    }
+    qsort(sorted, state->count, sizeof(*sorted), compare_doubles);
+    fprintf(outfile, "Event to output (ms): min %.2f, median %.2f, p95 %.2f, max %.2f\n", sorted[0],
+        sorted[state->count / 2], sorted[(state->count * 95) / 100], sorted[state->count - 1]);
+    free(sorted);
+}
+
+/*
+* Dumps every rebuild, in the order they happened, to options->latencyfile.
+*/
+static void write_latency_json(const watchstate* state)
+{
+    FILE* outfile = fopen(state->options->latencyfile, "w");
+    if (outfile == NULL)
+    {
+        fprintf(stderr, "Error: could not open %s\n", state->options->latencyfile);
+        return;
+    }
+    fprintf(outfile, "{\n  \"directory\": ");
+    write_json_string(outfile, state->directoryname);
+    fprintf(outfile, ",\n  \"rebuilds\": [");
+    for (size_t i = 0; i < state->count; i++)
+    {
+        const rebuildsample* sample = &state->samples[i];
+        fprintf(outfile, "%s\n    { \"file\": ", (i == 0) ? "" : ",");
+        write_json_string(outfile, sample->name);
+        fprintf(outfile, ", \"succeeded\": %s, \"event_to_output_ms\": %.3f, \"save_to_output_ms\": %.3f }",
+            sample->succeeded ? "true" : "false", sample->eventtooutput, sample->savetooutput);
+    }
+    fprintf(outfile, "%s]\n}\n", (state->count == 0) ? "" : "\n  ");
+    if (fclose(outfile) != 0)
+    {
+        fprintf(stderr, "Error: could not write %s\n", state->options->latencyfile);
+    }
+}
+
+
+/*
+* Reads batches of inotify events until SIGINT or SIGTERM. Each batch is
+* reduced to the distinct .jack files it names, so a save that shows up as
+* several events is only compiled once.
+*/
+bool watch_directory(const char* const directoryname, const compileoptions* options)
+{
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0 || inotify_add_watch(fd, directoryname, WATCH_EVENTS) < 0)
+    {
+        fprintf(stderr, "Error: could not watch %s\n", directoryname);
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return false;
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_watching; // no SA_RESTART, so read() returns as soon as a signal arrives
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    watchstate state;
+    state.directoryname = directoryname;
+    state.options = options;
+    state.samples = NULL;
+    state.count = 0;
+    state.capacity = 0;
+    state.hashes.entries = NULL;
+    state.hashes.count = 0;
+    state.hashes.capacity = 0;
+    state.hashes.optionskey = options_key(options);
+    if (options->usecache)
+    {
+        load_build_cache(&state.hashes, directoryname, state.hashes.optionskey);
+    }
+
+    fprintf(stdout, "Watching %s for changes, press Ctrl+C to stop...\n", directoryname);
+    fflush(stdout);
+
+    union
+    {
+        struct inotify_event event; // for alignment
+        char bytes[WATCH_BUFFER_SIZE];
+    } buffer;
+    const char** pending = NULL; // names in buffer, so only good until the next read()
+    size_t pendingcapacity = 0;
+    while (!stopwatching)
+    {
+        ssize_t length = read(fd, buffer.bytes, sizeof(buffer.bytes));
+        if (length <= 0)
+        {
+            if (length < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "Error: could not read events for %s\n", directoryname);
+            break;
+        }
+        struct timespec eventtime;
+        clock_gettime(CLOCK_MONOTONIC, &eventtime);
+
+        size_t numpending = 0;
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const struct inotify_event* event = (const struct inotify_event*)(buffer.bytes + offset);
+            offset += (ssize_t)(sizeof(*event) + event->len);
+            if (event->len == 0 || !is_jack_file(event->name))
+            {
+                continue; // our own outputs and the manifest land here too
+            }
+            size_t i = 0;
+            while (i < numpending && strcmp(pending[i], event->name) != 0)
+            {
+                i++;
+            }
+            if (i == numpending)
+            {
+                if (numpending == pendingcapacity)
+                {
+                    size_t newcapacity = (pendingcapacity == 0) ? INITIAL_PENDING_FILES : pendingcapacity * 2;
+                    const char** temp = realloc(pending, newcapacity * sizeof(*temp));
+                    if (temp == NULL)
+                    {
+                        fprintf(stderr, "Error: could not reallocate memory for changed files\n");
+                        exit(1);
+                    }
+                    pending = temp;
+                    pendingcapacity = newcapacity;
+                }
+                pending[numpending++] = event->name;
+            }
+        }
+
+        for (size_t i = 0; i < numpending; i++)
+        {
+            rebuild_file(&state, pending[i], &eventtime);
+        }
+        if (numpending > 0 && options->usecache)
+        {
+            save_build_cache(&state.hashes, directoryname);
+        }
+        if (numpending > 0 && options->linkfile != NULL)
+        {
+            link_directory(directoryname, options->linkfile, stdout);
+        }
+        fflush(stdout);
+    }
+
+    print_latency_summary(&state, stdout);
+    if (options->latencyfile != NULL)
+    {
+        write_latency_json(&state);
+    }
+
+    for (size_t i = 0; i < state.count; i++)
+    {
+        free(state.samples[i].name);
+    }
+    free(state.samples);
+    free(pending);
+    free_build_cache(&state.hashes);
+    close(fd);
+    return true;
+}
+
+#else
+
+bool watch_directory(const char* const directoryname, const compileoptions* options)
+{
+    (void)options;
+    fprintf(stderr, "Error: could not watch %s, watch mode needs inotify\n", directoryname);
+    return false;
+}
+
+#endif // WATCHMODE_HAS_INOTIFY
@@ -0,0 +1,20 @@
+#ifndef WATCHMODE_H
+#define WATCHMODE_H
+
+#include <stdbool.h>
+#include "options.h"
+
+#if defined(__linux__)
+#define WATCHMODE_HAS_INOTIFY
+#endif
+
+// Watches a directory that compile_directory() has just built and
+// recompiles each .jack file as soon as it is saved, until interrupted.
+// Every rebuild is timed from the moment the change event is read to the
+// moment the last output file is closed, and from the file's modification
+// time. The times are printed as they happen, summarized on exit and, with
+// options->latencyfile, dumped there as JSON. Returns false if the
+// directory can't be watched (or this system has no inotify).
+bool watch_directory(const char* const directoryname, const compileoptions* options);
+
+#endif // WATCHMODE_H
@@ -0,0 +1,171 @@
+#include "workpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef WORKPOOL_HAS_THREADS
+#include <pthread.h>
+#include <unistd.h>
+
+// one thread's share of the work; head and tail only move inward
+typedef struct workdeque
+{
+    pthread_mutex_t lock;
+    size_t* items;
+    size_t head; // next item the owner takes
+    size_t tail; // one past the next item a thief takes
+} workdeque;
+
+typedef struct workpool
+{
+    workdeque* deques;
+    int numthreads;
+    workfunction work;
+    void* context;
+} workpool;
+
+// what each thread is started with
+typedef struct workerargs
+{
+    workpool* pool;
+    int self;
+} workerargs;
+
+
+/*
+* Takes the next item from the front of the thread's own deque, or failing
+* that from the back of someone else's. Returns false once every deque is
+* empty; nothing is ever added after the pool starts, so that means done.
+*/
+static bool take_item(workpool* pool, int self, size_t* item)
+{
+    workdeque* own = &pool->deques[self];
+    bool found = false;
+    pthread_mutex_lock(&own->lock);
+    if (own->head < own->tail)
+    {
+        *item = own->items[own->head++];
+        found = true;
+    }
+    pthread_mutex_unlock(&own->lock);
+
+    for (int i = 1; !found && i < pool->numthreads; i++)
+    {
+        workdeque* victim = &pool->deques[(self + i) % pool->numthreads];
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail)
+        {
+            *item = victim->items[--victim->tail];
+            found = true;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+    return found;
+}
+
+static void* run_worker(void* arg)
+{
+    workerargs* args = arg;
+    size_t item;
+    while (take_item(args->pool, args->self, &item))
+    {
+        args->pool->work(item, args->pool->context);
+    }
+    return NULL;
+}
+#endif // WORKPOOL_HAS_THREADS
+
+
+/*
+* Deals order out round-robin so every deque is largest-first, runs one
+* worker per deque (the calling thread is worker 0) and waits for them all.
+*/
+void run_work_pool(const size_t* order, size_t count, int numthreads, workfunction work, void* context)
+{
+#ifdef WORKPOOL_HAS_THREADS
+    if ((size_t)numthreads > count)
+    {
+        numthreads = (int)count;
+    }
+    if (numthreads > 1)
+    {
+        workpool pool;
+        pool.numthreads = numthreads;
+        pool.work = work;
+        pool.context = context;
+        pool.deques = malloc(numthreads * sizeof(*(pool.deques)));
+        size_t* items = malloc(count * sizeof(*items));
+        pthread_t* threads = malloc(numthreads * sizeof(*threads));
+        workerargs* args = malloc(numthreads * sizeof(*args));
+        if (pool.deques == NULL || items == NULL || threads == NULL || args == NULL)
+        {
+            fprintf(stderr, "Error: could not allocate memory for work pool\n");
+            exit(1);
+        }
+
+        size_t next = 0;
+        for (int d = 0; d < numthreads; d++)
+        {
+            workdeque* deque = &pool.deques[d];
+            pthread_mutex_init(&deque->lock, NULL);
+            deque->items = items + next;
+            deque->head = 0;
+            deque->tail = 0;
+            for (size_t i = (size_t)d; i < count; i += (size_t)numthreads)
+            {
+                deque->items[deque->tail++] = order[i];
+            }
+            next += deque->tail;
+        }
+
+        int started = 1;
+        for (int t = 0; t < numthreads; t++)
+        {
+            args[t].pool = &pool;
+            args[t].self = t;
+        }
+        for (int t = 1; t < numthreads; t++)
+        {
+            if (pthread_create(&threads[t], NULL, run_worker, &args[t]) != 0)
+            {
+                // carry on with fewer threads; the others will steal this one's work
+                fprintf(stderr, "Error: could not start worker thread\n");
+                break;
+            }
+            started++;
+        }
+        run_worker(&args[0]);
+        for (int t = 1; t < started; t++)
+        {
+            pthread_join(threads[t], NULL);
+        }
+
+        for (int d = 0; d < numthreads; d++)
+        {
+            pthread_mutex_destroy(&pool.deques[d].lock);
+        }
+        free(pool.deques);
+        free(items);
+        free(threads);
+        free(args);
+        return;
+    }
+#else
+    (void)numthreads;
+#endif
+    for (size_t i = 0; i < count; i++)
+    {
+        work(order[i], context);
+    }
+}
+
+int count_processors(void)
+{
+#if defined(WORKPOOL_HAS_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0)
+    {
+        return (int)n;
+    }
+#endif
+    return 1;
+}
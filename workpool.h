@@ -0,0 +1,21 @@
+#ifndef WORKPOOL_H
+#define WORKPOOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define WORKPOOL_HAS_THREADS
+#endif
+
+typedef void (*workfunction)(size_t item, void* context);
+
+// Calls work(order[i], context) once for every i, spread over numthreads
+// threads. order should list the biggest jobs first: each thread gets its
+// own largest-first deque and works from the front of it, and a thread that
+// runs out steals from the back of another thread's deque. Without thread
+// support (or with numthreads <= 1) the items are simply run in order.
+void run_work_pool(const size_t* order, size_t count, int numthreads, workfunction work, void* context);
+int count_processors(void); // at least 1
+
+#endif // WORKPOOL_H
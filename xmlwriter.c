@@ -0,0 +1,275 @@
+#include "xmlwriter.h"
+#include <stdlib.h>
+#include <string.h>
+#include "compilestats.h"
+
+#define SPACES_LENGTH 64
+#define MAX_ESCAPE_LENGTH 5 // "&amp;"
+#define MAX_UINT_DIGITS 10
+
+// a string literal along with its length, so appending it is a single memcpy()
+typedef struct xmltext
+{
+    const char* text;
+    size_t length;
+} xmltext;
+
+#define XMLTEXT(s) { s, sizeof(s) - 1 }
+
+// indexed by xmltag; terminal tags are followed by a space, nonterminal tags by a newline
+static const xmltext opentags[] =
+{
+    XMLTEXT("<keyword> "), XMLTEXT("<symbol> "), XMLTEXT("<integerConstant> "), XMLTEXT("<stringConstant> "),
+    XMLTEXT("<identifier> "), XMLTEXT("<class>\n"), XMLTEXT("<classVarDec>\n"), XMLTEXT("<subroutineDec>\n"),
+    XMLTEXT("<parameterList>\n"), XMLTEXT("<subroutineBody>\n"), XMLTEXT("<varDec>\n"), XMLTEXT("<statements>\n"),
+    XMLTEXT("<letStatement>\n"), XMLTEXT("<ifStatement>\n"), XMLTEXT("<whileStatement>\n"), XMLTEXT("<doStatement>\n"),
+    XMLTEXT("<returnStatement>\n"), XMLTEXT("<expression>\n"), XMLTEXT("<term>\n"), XMLTEXT("<expressionList>\n"),
+    XMLTEXT("<DEFAULT> ")
+};
+
+// indexed by xmltag; terminal tags are preceded by a space
+static const xmltext closetags[] =
+{
+    XMLTEXT(" </keyword>\n"), XMLTEXT(" </symbol>\n"), XMLTEXT(" </integerConstant>\n"), XMLTEXT(" </stringConstant>\n"),
+    XMLTEXT(" </identifier>\n"), XMLTEXT("</class>\n"), XMLTEXT("</classVarDec>\n"), XMLTEXT("</subroutineDec>\n"),
+    XMLTEXT("</parameterList>\n"), XMLTEXT("</subroutineBody>\n"), XMLTEXT("</varDec>\n"), XMLTEXT("</statements>\n"),
+    XMLTEXT("</letStatement>\n"), XMLTEXT("</ifStatement>\n"), XMLTEXT("</whileStatement>\n"), XMLTEXT("</doStatement>\n"),
+    XMLTEXT("</returnStatement>\n"), XMLTEXT("</expression>\n"), XMLTEXT("</term>\n"), XMLTEXT("</expressionList>\n"),
+    XMLTEXT(" </DEFAULT>\n")
+};
+
+static const char spaces[SPACES_LENGTH + 1] = "                                                                ";
+
+
+void initialize_xml_writer(xmlwriter* xml, xmlflushfunction flush, void* context, xmlformat format, arena* a)
+{
+    xml->flush = flush;
+    xml->context = context;
+    xml->format = format;
+    xml->data = NULL;
+    xml->length = 0;
+    xml->capacity = 0;
+    xml->failed = false;
+    xml->stats = NULL;
+    if (flush != NULL)
+    {
+        xml->data = arena_alloc(a, XML_BUFFER_SIZE * sizeof(*(xml->data)));
+        xml->capacity = XML_BUFFER_SIZE;
+    }
+    if (format == XF_BINARY)
+    {
+        write_xml_text(xml, TREE_MAGIC, 4);
+    }
+}
+
+/*
+* Passes length bytes on to the flush function.
+*/
+static void write_xml_output(xmlwriter* xml, const char* text, size_t length)
+{
+    double start = (xml->stats != NULL) ? stats_clock() : 0.0;
+    if (!xml->flush(text, length, xml->context))
+    {
+        xml->failed = true;
+    }
+    if (xml->stats != NULL)
+    {
+        xml->stats->seconds[PH_WRITE] += stats_clock() - start;
+        xml->stats->byteswritten += length;
+    }
+}
+
+void flush_xml_writer(xmlwriter* xml)
+{
+    if (xml->flush == NULL)
+    {
+        return;
+    }
+    if (xml->length > 0)
+    {
+        write_xml_output(xml, xml->data, xml->length);
+    }
+    xml->length = 0;
+}
+
+
+/*
+* Flushes the buffer if fewer than needed bytes are left in it, or without
+* a flush function, grows it geometrically.
+*/
+static void make_room(xmlwriter* xml, size_t needed)
+{
+    if (xml->capacity - xml->length >= needed)
+    {
+        return;
+    }
+    if (xml->flush != NULL)
+    {
+        flush_xml_writer(xml);
+        return;
+    }
+
+    size_t newcapacity = (xml->capacity == 0) ? XML_BUFFER_SIZE : xml->capacity * 2;
+    while (newcapacity - xml->length < needed)
+    {
+        newcapacity *= 2;
+    }
+    char* temp = realloc(xml->data, newcapacity * sizeof(*temp));
+    if (temp == NULL)
+    {
+        fprintf(stderr, "Error: could not reallocate memory for XML output\n");
+        exit(1);
+    }
+    xml->data = temp;
+    xml->capacity = newcapacity;
+}
+
+
+/*
+* Copies text into the buffer. Text too big to ever fit is written straight
+* through after flushing whatever came before it.
+*/
+void write_xml_text(xmlwriter* xml, const char* text, size_t length)
+{
+    make_room(xml, length);
+    if (length > xml->capacity)
+    {
+        write_xml_output(xml, text, length);
+        return;
+    }
+    memcpy(xml->data + xml->length, text, length);
+    xml->length += length;
+}
+
+void write_xml_indent(xmlwriter* xml, int indent)
+{
+    while (indent > SPACES_LENGTH)
+    {
+        write_xml_text(xml, spaces, SPACES_LENGTH);
+        indent -= SPACES_LENGTH;
+    }
+    if (indent > 0)
+    {
+        write_xml_text(xml, spaces, (size_t)indent);
+    }
+}
+
+void write_xml_uint(xmlwriter* xml, unsigned int n)
+{
+    char digits[MAX_UINT_DIGITS];
+    size_t count = 0;
+    do
+    {
+        digits[MAX_UINT_DIGITS - 1 - count] = (char)('0' + n % 10);
+        count++;
+        n /= 10;
+    } while (n != 0);
+    write_xml_text(xml, digits + MAX_UINT_DIGITS - count, count);
+}
+
+/*
+* Appends a single byte, for the binary format.
+*/
+static void write_tree_byte(xmlwriter* xml, unsigned char byte)
+{
+    make_room(xml, 1);
+    xml->data[xml->length++] = (char)byte;
+}
+
+void write_xml_open_tag(xmlwriter* xml, xmltag tag, int indent)
+{
+    if (xml->format == XF_BINARY)
+    {
+        write_tree_byte(xml, (unsigned char)tag);
+        return;
+    }
+    write_xml_indent(xml, indent);
+    write_xml_text(xml, opentags[tag].text, opentags[tag].length);
+}
+
+void write_xml_close_tag(xmlwriter* xml, xmltag tag, int indent)
+{
+    if (xml->format == XF_BINARY)
+    {
+        write_tree_byte(xml, TREE_CLOSE);
+        return;
+    }
+    write_xml_indent(xml, indent);
+    write_xml_text(xml, closetags[tag].text, closetags[tag].length);
+}
+
+
+/*
+* Binary form of write_xml_terminal(): tag, varint length, raw text.
+*/
+static void write_tree_terminal(xmlwriter* xml, xmltag tag, const char* text, size_t length)
+{
+    if (tag == XT_STRING_CONSTANT && length > 0)
+    {
+        // drop the quotes; an unterminated string at the end of the file has no closing one
+        text++;
+        length--;
+        if (length > 0 && text[length - 1] == '"')
+        {
+            length--;
+        }
+    }
+    write_tree_byte(xml, (unsigned char)tag);
+    size_t n = length;
+    do
+    {
+        unsigned char byte = n & 0x7F;
+        n >>= 7;
+        write_tree_byte(xml, (n != 0) ? (byte | 0x80) : byte);
+    } while (n != 0);
+    write_xml_text(xml, text, length);
+}
+
+
+/*
+* Writes a whole terminal element, <tag> text </tag>, on one line. Markup
+* characters in text are escaped as they are copied into the buffer. For
+* string constants the quotes (and any newlines) are dropped, as
+* get_stringval() does.
+*/
+void write_xml_terminal(xmlwriter* xml, xmltag tag, const char* text, size_t length, int indent)
+{
+    if (xml->format == XF_BINARY)
+    {
+        write_tree_terminal(xml, tag, text, length);
+        return;
+    }
+    write_xml_open_tag(xml, tag, indent);
+    for (size_t i = 0; i < length; i++)
+    {
+        make_room(xml, MAX_ESCAPE_LENGTH);
+        char* dest = xml->data + xml->length;
+        switch (text[i])
+        {
+            case '<':
+                memcpy(dest, "&lt;", 4);
+                xml->length += 4;
+                break;
+            case '>':
+                memcpy(dest, "&gt;", 4);
+                xml->length += 4;
+                break;
+            case '&':
+                memcpy(dest, "&amp;", 5);
+                xml->length += 5;
+                break;
+            case '"':
+            case '\n':
+                if (tag != XT_STRING_CONSTANT)
+                {
+                    *dest = text[i];
+                    xml->length++;
+                }
+                break;
+            default:
+                *dest = text[i];
+                xml->length++;
+        }
+    }
+    write_xml_text(xml, closetags[tag].text, closetags[tag].length);
+}
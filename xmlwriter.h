@@ -0,0 +1,81 @@
+#ifndef XMLWRITER_H
+#define XMLWRITER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "arena.h"
+
+#define XML_BUFFER_SIZE 65536
+
+// every element the parse tree can contain; the first five hold terminals
+typedef enum xmltag
+{
+    XT_KEYWORD,
+    XT_SYMBOL,
+    XT_INTEGER_CONSTANT,
+    XT_STRING_CONSTANT,
+    XT_IDENTIFIER,
+    XT_CLASS,
+    XT_CLASS_VAR_DEC,
+    XT_SUBROUTINE_DEC,
+    XT_PARAMETER_LIST,
+    XT_SUBROUTINE_BODY,
+    XT_VAR_DEC,
+    XT_STATEMENTS,
+    XT_LET_STATEMENT,
+    XT_IF_STATEMENT,
+    XT_WHILE_STATEMENT,
+    XT_DO_STATEMENT,
+    XT_RETURN_STATEMENT,
+    XT_EXPRESSION,
+    XT_TERM,
+    XT_EXPRESSION_LIST,
+    XT_DEFAULT // for tokens that shouldn't appear in a parse tree
+} xmltag;
+
+// XF_BINARY turns the same sequence of calls into a compact parse tree:
+//   "JPT1", then one record per call
+//   open tag:  1 byte, the xmltag
+//   close tag: 1 byte, TREE_CLOSE
+//   terminal:  1 byte xmltag, the text length as a LEB128 varint, then the
+//              text exactly as in the source (string constants without quotes)
+// Indentation, annotations and other free text are left out.
+typedef enum xmlformat
+{
+    XF_TEXT,
+    XF_BINARY
+} xmlformat;
+
+#define TREE_MAGIC "JPT1"
+#define TREE_CLOSE 0xFF
+
+// receives each full buffer; returns false if it couldn't be written
+typedef bool (*xmlflushfunction)(const char* data, size_t length, void* context);
+
+// Collects XML text in a fixed-size buffer and passes it on to flush
+// whenever the buffer fills up, so a file of any size streams through the
+// same memory. Without a flush function the buffer grows instead and ends
+// up holding the whole tree.
+typedef struct xmlwriter
+{
+    xmlflushfunction flush;
+    void* context; // passed to flush
+    xmlformat format;
+    char* data; // XML_BUFFER_SIZE bytes from the arena, or malloc'd and growing without flush
+    size_t length;
+    size_t capacity;
+    bool failed; // a flush returned false
+    struct filestats* stats; // optional, times the writes and counts the bytes for --stats
+} xmlwriter;
+
+void initialize_xml_writer(xmlwriter* xml, xmlflushfunction flush, void* context, xmlformat format, arena* a); // the buffer is taken from a
+void write_xml_open_tag(xmlwriter* xml, xmltag tag, int indent); // e.g. "  <class>\n"
+void write_xml_close_tag(xmlwriter* xml, xmltag tag, int indent);
+void write_xml_terminal(xmlwriter* xml, xmltag tag, const char* text, size_t length, int indent); // escapes text
+void write_xml_indent(xmlwriter* xml, int indent); // these three are for XF_TEXT only
+void write_xml_text(xmlwriter* xml, const char* text, size_t length); // copied as is
+void write_xml_uint(xmlwriter* xml, unsigned int n);
+void flush_xml_writer(xmlwriter* xml); // does nothing without a flush function
+
+#endif // XMLWRITER_H